@@ -0,0 +1,56 @@
+vd::spatial::AABBTree tree;
+vd::vec2array positions(20000);
+vd::vec2array velocities(20000);
+vd::float32array rects;
+array<int> proxies;
+array<int> found;
+array<int> offsets;
+array<int> hits;
+vd::Vector2 lower;
+vd::Vector2 upper;
+
+void init()
+{
+    for (uint i = 0; i < positions.length(); i++)
+    {
+        positions[i].x = vd::math::random() * 800;
+        positions[i].y = vd::math::random() * 600;
+        velocities[i].x = vd::math::random() * 40 - 20;
+        velocities[i].y = vd::math::random() * 40 - 20;
+        proxies.insertLast(tree.createProxy(positions[i].x - 2, positions[i].y - 2, positions[i].x + 2, positions[i].y + 2));
+    }
+
+    for (uint i = 0; i < 500; i++)
+    {
+        float x = vd::math::random() * 800;
+        float y = vd::math::random() * 600;
+        rects.insertLast(x);
+        rects.insertLast(y);
+        rects.insertLast(x + 32);
+        rects.insertLast(y + 32);
+    }
+
+    upper.x = 800;
+    upper.y = 600;
+}
+
+void update(float dt)
+{
+    positions.fma(velocities, dt);
+    positions.clamp(lower, upper);
+
+    for (uint i = 0; i < positions.length(); i++)
+    {
+        float x = positions[i].x;
+        float y = positions[i].y;
+        tree.moveProxy(proxies[i], x - 2, y - 2, x + 2, y + 2, velocities[i].x * dt, velocities[i].y * dt);
+    }
+
+    tree.queryBatch(rects, found, offsets);
+    tree.raycast(0, 0, 800, 600, hits);
+}
+
+void draw()
+{
+    vd::graphics::print("found: " + vd::toString(int(found.length())) + " hits: " + vd::toString(int(hits.length())), 10, 10);
+}
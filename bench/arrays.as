@@ -0,0 +1,40 @@
+array<int> values;
+array<float> weights;
+int checksum = 0;
+
+void init()
+{
+}
+
+void update(float dt)
+{
+    values.resize(0);
+    weights.resize(0);
+
+    for (int i = 0; i < 20000; i++)
+    {
+        values.insertLast(int(vd::math::random() * 100000));
+        weights.insertLast(vd::math::random());
+    }
+
+    values.sortAsc();
+    weights.sortDesc();
+
+    for (uint i = 0; i < 500; i++)
+    {
+        values.insertAt(i * 7, int(i));
+        values.removeAt(i * 3);
+    }
+
+    while (values.length() > 10000)
+    {
+        values.removeLast();
+    }
+
+    checksum = values.find(values[values.length() / 2]);
+}
+
+void draw()
+{
+    vd::graphics::print("checksum: " + vd::toString(checksum), 10, 10);
+}
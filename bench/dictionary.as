@@ -0,0 +1,58 @@
+array<dictionary@> entities;
+array<string> keys = { "health", "armor", "speed", "damage", "level", "experience", "gold", "mana" };
+double total = 0;
+
+void init()
+{
+    for (uint i = 0; i < 2000; i++)
+    {
+        dictionary@ entity = dictionary();
+
+        for (uint k = 0; k < keys.length(); k++)
+        {
+            entity.set(keys[k], vd::math::random() * 100);
+        }
+
+        entity.set("name", "entity" + vd::toString(int(i)));
+
+        // A key built at runtime and only used here, so deleting it frees the key
+        string once = "once" + vd::toString(int(i));
+        entity.set(once, i);
+        entity.delete(once);
+
+        entities.insertLast(entity);
+    }
+}
+
+void update(float dt)
+{
+    total = 0;
+
+    for (uint i = 0; i < entities.length(); i++)
+    {
+        dictionary@ entity = entities[i];
+
+        double health = double(entity["health"]);
+        double armor = double(entity["armor"]);
+        double damage = double(entity["damage"]);
+
+        entity["health"] = health - damage * dt / (1 + armor);
+        entity["experience"] = double(entity["experience"]) + dt;
+
+        if (entity.exists("buff"))
+        {
+            entity.delete("buff");
+        }
+        else
+        {
+            entity.set("buff", 1);
+        }
+
+        total += double(entity["health"]);
+    }
+}
+
+void draw()
+{
+    vd::graphics::print("total: " + vd::toString(float(total)), 10, 10);
+}
@@ -0,0 +1,54 @@
+[component]
+class Position
+{
+    float x;
+    float y;
+}
+
+[component]
+class Velocity
+{
+    float x;
+    float y;
+}
+
+int position;
+int velocity;
+vd::int32array visible;
+
+void init()
+{
+    position = vd::ecs::component("Position");
+    velocity = vd::ecs::component("Velocity");
+
+    for (int i = 0; i < 100000; i++)
+    {
+        int entity = vd::ecs::create();
+        vd::ecs::add(entity, position);
+        vd::ecs::add(entity, velocity);
+    }
+
+    vd::float32array@ px = vd::ecs::floats(position, "x");
+    vd::float32array@ py = vd::ecs::floats(position, "y");
+    vd::float32array@ vx = vd::ecs::floats(velocity, "x");
+    vd::float32array@ vy = vd::ecs::floats(velocity, "y");
+
+    for (uint i = 0; i < px.length(); i++)
+    {
+        px[i] = vd::math::random() * 800;
+        py[i] = vd::math::random() * 600;
+        vx[i] = vd::math::random() * 100 - 50;
+        vy[i] = vd::math::random() * 100 - 50;
+    }
+}
+
+void update(float dt)
+{
+    vd::ecs::integrate(position, velocity, dt);
+    vd::ecs::cull(position, 0, 0, 800, 600, visible);
+}
+
+void draw()
+{
+    vd::graphics::print("visible: " + vd::toString(int(visible.length())), 10, 10);
+}
@@ -0,0 +1,43 @@
+class Node
+{
+    Node@ next;
+    Node@ other;
+    array<int> payload(8);
+}
+
+array<Node@> live;
+int created = 0;
+
+void init()
+{
+}
+
+void update(float dt)
+{
+    for (int i = 0; i < 5000; i++)
+    {
+        Node a;
+        Node b;
+
+        @a.next = b;
+        @b.next = a;
+        @a.other = a;
+
+        created += 2;
+
+        if (i % 10 == 0)
+        {
+            live.insertLast(a);
+        }
+    }
+
+    while (live.length() > 2000)
+    {
+        live.removeAt(0);
+    }
+}
+
+void draw()
+{
+    vd::graphics::print("created: " + vd::toString(created), 10, 10);
+}
@@ -0,0 +1,65 @@
+grid<int>@ cells = grid<int>(256, 256);
+grid<int>@ next = grid<int>(256, 256);
+int alive = 0;
+
+void init()
+{
+    for (uint y = 0; y < cells.height(); y++)
+    {
+        for (uint x = 0; x < cells.width(); x++)
+        {
+            cells[x, y] = vd::math::random() > 0.7 ? 1 : 0;
+        }
+    }
+}
+
+void update(float dt)
+{
+    uint w = cells.width();
+    uint h = cells.height();
+
+    alive = 0;
+
+    for (uint y = 0; y < h; y++)
+    {
+        for (uint x = 0; x < w; x++)
+        {
+            int n = 0;
+
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    if (dx == 0 && dy == 0)
+                        continue;
+
+                    n += cells[(x + w + dx) % w, (y + h + dy) % h];
+                }
+            }
+
+            int state = (n == 3 || (n == 2 && cells[x, y] == 1)) ? 1 : 0;
+            next[x, y] = state;
+            alive += state;
+        }
+    }
+
+    grid<int>@ swap = cells;
+    @cells = next;
+    @next = swap;
+}
+
+void draw()
+{
+    for (uint y = 0; y < cells.height(); y++)
+    {
+        for (uint x = 0; x < cells.width(); x++)
+        {
+            if (cells[x, y] == 1)
+            {
+                vd::graphics::point(int(x) * 3, int(y) * 2);
+            }
+        }
+    }
+
+    vd::graphics::print("alive: " + vd::toString(alive), 10, 10);
+}
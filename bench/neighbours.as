@@ -0,0 +1,44 @@
+vd::vec2array positions(50000);
+vd::vec2array velocities(50000);
+vd::spatial::HashGrid grid(16);
+array<int> nearby;
+array<int> close;
+vd::Vector2 lower;
+vd::Vector2 upper;
+int found;
+
+void init()
+{
+    for (uint i = 0; i < positions.length(); i++)
+    {
+        positions[i].x = vd::math::random() * 800;
+        positions[i].y = vd::math::random() * 600;
+        velocities[i].x = vd::math::random() * 40 - 20;
+        velocities[i].y = vd::math::random() * 40 - 20;
+    }
+
+    upper.x = 800;
+    upper.y = 600;
+}
+
+void update(float dt)
+{
+    positions.fma(velocities, dt);
+    positions.clamp(lower, upper);
+    grid.rebuild(positions);
+
+    found = 0;
+
+    for (uint i = 0; i < 1000; i++)
+    {
+        grid.queryRadius(positions[i].x, positions[i].y, 24, nearby);
+        found += nearby.length();
+    }
+
+    grid.pairs(2, close);
+}
+
+void draw()
+{
+    vd::graphics::print("nearby: " + vd::toString(found) + " pairs: " + vd::toString(int(close.length() / 2)), 10, 10);
+}
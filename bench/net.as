@@ -0,0 +1,69 @@
+// Loopback throughput: clients on 127.0.0.1 stream small messages to one server
+const int port = 47001;
+const int clientCount = 8;
+const int messagesPerFrame = 200;
+
+vd::net::Host server;
+array<vd::net::Host@> clients;
+int connected;
+int frames;
+int received;
+int receivedLastFrame;
+
+void init()
+{
+    server.listen(port, clientCount);
+
+    for (int i = 0; i < clientCount; i++)
+    {
+        vd::net::Host client;
+        client.connect("127.0.0.1", port);
+        clients.insertLast(client);
+    }
+}
+
+void update(float dt)
+{
+    frames++;
+    receivedLastFrame = 0;
+
+    vd::net::Reader@ reader = server.receive();
+    while (reader.next())
+    {
+        if (reader.kind == vd::net::EventKind::Connect)
+            connected++;
+        else if (reader.kind == vd::net::EventKind::Disconnect)
+            connected--;
+        else
+        {
+            int id = reader.readInt32();
+            float x = reader.readFloat();
+            float y = reader.readFloat();
+            receivedLastFrame++;
+        }
+    }
+
+    received += receivedLastFrame;
+
+    for (uint i = 0; i < clients.length(); i++)
+    {
+        if (clients[i].peerCount() == 0)
+            continue;
+
+        for (int j = 0; j < messagesPerFrame; j++)
+        {
+            vd::net::Writer@ message = clients[i].message(0, 0, false);
+            message.writeInt32(j);
+            message.writeFloat(j * 0.5f);
+            message.writeFloat(frames * 0.25f);
+        }
+    }
+}
+
+void draw()
+{
+    vd::graphics::print("peers: " + vd::toString(connected), 10, 10);
+    vd::graphics::print("messages/frame: " + vd::toString(receivedLastFrame), 10, 30);
+    vd::graphics::print("messages/s: " + vd::toString(receivedLastFrame * vd::timer::getFPS()), 10, 50);
+    vd::graphics::print("total: " + vd::toString(received), 10, 70);
+}
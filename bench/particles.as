@@ -0,0 +1,29 @@
+vd::vec2array positions(100000);
+vd::vec2array velocities(100000);
+vd::Vector2 lower;
+vd::Vector2 upper;
+
+void init()
+{
+    for (uint i = 0; i < positions.length(); i++)
+    {
+        positions[i].x = vd::math::random() * 800;
+        positions[i].y = vd::math::random() * 600;
+        velocities[i].x = vd::math::random() * 100 - 50;
+        velocities[i].y = vd::math::random() * 100 - 50;
+    }
+
+    upper.x = 800;
+    upper.y = 600;
+}
+
+void update(float dt)
+{
+    positions.fma(velocities, dt);
+    positions.clamp(lower, upper);
+}
+
+void draw()
+{
+    vd::graphics::print("sum: " + vd::toString(positions.sum().x), 10, 10);
+}
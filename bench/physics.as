@@ -0,0 +1,35 @@
+vd::physics::World world;
+vd::int32array ids;
+vd::vec2array positions;
+vd::float32array angles;
+vd::int32array began;
+vd::int32array ended;
+int touches;
+
+void init()
+{
+    int ground = world.createBody(vd::physics::BodyType::Static, 400, 590);
+    world.addBox(ground, 400, 10);
+
+    for (int i = 0; i < 1000; i++)
+    {
+        int body = world.createBody(vd::physics::BodyType::Dynamic, 50 + (i % 50) * 14, 20 - (i / 50) * 14);
+        world.addBox(body, 5, 5);
+    }
+}
+
+void update(float dt)
+{
+    world.step(dt);
+    world.exportTransforms(ids, positions, angles);
+    world.contacts(began, ended);
+    touches += began.length() / 2;
+}
+
+void draw()
+{
+    for (uint i = 0; i < positions.length(); i++)
+        vd::graphics::point(int(positions[i].x), int(positions[i].y));
+
+    vd::graphics::print("contacts: " + vd::toString(touches), 10, 10);
+}
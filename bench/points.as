@@ -0,0 +1,33 @@
+array<vd::Vector2> points;
+
+void init()
+{
+    points.resize(100000);
+
+    for (uint i = 0; i < points.length(); i++)
+    {
+        points[i].x = vd::math::random() * 800;
+        points[i].y = vd::math::random() * 600;
+    }
+}
+
+void update(float dt)
+{
+    for (uint i = 0; i < points.length(); i++)
+    {
+        points[i].y += 60 * dt;
+
+        if (points[i].y >= 600)
+        {
+            points[i].y -= 600;
+        }
+    }
+}
+
+void draw()
+{
+    for (uint i = 0; i < points.length(); i++)
+    {
+        vd::graphics::point(int(points[i].x), int(points[i].y));
+    }
+}
@@ -0,0 +1,99 @@
+// Every frame rolls back 7 frames and simulates them again, the way a
+// rollback client does when a late input arrives.
+const int depth = 7;
+const int slots = depth + 1;
+
+class Entity
+{
+    float x;
+    float y;
+    float vx;
+    float vy;
+    int hp;
+    string name;
+    Entity@ target;
+    array<int> hits;
+}
+
+array<Entity@> entities;
+vd::vec2array trail(256);
+int frame;
+
+[norollback] array<vd::rollback::Snapshot@> history;
+[norollback] vd::rollback::Snapshot delta;
+
+void init()
+{
+    for (int i = 0; i < slots; i++)
+        history.insertLast(vd::rollback::Snapshot());
+
+    for (int i = 0; i < 1000; i++)
+    {
+        Entity e;
+        e.x = vd::math::random() * 800;
+        e.y = vd::math::random() * 600;
+        e.vx = vd::math::random() * 80 - 40;
+        e.vy = vd::math::random() * 80 - 40;
+        e.hp = 100;
+        e.name = "entity " + vd::toString(i);
+        entities.insertLast(e);
+    }
+
+    for (uint i = 0; i < entities.length(); i++)
+        @entities[i].target = entities[(i * 7 + 1) % entities.length()];
+}
+
+void step(float dt)
+{
+    frame++;
+
+    for (uint i = 0; i < entities.length(); i++)
+    {
+        Entity@ e = entities[i];
+
+        e.x += e.vx * dt;
+        e.y += e.vy * dt;
+
+        if (e.x < 0 || e.x > 800)
+            e.vx = -e.vx;
+        if (e.y < 0 || e.y > 600)
+            e.vy = -e.vy;
+
+        if (abs(e.x - e.target.x) < 8 && abs(e.y - e.target.y) < 8)
+        {
+            e.target.hp--;
+            e.target.hits.insertLast(frame);
+
+            if (e.target.hits.length() > 16)
+                e.target.hits.removeAt(0);
+        }
+    }
+
+    trail[frame % 256].x = entities[0].x;
+    trail[frame % 256].y = entities[0].y;
+}
+
+void update(float dt)
+{
+    history[frame % slots].save();
+    step(dt);
+
+    if (vd::rollback::resimulating() || frame <= depth)
+        return;
+
+    delta.saveDelta(history[(frame - 1) % slots]);
+
+    history[(frame - depth) % slots].restore();
+    vd::rollback::resimulate(depth, dt);
+}
+
+void draw()
+{
+    for (uint i = 0; i < entities.length(); i++)
+        vd::graphics::point(int(entities[i].x), int(entities[i].y));
+
+    vd::rollback::Snapshot@ latest = history[(frame + slots - 1) % slots];
+    vd::graphics::print("objects: " + vd::toString(int(latest.objectCount())), 10, 10);
+    vd::graphics::print("snapshot bytes: " + vd::toString(int(latest.size())), 10, 30);
+    vd::graphics::print("delta bytes: " + vd::toString(int(delta.size())), 10, 50);
+}
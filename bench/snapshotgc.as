@@ -0,0 +1,34 @@
+// Each frame a new game keeps its own snapshot, which reaches the game again
+// through the global. Only the garbage collector can free the old ones.
+class Game
+{
+    int frame;
+    array<float> positions(64);
+    vd::rollback::Snapshot@ history;
+}
+
+Game@ current;
+int created = 0;
+
+void init()
+{
+}
+
+void update(float dt)
+{
+    for (int i = 0; i < 20; i++)
+    {
+        Game game;
+        game.frame = created++;
+        @game.history = vd::rollback::Snapshot();
+
+        @current = game;
+        game.history.save();
+    }
+}
+
+void draw()
+{
+    vd::graphics::print("games: " + vd::toString(created), 10, 10);
+    vd::graphics::print("objects: " + vd::toString(int(current.history.objectCount())), 10, 30);
+}
@@ -0,0 +1,47 @@
+class Sprite
+{
+    float x;
+    float y;
+    float vx;
+    float vy;
+}
+
+vd::Image@ image;
+array<Sprite> sprites;
+
+void init()
+{
+    @image = vd::graphics::newImage("assets/test.png");
+
+    sprites.resize(20000);
+
+    for (uint i = 0; i < sprites.length(); i++)
+    {
+        sprites[i].x = vd::math::random() * 800;
+        sprites[i].y = vd::math::random() * 600;
+        sprites[i].vx = vd::math::random() * 100 - 50;
+        sprites[i].vy = vd::math::random() * 100 - 50;
+    }
+}
+
+void update(float dt)
+{
+    for (uint i = 0; i < sprites.length(); i++)
+    {
+        Sprite@ s = sprites[i];
+
+        s.x += s.vx * dt;
+        s.y += s.vy * dt;
+
+        if (s.x < 0 || s.x > 800) s.vx = -s.vx;
+        if (s.y < 0 || s.y > 600) s.vy = -s.vy;
+    }
+}
+
+void draw()
+{
+    for (uint i = 0; i < sprites.length(); i++)
+    {
+        vd::graphics::drawImage(image, int(sprites[i].x), int(sprites[i].y));
+    }
+}
@@ -0,0 +1,36 @@
+array<string> labels;
+array<vd::Vector2> positions;
+
+void init()
+{
+    labels.resize(5000);
+    positions.resize(5000);
+
+    for (uint i = 0; i < labels.length(); i++)
+    {
+        labels[i] = "label " + vd::toString(int(i));
+        positions[i].x = vd::math::random() * 800;
+        positions[i].y = vd::math::random() * 600;
+    }
+}
+
+void update(float dt)
+{
+    for (uint i = 0; i < positions.length(); i++)
+    {
+        positions[i].x += 30 * dt;
+
+        if (positions[i].x >= 800)
+        {
+            positions[i].x -= 800;
+        }
+    }
+}
+
+void draw()
+{
+    for (uint i = 0; i < labels.length(); i++)
+    {
+        vd::graphics::print(labels[i], int(positions[i].x), int(positions[i].y));
+    }
+}
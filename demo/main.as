@@ -27,12 +27,9 @@ void update(float dt)
     for (uint i = 0; i < pixels.length(); i++)
     {
         pixels[i].position.y += 1;
-
-        if (pixels[i].position.y > 1000)
-        {
-            pixels.removeAt(i);
-        }
     }
+
+    pixels.removeIf(function(pixel) { return pixel.position.y > 1000; });
 }
 
 void draw()
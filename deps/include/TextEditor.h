@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <iosfwd>
 #include <vector>
 #include <array>
 #include <memory>
@@ -8,12 +9,16 @@
 #include <unordered_map>
 #include <map>
 #include <regex>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "imgui.h"
 
 class TextEditor
 {
 public:
-	enum class PaletteIndex
+	// One byte, it is stored in every colour run
+	enum class PaletteIndex : uint8_t
 	{
 		Default,
 		Keyword,
@@ -145,9 +150,20 @@ public:
 			mComment(false), mMultiLineComment(false), mPreprocessor(false) {}
 	};
 
+	// Lines are only expanded into glyphs to be drawn or lexed
 	typedef std::vector<Glyph> Line;
 	typedef std::vector<Line> Lines;
 
+	// Glyphs of a line that look the same, the colours are stored as runs per line
+	struct ColorRun
+	{
+		uint16_t mLength;
+		PaletteIndex mColorIndex;
+		uint8_t mFlags;
+	};
+
+	typedef std::vector<ColorRun> ColorRuns;
+
 	struct LanguageDefinition
 	{
 		typedef std::pair<std::string, PaletteIndex> TokenRegexString;
@@ -197,6 +213,8 @@ public:
 	void Render(const char* aTitle, const ImVec2& aSize = ImVec2(), bool aBorder = false);
 	void SetText(const std::string& aText);
 	std::string GetText() const;
+	// Writes what GetText returns without copying the text into one string
+	void WriteText(std::ostream& aStream) const;
 
 	void SetTextLines(const std::vector<std::string>& aLines);
 	std::vector<std::string> GetTextLines() const;
@@ -204,16 +222,22 @@ public:
 	std::string GetSelectedText() const;
 	std::string GetCurrentLineText()const;
 
-	int GetTotalLines() const { return (int)mLines.size(); }
+	int GetTotalLines() const { return mText.GetLineCount(); }
 	bool IsOverwrite() const { return mOverwrite; }
 
 	void SetReadOnly(bool aValue);
 	bool IsReadOnly() const { return mReadOnly; }
 	bool IsTextChanged() const { return mTextChanged; }
+	// Modified is tracked through the undo history, undoing back to the
+	// saved text makes it unmodified again
+	bool IsModified() const { return mUndoIndex != mSavedUndoIndex; }
+	void MarkSaved() { mSavedUndoIndex = mUndoIndex; }
 	bool IsCursorPositionChanged() const { return mCursorPositionChanged; }
 
 	bool IsColorizerEnabled() const { return mColorizerEnabled; }
 	void SetColorizerEnable(bool aValue);
+	// Colorizes everything now instead of a slice per frame while rendering
+	void ColorizeAll();
 
 	Coordinates GetCursorPosition() const { return GetActualCursorCoordinates(); }
 	void SetCursorPosition(const Coordinates& aPosition);
@@ -262,6 +286,15 @@ public:
 	void Undo(int aSteps = 1);
 	void Redo(int aSteps = 1);
 
+	// Selects the first match at or after the selection, Find keeps the current
+	// match while the search text is being typed, FindNext moves past it
+	bool Find(const std::string& aText, bool aCaseSensitive = true);
+	bool FindNext(const std::string& aText, bool aCaseSensitive = true);
+	int ReplaceAll(const std::string& aText, const std::string& aReplacement, bool aCaseSensitive = true);
+
+	// Offset of the first match at or after aFrom, or std::string::npos
+	static size_t FindInText(const char* aText, size_t aSize, const std::string& aPattern, size_t aFrom, bool aCaseSensitive);
+
 	static const Palette& GetDarkPalette();
 	static const Palette& GetLightPalette();
 	static const Palette& GetRetroBluePalette();
@@ -269,6 +302,60 @@ public:
 private:
 	typedef std::vector<std::pair<std::regex, PaletteIndex>> RegexList;
 
+	// The text is a piece table: the text SetText was given stays in one
+	// buffer, everything inserted later is appended to another, and the
+	// document is a list of pieces of the two. Edits split and splice pieces,
+	// so they cost the size of the edit and the number of pieces, not the
+	// size of the text. Each buffer indexes its line feeds to find lines.
+	class PieceTable
+	{
+	public:
+		struct Piece
+		{
+			bool mAdded;
+			size_t mStart;
+			size_t mLength;
+			int mLineFeeds;
+		};
+
+		typedef std::vector<Piece> Pieces;
+
+		PieceTable();
+
+		void Reset(std::string aText);
+		size_t GetSize() const { return mOffsets.back(); }
+		int GetLineCount() const { return mLineFeeds.back() + 1; }
+		size_t GetLineStart(int aLine) const;
+		size_t GetLineLength(int aLine) const;
+		void Read(size_t aOffset, size_t aLength, std::string& aResult) const;
+		void Write(std::ostream& aStream) const;
+		void Insert(size_t aOffset, const char* aText, size_t aLength);
+		void Erase(size_t aOffset, size_t aLength);
+		// Replaces aLength bytes at each of the sorted offsets in one pass
+		void Replace(const std::vector<size_t>& aOffsets, size_t aLength, const std::string& aReplacement);
+		const Pieces& GetPieces() const { return mPieces; }
+		void SetPieces(const Pieces& aPieces);
+
+	private:
+		const std::string& GetBuffer(const Piece& aPiece) const { return aPiece.mAdded ? mAdded : mOriginal; }
+		const std::vector<size_t>& GetBufferLineFeeds(const Piece& aPiece) const { return aPiece.mAdded ? mAddedLineFeeds : mOriginalLineFeeds; }
+		int CountLineFeeds(const Piece& aPiece) const;
+		size_t FindPiece(size_t aOffset) const;
+		size_t Split(size_t aOffset);
+		size_t Append(const char* aText, size_t aLength);
+		void Reindex(size_t aFrom);
+
+		std::string mOriginal;
+		std::string mAdded;
+		std::vector<size_t> mOriginalLineFeeds;
+		std::vector<size_t> mAddedLineFeeds;
+
+		Pieces mPieces;
+		// Document offset and line feeds before each piece, and at the end
+		std::vector<size_t> mOffsets;
+		std::vector<int> mLineFeeds;
+	};
+
 	struct EditorState
 	{
 		Coordinates mSelectionStart;
@@ -307,14 +394,61 @@ private:
 
 		EditorState mBefore;
 		EditorState mAfter;
+
+		// ReplaceAll keeps the pieces from before and after instead of text
+		bool mReplacedPieces = false;
+		PieceTable::Pieces mPiecesBefore;
+		PieceTable::Pieces mPiecesAfter;
 	};
 
 	typedef std::vector<UndoRecord> UndoBuffer;
 
+	// Lexer state at the start of a line, carried over from the lines above it
+	struct LineState
+	{
+		bool mValid = false;
+		bool mWithinString = false;
+		bool mWithinComment = false;
+		bool mConcatenate = false;
+		bool mWithinSingleLineComment = false;
+		bool mWithinPreproc = false;
+		bool mFirstChar = true;
+
+		bool operator ==(const LineState& o) const
+		{
+			return mValid == o.mValid && mWithinString == o.mWithinString && mWithinComment == o.mWithinComment &&
+				mConcatenate == o.mConcatenate && mWithinSingleLineComment == o.mWithinSingleLineComment &&
+				mWithinPreproc == o.mWithinPreproc && mFirstChar == o.mFirstChar;
+		}
+	};
+
+	typedef std::vector<LineState> LineStates;
+
+	// Copies of the lines to colorize, handed to the colorizer thread and back
+	struct ColorizeJob
+	{
+		enum class Status { Idle, Queued, Done };
+
+		Status mStatus = Status::Idle;
+		int mGeneration = 0;
+		int mFirstLine = 0;
+		int mCheckFrom = 0;
+		int mCount = 0;
+		bool mConverged = false;
+		Lines mLines;
+		LineStates mStates;
+	};
+
+	void UpdateSearchText();
+	bool FindFrom(const Coordinates& aFrom, const std::string& aText, bool aCaseSensitive);
+
 	void ProcessInputs();
 	void Colorize(int aFromLine = 0, int aCount = -1);
-	void ColorizeRange(int aFromLine = 0, int aToLine = 0);
+	void ColorizeLine(Line& aLine, LineState& aState, std::string& aBuffer) const;
+	int ColorizeLines(Line* aLines, int aCount, LineState* aStates, int aCheckFrom, bool& aConverged) const;
 	void ColorizeInternal();
+	void ColorizerThread();
+	void WaitForColorizer();
 	float TextDistanceToLineStart(const Coordinates& aFrom) const;
 	void EnsureCursorVisible();
 	int GetPageSize() const;
@@ -336,7 +470,16 @@ private:
 	bool IsOnWordBoundary(const Coordinates& aAt) const;
 	void RemoveLine(int aStart, int aEnd);
 	void RemoveLine(int aIndex);
-	Line& InsertLine(int aIndex);
+	void InsertLines(int aIndex, int aCount);
+	size_t GetOffset(int aLine, int aIndex) const;
+	const Line& GetLine(int aIndex) const;
+	void CopyLine(int aIndex, Line& aResult) const;
+	void InsertGlyphs(int aLine, int aIndex, const char* aText, int aLength, PaletteIndex aColor = PaletteIndex::Default);
+	void EraseGlyphs(int aLine, int aFrom, int aTo);
+	void JoinLines(int aLine);
+	void ResetLines();
+	void RestorePieces(const PieceTable::Pieces& aPieces);
+	void TextEdited();
 	void EnterCharacter(ImWchar aChar, bool aShift);
 	void Backspace();
 	void DeleteSelection();
@@ -349,10 +492,14 @@ private:
 	void Render();
 
 	float mLineSpacing;
-	Lines mLines;
+	PieceTable mText;
+	std::vector<ColorRuns> mLineColors;
+	// Lines expanded into glyphs since the last edit or frame
+	mutable std::unordered_map<int, Line> mLineCache;
 	EditorState mState;
 	UndoBuffer mUndoBuffer;
 	int mUndoIndex;
+	int mSavedUndoIndex;
 
 	int mTabSize;
 	bool mOverwrite;
@@ -377,7 +524,20 @@ private:
 	LanguageDefinition mLanguageDefinition;
 	RegexList mRegexList;
 
-	bool mCheckComments;
+	LineStates mLineStates;
+	int mColorizeGeneration;
+	int mColorizeLookahead;
+	ColorizeJob mColorizeJob;
+	std::thread mColorizerThread;
+	std::mutex mColorizerMutex;
+	std::condition_variable mColorizerCondition;
+	bool mColorizerQuit;
+
+	// Flat copy of the text for searching, rebuilt when the text changes
+	std::string mSearchText;
+	std::vector<size_t> mSearchLineStarts;
+	int mSearchGeneration;
+
 	Breakpoints mBreakpoints;
 	ErrorMarkers mErrorMarkers;
 	ImVec2 mCharAdvance;
@@ -83,12 +83,16 @@ public:
 	void RemoveAt(asUINT index);
 	void RemoveLast();
 	void RemoveRange(asUINT start, asUINT count);
+	void SwapRemove(asUINT index);
+	asUINT Compact(const CScriptArray *keepMask);
+	asUINT RemoveIf(asIScriptFunction *predicate);
 	void SortAsc();
 	void SortDesc();
 	void SortAsc(asUINT startAt, asUINT count);
 	void SortDesc(asUINT startAt, asUINT count);
 	void Sort(asUINT startAt, asUINT count, bool asc);
 	void Sort(asIScriptFunction *less, asUINT startAt, asUINT count);
+	void SortByKey(asIScriptFunction *key, bool asc);
 	void Reverse();
 	int  Find(void *value) const;
 	int  Find(asUINT startAt, void *value) const;
@@ -134,6 +138,7 @@ protected:
 	void  Construct(SArrayBuffer *buf, asUINT start, asUINT end);
 	void  Destruct(SArrayBuffer *buf, asUINT start, asUINT end);
 	bool  Equals(const void *a, const void *b, asIScriptContext *ctx, SArrayCache *cache) const;
+	asUINT RemoveUnmarked(const bool *keep);
 };
 
 void RegisterScriptArray(asIScriptEngine *engine, bool defaultArray);
@@ -16,23 +16,9 @@
 #include <string>
 typedef std::string dictKey_t;
 
-// Forward declare CScriptDictValue so we can typedef the internal map type
-BEGIN_AS_NAMESPACE
-class CScriptDictValue;
-END_AS_NAMESPACE
-
-// C++11 introduced the std::unordered_map which is a hash map which is
-// is generally more performatic for lookups than the std::map which is a
-// binary tree.
-// TODO: memory: The map allocator should use the asAllocMem and asFreeMem
-#if AS_CAN_USE_CPP11
-#include <unordered_map>
-typedef std::unordered_map<dictKey_t, AS_NAMESPACE_QUALIFIER CScriptDictValue> dictMap_t;
-#else
-#include <map>
-typedef std::map<dictKey_t, AS_NAMESPACE_QUALIFIER CScriptDictValue> dictMap_t;
-#endif
-
+// The dictionary stores its key/value pairs in the flat hash map
+// CScriptDictMap declared below, and interns the keys in a table
+// that is shared by all dictionaries of the same engine.
 
 #ifdef _MSC_VER
 // Turn off annoying warnings about truncated symbol names
@@ -106,6 +92,82 @@ protected:
 	int m_typeId;
 };
 
+// Dictionary keys are interned in a table shared by all dictionaries of the
+// engine, so each distinct key string is only stored once
+struct SDictKey
+{
+	dictKey_t str;
+	asUINT    hash;
+	int       refCount;
+};
+
+class CScriptDictKeyTable;
+
+// Flat hash map used as storage by the dictionary. The key/value pairs are
+// kept packed in a single buffer so iterating them is a linear walk, while
+// lookups probe a separate power of two index of hashes with open addressing
+// (deletes shift the following slots back instead of leaving tombstones).
+// Iteration follows insertion order until a key is deleted, the last pair is
+// then moved into the freed place, so deleting reorders the iteration and
+// getKeys. Scripts must not rely on the order of the keys
+class CScriptDictMap
+{
+public:
+	struct SEntry
+	{
+		SDictKey         *key;
+		CScriptDictValue  value;
+	};
+
+	typedef SEntry       *iterator;
+	typedef const SEntry *const_iterator;
+
+	CScriptDictMap();
+	~CScriptDictMap();
+
+	iterator       begin()       { return m_entries; }
+	iterator       end()         { return m_entries + m_size; }
+	const_iterator begin() const { return m_entries; }
+	const_iterator end() const   { return m_entries + m_size; }
+	asUINT         size() const  { return m_size; }
+
+	// Returns the entry with the key, or null if there is none
+	SEntry *Find(const dictKey_t &key, asUINT hash) const;
+
+	// Appends an entry for a key that isn't in the map yet
+	SEntry *Insert(SDictKey *key);
+
+	// Removes the entry by moving the last entry into its place. The
+	// value must already have been freed and the key released
+	void Erase(SEntry *entry);
+
+	// Removes all entries without freeing their values or keys
+	void Clear();
+
+protected:
+	struct SSlot
+	{
+		asUINT hash;
+		asUINT entry; // Index of the entry + 1, or 0 if the slot is free
+	};
+
+	void   Rehash(asUINT slotCount);
+	asUINT FindSlot(asUINT hash, asUINT entry) const;
+
+	SEntry *m_entries;
+	asUINT  m_size;
+	asUINT  m_capacity;
+	SSlot  *m_slots;
+	asUINT  m_mask;
+
+private:
+	// The entries are moved around with memcpy, so copying the map isn't supported
+	CScriptDictMap(const CScriptDictMap &);
+	CScriptDictMap &operator=(const CScriptDictMap &);
+};
+
+typedef CScriptDictMap dictMap_t;
+
 class CScriptDictionary
 {
 public:
@@ -149,7 +211,7 @@ public:
 	// Returns the number of key/value pairs in the dictionary
 	asUINT GetSize() const;
 
-	// Deletes the key
+	// Deletes the key. The last key/value pair is moved into its place
 	bool Delete(const dictKey_t &key);
 
 	// Deletes all keys
@@ -216,11 +278,15 @@ protected:
 	// Cache the object types needed
 	void Init(asIScriptEngine *engine);
 
+	// Returns the entry for the key, adding an empty one if it doesn't exist
+	dictMap_t::SEntry *FindOrInsert(const dictKey_t &key);
+
 	// Our properties
-	asIScriptEngine *engine;
-	mutable int      refCount;
-	mutable bool     gcFlag;
-	dictMap_t        dict;
+	asIScriptEngine     *engine;
+	mutable int          refCount;
+	mutable bool         gcFlag;
+	dictMap_t            dict;
+	CScriptDictKeyTable *keys;
 };
 
 // This function will determine the configuration of the engine
@@ -37,6 +37,10 @@
 
 BEGIN_AS_NAMESPACE
 
+// If set, the callback is asked first when a file is opened for reading. It
+// may return a buffer that outlives the file, which is then read in place.
+typedef bool (*SCRIPTFILE_OPEN_CALLBACK_t)(const std::string &filename, const char **data, size_t *size);
+
 class CScriptFile
 {
 public:
@@ -80,10 +84,20 @@ public:
 protected:
 	~CScriptFile();
 
+	size_t ReadBytes(void *buf, size_t size);
+
 	mutable int refCount;
 	FILE       *file;
+
+	// Used instead of file when the open callback provided the contents
+	const char *memory;
+	size_t      memorySize;
+	size_t      memoryPos;
+	bool        memoryEOF;
 };
 
+void SetScriptFileOpenCallback(SCRIPTFILE_OPEN_CALLBACK_t callback);
+
 // This function will determine the configuration of the engine
 // and use one of the two functions below to register the file type
 void RegisterScriptFile(asIScriptEngine *engine);
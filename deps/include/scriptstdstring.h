@@ -43,6 +43,9 @@ BEGIN_AS_NAMESPACE
 void RegisterStdString(asIScriptEngine *engine);
 void RegisterStdStringUtils(asIScriptEngine *engine);
 
+// Returns the hash of the string, as used for dictionary keys
+asUINT GetStdStringHash(const std::string &str);
+
 END_AS_NAMESPACE
 
 #endif
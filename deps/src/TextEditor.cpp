@@ -3,6 +3,9 @@
 #include <string>
 #include <regex>
 #include <cmath>
+#include <cstring>
+#include <climits>
+#include <ostream>
 
 #include "TextEditor.h"
 
@@ -24,9 +27,320 @@ bool equals(InputIt1 first1, InputIt1 last1,
 	return first1 == last1 && first2 == last2;
 }
 
+TextEditor::PieceTable::PieceTable()
+	: mOffsets(1, 0)
+	, mLineFeeds(1, 0)
+{
+}
+
+void TextEditor::PieceTable::Reset(std::string aText)
+{
+	mOriginal.swap(aText);
+	mAdded.clear();
+	mOriginalLineFeeds.clear();
+	mAddedLineFeeds.clear();
+
+	auto data = mOriginal.data();
+	auto end = data + mOriginal.size();
+	for (auto it = data; (it = (const char*)memchr(it, '\n', end - it)) != nullptr; ++it)
+		mOriginalLineFeeds.push_back(it - data);
+
+	mPieces.clear();
+	if (!mOriginal.empty())
+	{
+		Piece piece = { false, 0, mOriginal.size(), (int)mOriginalLineFeeds.size() };
+		mPieces.push_back(piece);
+	}
+	Reindex(0);
+}
+
+size_t TextEditor::PieceTable::GetLineStart(int aLine) const
+{
+	if (aLine <= 0)
+		return 0;
+	if (aLine >= GetLineCount())
+		return GetSize();
+
+	// The piece holding the line feed that ends the line before
+	auto index = (size_t)(std::lower_bound(mLineFeeds.begin(), mLineFeeds.end(), aLine) - mLineFeeds.begin()) - 1;
+	auto& piece = mPieces[index];
+	auto& feeds = GetBufferLineFeeds(piece);
+	auto first = std::lower_bound(feeds.begin(), feeds.end(), piece.mStart) - feeds.begin();
+	auto feed = feeds[first + (aLine - mLineFeeds[index] - 1)];
+
+	return mOffsets[index] + (feed - piece.mStart) + 1;
+}
+
+size_t TextEditor::PieceTable::GetLineLength(int aLine) const
+{
+	auto start = GetLineStart(aLine);
+	auto end = aLine + 1 < GetLineCount() ? GetLineStart(aLine + 1) - 1 : GetSize();
+	return end - start;
+}
+
+void TextEditor::PieceTable::Read(size_t aOffset, size_t aLength, std::string& aResult) const
+{
+	for (auto index = FindPiece(aOffset); aLength > 0 && index < mPieces.size(); ++index)
+	{
+		auto& piece = mPieces[index];
+		auto skip = aOffset - mOffsets[index];
+		auto count = std::min(aLength, piece.mLength - skip);
+		aResult.append(GetBuffer(piece), piece.mStart + skip, count);
+		aOffset += count;
+		aLength -= count;
+	}
+}
+
+void TextEditor::PieceTable::Write(std::ostream& aStream) const
+{
+	for (auto& piece : mPieces)
+		aStream.write(GetBuffer(piece).data() + piece.mStart, piece.mLength);
+}
+
+void TextEditor::PieceTable::Insert(size_t aOffset, const char* aText, size_t aLength)
+{
+	if (aLength == 0)
+		return;
+
+	// Typing appends to the end of the added buffer, so the piece before the
+	// cursor can grow instead of a new piece being made for every character
+	if (aOffset > 0)
+	{
+		auto index = FindPiece(aOffset - 1);
+		auto& piece = mPieces[index];
+		if (piece.mAdded && mOffsets[index + 1] == aOffset && piece.mStart + piece.mLength == mAdded.size())
+		{
+			auto feeds = mAddedLineFeeds.size();
+			Append(aText, aLength);
+			piece.mLength += aLength;
+			piece.mLineFeeds += (int)(mAddedLineFeeds.size() - feeds);
+			Reindex(index);
+			return;
+		}
+	}
+
+	auto feeds = mAddedLineFeeds.size();
+	Piece piece = { true, Append(aText, aLength), aLength, 0 };
+	piece.mLineFeeds = (int)(mAddedLineFeeds.size() - feeds);
+
+	auto index = Split(aOffset);
+	mPieces.insert(mPieces.begin() + index, piece);
+	Reindex(index);
+}
+
+void TextEditor::PieceTable::Erase(size_t aOffset, size_t aLength)
+{
+	if (aLength == 0)
+		return;
+
+	auto first = Split(aOffset);
+	auto last = Split(aOffset + aLength);
+	mPieces.erase(mPieces.begin() + first, mPieces.begin() + last);
+	Reindex(first);
+}
+
+void TextEditor::PieceTable::Replace(const std::vector<size_t>& aOffsets, size_t aLength, const std::string& aReplacement)
+{
+	// Every match points at the same copy of the replacement
+	auto feeds = mAddedLineFeeds.size();
+	Piece replacement = { true, Append(aReplacement.data(), aReplacement.size()), aReplacement.size(), 0 };
+	replacement.mLineFeeds = (int)(mAddedLineFeeds.size() - feeds);
+
+	Pieces result;
+	result.reserve(mPieces.size() + aOffsets.size() * 2);
+
+	size_t index = 0;
+	size_t position = 0;
+	auto advance = [&](size_t aTo, bool aKeep)
+	{
+		while (position < aTo)
+		{
+			auto& piece = mPieces[index];
+			auto skip = position - mOffsets[index];
+			auto count = std::min(aTo - position, piece.mLength - skip);
+			if (aKeep)
+			{
+				Piece part = { piece.mAdded, piece.mStart + skip, count, piece.mLineFeeds };
+				if (count != piece.mLength)
+					part.mLineFeeds = CountLineFeeds(part);
+				result.push_back(part);
+			}
+			position += count;
+			if (position == mOffsets[index + 1])
+				++index;
+		}
+	};
+
+	for (auto offset : aOffsets)
+	{
+		advance(offset, true);
+		advance(offset + aLength, false);
+		if (replacement.mLength > 0)
+			result.push_back(replacement);
+	}
+	advance(GetSize(), true);
+
+	mPieces.swap(result);
+	Reindex(0);
+}
+
+void TextEditor::PieceTable::SetPieces(const Pieces& aPieces)
+{
+	mPieces = aPieces;
+	Reindex(0);
+}
+
+int TextEditor::PieceTable::CountLineFeeds(const Piece& aPiece) const
+{
+	auto& feeds = GetBufferLineFeeds(aPiece);
+	auto first = std::lower_bound(feeds.begin(), feeds.end(), aPiece.mStart);
+	auto last = std::lower_bound(first, feeds.end(), aPiece.mStart + aPiece.mLength);
+	return (int)(last - first);
+}
+
+size_t TextEditor::PieceTable::FindPiece(size_t aOffset) const
+{
+	// mPieces.size() for the end of the text
+	return (size_t)(std::upper_bound(mOffsets.begin(), mOffsets.end(), aOffset) - mOffsets.begin()) - 1;
+}
+
+size_t TextEditor::PieceTable::Split(size_t aOffset)
+{
+	auto index = FindPiece(aOffset);
+	if (index == mPieces.size() || mOffsets[index] == aOffset)
+		return index;
+
+	auto& piece = mPieces[index];
+	auto head = aOffset - mOffsets[index];
+	Piece tail = { piece.mAdded, piece.mStart + head, piece.mLength - head, 0 };
+	tail.mLineFeeds = CountLineFeeds(tail);
+	piece.mLength = head;
+	piece.mLineFeeds -= tail.mLineFeeds;
+
+	mPieces.insert(mPieces.begin() + index + 1, tail);
+	Reindex(index);
+	return index + 1;
+}
+
+size_t TextEditor::PieceTable::Append(const char* aText, size_t aLength)
+{
+	auto start = mAdded.size();
+	mAdded.append(aText, aLength);
+
+	auto end = aText + aLength;
+	for (auto it = aText; (it = (const char*)memchr(it, '\n', end - it)) != nullptr; ++it)
+		mAddedLineFeeds.push_back(start + (it - aText));
+
+	return start;
+}
+
+void TextEditor::PieceTable::Reindex(size_t aFrom)
+{
+	mOffsets.resize(mPieces.size() + 1);
+	mLineFeeds.resize(mPieces.size() + 1);
+	for (auto i = aFrom; i < mPieces.size(); ++i)
+	{
+		mOffsets[i + 1] = mOffsets[i] + mPieces[i].mLength;
+		mLineFeeds[i + 1] = mLineFeeds[i] + mPieces[i].mLineFeeds;
+	}
+}
+
+static const uint8_t sCommentFlag = 1;
+static const uint8_t sMultiLineCommentFlag = 2;
+static const uint8_t sPreprocessorFlag = 4;
+
+// Appends to the last run when it looks the same, runs hold at most 65535 glyphs
+static void PushColors(TextEditor::ColorRuns& aRuns, int aLength, TextEditor::PaletteIndex aColor, uint8_t aFlags)
+{
+	while (aLength > 0)
+	{
+		if (aRuns.empty() || aRuns.back().mColorIndex != aColor || aRuns.back().mFlags != aFlags || aRuns.back().mLength == UINT16_MAX)
+		{
+			TextEditor::ColorRun run = { 0, aColor, aFlags };
+			aRuns.push_back(run);
+		}
+		auto count = std::min(aLength, UINT16_MAX - (int)aRuns.back().mLength);
+		aRuns.back().mLength += (uint16_t)count;
+		aLength -= count;
+	}
+}
+
+// Splits the runs so one starts at aIndex and returns its position
+static size_t SplitColors(TextEditor::ColorRuns& aRuns, int aIndex)
+{
+	size_t i = 0;
+	for (; i < aRuns.size() && aIndex > 0; ++i)
+	{
+		int length = aRuns[i].mLength;
+		if (aIndex < length)
+		{
+			auto tail = aRuns[i];
+			tail.mLength = (uint16_t)(length - aIndex);
+			aRuns[i].mLength = (uint16_t)aIndex;
+			aRuns.insert(aRuns.begin() + i + 1, tail);
+			return i + 1;
+		}
+		aIndex -= length;
+	}
+	return i;
+}
+
+static void InsertColors(TextEditor::ColorRuns& aRuns, int aIndex, int aLength, TextEditor::PaletteIndex aColor)
+{
+	if (aLength <= 0)
+		return;
+
+	TextEditor::ColorRuns inserted;
+	PushColors(inserted, aLength, aColor, 0);
+	auto at = SplitColors(aRuns, aIndex);
+	aRuns.insert(aRuns.begin() + at, inserted.begin(), inserted.end());
+}
+
+static void EraseColors(TextEditor::ColorRuns& aRuns, int aFrom, int aTo)
+{
+	auto first = SplitColors(aRuns, aFrom);
+	auto last = SplitColors(aRuns, aTo);
+	aRuns.erase(aRuns.begin() + first, aRuns.begin() + last);
+}
+
+static int GetColorsLength(const TextEditor::ColorRuns& aRuns)
+{
+	int length = 0;
+	for (auto& run : aRuns)
+		length += run.mLength;
+	return length;
+}
+
+static void CompressColors(const TextEditor::Line& aLine, TextEditor::ColorRuns& aRuns)
+{
+	aRuns.clear();
+	for (auto& glyph : aLine)
+	{
+		uint8_t flags = (glyph.mComment ? sCommentFlag : 0) | (glyph.mMultiLineComment ? sMultiLineCommentFlag : 0) | (glyph.mPreprocessor ? sPreprocessorFlag : 0);
+		PushColors(aRuns, 1, glyph.mColorIndex, flags);
+	}
+}
+
+static void ExpandColors(const TextEditor::ColorRuns& aRuns, TextEditor::Line& aLine)
+{
+	size_t i = 0;
+	for (auto& run : aRuns)
+	{
+		for (auto end = std::min(aLine.size(), i + run.mLength); i < end; ++i)
+		{
+			auto& glyph = aLine[i];
+			glyph.mColorIndex = run.mColorIndex;
+			glyph.mComment = (run.mFlags & sCommentFlag) != 0;
+			glyph.mMultiLineComment = (run.mFlags & sMultiLineCommentFlag) != 0;
+			glyph.mPreprocessor = (run.mFlags & sPreprocessorFlag) != 0;
+		}
+	}
+}
+
 TextEditor::TextEditor()
 	: mLineSpacing(1.0f)
 	, mUndoIndex(0)
+	, mSavedUndoIndex(0)
 	, mTabSize(4)
 	, mOverwrite(false)
 	, mReadOnly(false)
@@ -41,7 +355,10 @@ TextEditor::TextEditor()
 	, mColorRangeMin(0)
 	, mColorRangeMax(0)
 	, mSelectionMode(SelectionMode::Normal)
-	, mCheckComments(true)
+	, mColorizeGeneration(0)
+	, mColorizeLookahead(0)
+	, mColorizerQuit(false)
+	, mSearchGeneration(-1)
 	, mLastClick(-1.0f)
 	, mHandleKeyboardInputs(true)
 	, mHandleMouseInputs(true)
@@ -51,15 +368,29 @@ TextEditor::TextEditor()
 {
 	SetPalette(GetDarkPalette());
 	SetLanguageDefinition(LanguageDefinition::HLSL());
-	mLines.push_back(Line());
+	mLineColors.push_back(ColorRuns());
+	mLineStates.push_back(LineState());
+	mLineStates[0].mValid = true;
 }
 
 TextEditor::~TextEditor()
 {
+	if (mColorizerThread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mColorizerMutex);
+			mColorizerQuit = true;
+		}
+		mColorizerCondition.notify_all();
+		mColorizerThread.join();
+	}
 }
 
 void TextEditor::SetLanguageDefinition(const LanguageDefinition & aLanguageDef)
 {
+	// The colorizer thread reads the definition and the regexes while a job runs
+	WaitForColorizer();
+
 	mLanguageDefinition = aLanguageDef;
 	mRegexList.clear();
 
@@ -78,33 +409,25 @@ std::string TextEditor::GetText(const Coordinates & aStart, const Coordinates &
 {
 	std::string result;
 
-	auto lstart = aStart.mLine;
-	auto lend = aEnd.mLine;
-	auto istart = GetCharacterIndex(aStart);
-	auto iend = GetCharacterIndex(aEnd);
-	size_t s = 0;
+	if (aStart.mLine >= GetTotalLines())
+		return result;
 
-	for (size_t i = lstart; i < lend; i++)
-		s += mLines[i].size();
+	auto from = GetOffset(aStart.mLine, GetCharacterIndex(aStart));
 
-	result.reserve(s + s / 8);
-
-	while (istart < iend || lstart < lend)
+	// Past the last line means to the end, with the line break every line gets
+	if (aEnd.mLine >= GetTotalLines())
 	{
-		if (lstart >= (int)mLines.size())
-			break;
-
-		auto& line = mLines[lstart];
-		if (istart < (int)line.size())
-		{
-			result += line[istart].mChar;
-			istart++;
-		}
-		else
+		result.reserve(mText.GetSize() - from + 1);
+		mText.Read(from, mText.GetSize() - from, result);
+		result += '\n';
+	}
+	else
+	{
+		auto to = GetOffset(aEnd.mLine, GetCharacterIndex(aEnd));
+		if (to > from)
 		{
-			istart = 0;
-			++lstart;
-			result += '\n';
+			result.reserve(to - from);
+			mText.Read(from, to - from, result);
 		}
 	}
 
@@ -120,23 +443,15 @@ TextEditor::Coordinates TextEditor::SanitizeCoordinates(const Coordinates & aVal
 {
 	auto line = aValue.mLine;
 	auto column = aValue.mColumn;
-	if (line >= (int)mLines.size())
+	if (line >= GetTotalLines())
 	{
-		if (mLines.empty())
-		{
-			line = 0;
-			column = 0;
-		}
-		else
-		{
-			line = (int)mLines.size() - 1;
-			column = GetLineMaxColumn(line);
-		}
+		line = GetTotalLines() - 1;
+		column = GetLineMaxColumn(line);
 		return Coordinates(line, column);
 	}
 	else
 	{
-		column = mLines.empty() ? 0 : std::min(column, GetLineMaxColumn(line));
+		column = std::min(column, GetLineMaxColumn(line));
 		return Coordinates(line, column);
 	}
 }
@@ -198,9 +513,9 @@ static inline int ImTextCharToUtf8(char* buf, int buf_size, unsigned int c)
 
 void TextEditor::Advance(Coordinates & aCoordinates) const
 {
-	if (aCoordinates.mLine < (int)mLines.size())
+	if (aCoordinates.mLine < GetTotalLines())
 	{
-		auto& line = mLines[aCoordinates.mLine];
+		auto& line = GetLine(aCoordinates.mLine);
 		auto cindex = GetCharacterIndex(aCoordinates);
 
 		if (cindex + 1 < (int)line.size())
@@ -232,41 +547,36 @@ void TextEditor::DeleteRange(const Coordinates & aStart, const Coordinates & aEn
 
 	if (aStart.mLine == aEnd.mLine)
 	{
-		auto& line = mLines[aStart.mLine];
-		auto n = GetLineMaxColumn(aStart.mLine);
-		if (aEnd.mColumn >= n)
-			line.erase(line.begin() + start, line.end());
-		else
-			line.erase(line.begin() + start, line.begin() + end);
+		EraseGlyphs(aStart.mLine, start, end);
 	}
 	else
 	{
-		auto& firstLine = mLines[aStart.mLine];
-		auto& lastLine = mLines[aEnd.mLine];
-
-		firstLine.erase(firstLine.begin() + start, firstLine.end());
-		lastLine.erase(lastLine.begin(), lastLine.begin() + end);
+		auto from = GetOffset(aStart.mLine, start);
+		mText.Erase(from, GetOffset(aEnd.mLine, end) - from);
 
-		if (aStart.mLine < aEnd.mLine)
-			firstLine.insert(firstLine.end(), lastLine.begin(), lastLine.end());
+		// The start of the first line and the end of the last are joined
+		auto& firstColors = mLineColors[aStart.mLine];
+		auto& lastColors = mLineColors[aEnd.mLine];
+		EraseColors(firstColors, start, INT_MAX);
+		EraseColors(lastColors, 0, end);
+		firstColors.insert(firstColors.end(), lastColors.begin(), lastColors.end());
 
-		if (aStart.mLine < aEnd.mLine)
-			RemoveLine(aStart.mLine + 1, aEnd.mLine + 1);
+		RemoveLine(aStart.mLine + 1, aEnd.mLine + 1);
+		TextEdited();
 	}
-
-	mTextChanged = true;
 }
 
 int TextEditor::InsertTextAt(Coordinates& /* inout */ aWhere, const char * aValue)
 {
 	assert(!mReadOnly);
 
-	int cindex = GetCharacterIndex(aWhere);
-	int totalLines = 0;
+	// The text goes into the piece table in one insert, the lengths of the
+	// lines it makes are kept to give them colours
+	std::string text;
+	std::vector<int> lengths(1, 0);
+	int columns = 0;
 	while (*aValue != '\0')
 	{
-		assert(!mLines.empty());
-
 		if (*aValue == '\r')
 		{
 			// skip
@@ -274,35 +584,57 @@ int TextEditor::InsertTextAt(Coordinates& /* inout */ aWhere, const char * aValu
 		}
 		else if (*aValue == '\n')
 		{
-			if (cindex < (int)mLines[aWhere.mLine].size())
-			{
-				auto& newLine = InsertLine(aWhere.mLine + 1);
-				auto& line = mLines[aWhere.mLine];
-				newLine.insert(newLine.begin(), line.begin() + cindex, line.end());
-				line.erase(line.begin() + cindex, line.end());
-			}
-			else
-			{
-				InsertLine(aWhere.mLine + 1);
-			}
-			++aWhere.mLine;
-			aWhere.mColumn = 0;
-			cindex = 0;
-			++totalLines;
+			text += '\n';
+			lengths.push_back(0);
+			columns = 0;
 			++aValue;
 		}
 		else
 		{
-			auto& line = mLines[aWhere.mLine];
 			auto d = UTF8CharLength(*aValue);
 			while (d-- > 0 && *aValue != '\0')
-				line.insert(line.begin() + cindex++, Glyph(*aValue++, PaletteIndex::Default));
-			++aWhere.mColumn;
+			{
+				text += *aValue++;
+				++lengths.back();
+			}
+			++columns;
 		}
+	}
 
-		mTextChanged = true;
+	if (text.empty())
+		return 0;
+
+	int totalLines = (int)lengths.size() - 1;
+	int cindex = GetCharacterIndex(aWhere);
+
+	mText.Insert(GetOffset(aWhere.mLine, cindex), text.data(), text.size());
+
+	if (totalLines == 0)
+	{
+		InsertColors(mLineColors[aWhere.mLine], cindex, lengths[0], PaletteIndex::Default);
+		aWhere.mColumn += columns;
+	}
+	else
+	{
+		// The rest of the line ends up after the last inserted line
+		auto& colors = mLineColors[aWhere.mLine];
+		auto split = SplitColors(colors, cindex);
+		ColorRuns rest(colors.begin() + split, colors.end());
+		colors.erase(colors.begin() + split, colors.end());
+		InsertColors(colors, cindex, lengths[0], PaletteIndex::Default);
+
+		InsertLines(aWhere.mLine + 1, totalLines);
+		for (int i = 1; i <= totalLines; ++i)
+			InsertColors(mLineColors[aWhere.mLine + i], 0, lengths[i], PaletteIndex::Default);
+		auto& last = mLineColors[aWhere.mLine + totalLines];
+		last.insert(last.end(), rest.begin(), rest.end());
+
+		aWhere.mLine += totalLines;
+		aWhere.mColumn = columns;
 	}
 
+	TextEdited();
+
 	return totalLines;
 }
 
@@ -316,6 +648,10 @@ void TextEditor::AddUndo(UndoRecord& aValue)
 	//	aValue.mAfter.mCursorPosition.mLine, aValue.mAfter.mCursorPosition.mColumn
 	//	);
 
+	// The saved text can't be reached by undo once the redo past it is dropped
+	if (mSavedUndoIndex > mUndoIndex)
+		mSavedUndoIndex = -1;
+
 	mUndoBuffer.resize((size_t)(mUndoIndex + 1));
 	mUndoBuffer.back() = aValue;
 	++mUndoIndex;
@@ -330,9 +666,9 @@ TextEditor::Coordinates TextEditor::ScreenPosToCoordinates(const ImVec2& aPositi
 
 	int columnCoord = 0;
 
-	if (lineNo >= 0 && lineNo < (int)mLines.size())
+	if (lineNo >= 0 && lineNo < GetTotalLines())
 	{
-		auto& line = mLines.at(lineNo);
+		auto& line = GetLine(lineNo);
 
 		int columnIndex = 0;
 		float columnX = 0.0f;
@@ -376,10 +712,10 @@ TextEditor::Coordinates TextEditor::ScreenPosToCoordinates(const ImVec2& aPositi
 TextEditor::Coordinates TextEditor::FindWordStart(const Coordinates & aFrom) const
 {
 	Coordinates at = aFrom;
-	if (at.mLine >= (int)mLines.size())
+	if (at.mLine >= GetTotalLines())
 		return at;
 
-	auto& line = mLines[at.mLine];
+	auto& line = GetLine(at.mLine);
 	auto cindex = GetCharacterIndex(at);
 
 	if (cindex >= (int)line.size())
@@ -410,10 +746,10 @@ TextEditor::Coordinates TextEditor::FindWordStart(const Coordinates & aFrom) con
 TextEditor::Coordinates TextEditor::FindWordEnd(const Coordinates & aFrom) const
 {
 	Coordinates at = aFrom;
-	if (at.mLine >= (int)mLines.size())
+	if (at.mLine >= GetTotalLines())
 		return at;
 
-	auto& line = mLines[at.mLine];
+	auto& line = GetLine(at.mLine);
 	auto cindex = GetCharacterIndex(at);
 
 	if (cindex >= (int)line.size())
@@ -443,29 +779,29 @@ TextEditor::Coordinates TextEditor::FindWordEnd(const Coordinates & aFrom) const
 TextEditor::Coordinates TextEditor::FindNextWord(const Coordinates & aFrom) const
 {
 	Coordinates at = aFrom;
-	if (at.mLine >= (int)mLines.size())
+	if (at.mLine >= GetTotalLines())
 		return at;
 
 	// skip to the next non-word character
 	auto cindex = GetCharacterIndex(aFrom);
 	bool isword = false;
 	bool skip = false;
-	if (cindex < (int)mLines[at.mLine].size())
+	if (cindex < (int)GetLine(at.mLine).size())
 	{
-		auto& line = mLines[at.mLine];
+		auto& line = GetLine(at.mLine);
 		isword = isalnum(line[cindex].mChar);
 		skip = isword;
 	}
 
 	while (!isword || skip)
 	{
-		if (at.mLine >= mLines.size())
+		if (at.mLine >= GetTotalLines())
 		{
-			auto l = std::max(0, (int) mLines.size() - 1);
+			auto l = std::max(0, GetTotalLines() - 1);
 			return Coordinates(l, GetLineMaxColumn(l));
 		}
 
-		auto& line = mLines[at.mLine];
+		auto& line = GetLine(at.mLine);
 		if (cindex < (int)line.size())
 		{
 			isword = isalnum(line[cindex].mChar);
@@ -492,9 +828,9 @@ TextEditor::Coordinates TextEditor::FindNextWord(const Coordinates & aFrom) cons
 
 int TextEditor::GetCharacterIndex(const Coordinates& aCoordinates) const
 {
-	if (aCoordinates.mLine >= mLines.size())
+	if (aCoordinates.mLine >= GetTotalLines())
 		return -1;
-	auto& line = mLines[aCoordinates.mLine];
+	auto& line = GetLine(aCoordinates.mLine);
 	int c = 0;
 	int i = 0;
 	for (; i < line.size() && c < aCoordinates.mColumn;)
@@ -510,9 +846,9 @@ int TextEditor::GetCharacterIndex(const Coordinates& aCoordinates) const
 
 int TextEditor::GetCharacterColumn(int aLine, int aIndex) const
 {
-	if (aLine >= mLines.size())
+	if (aLine >= GetTotalLines())
 		return 0;
-	auto& line = mLines[aLine];
+	auto& line = GetLine(aLine);
 	int col = 0;
 	int i = 0;
 	while (i < aIndex && i < (int)line.size())
@@ -529,9 +865,9 @@ int TextEditor::GetCharacterColumn(int aLine, int aIndex) const
 
 int TextEditor::GetLineCharacterCount(int aLine) const
 {
-	if (aLine >= mLines.size())
+	if (aLine >= GetTotalLines())
 		return 0;
-	auto& line = mLines[aLine];
+	auto& line = GetLine(aLine);
 	int c = 0;
 	for (unsigned i = 0; i < line.size(); c++)
 		i += UTF8CharLength(line[i].mChar);
@@ -540,9 +876,9 @@ int TextEditor::GetLineCharacterCount(int aLine) const
 
 int TextEditor::GetLineMaxColumn(int aLine) const
 {
-	if (aLine >= mLines.size())
+	if (aLine >= GetTotalLines())
 		return 0;
-	auto& line = mLines[aLine];
+	auto& line = GetLine(aLine);
 	int col = 0;
 	for (unsigned i = 0; i < line.size(); )
 	{
@@ -558,10 +894,10 @@ int TextEditor::GetLineMaxColumn(int aLine) const
 
 bool TextEditor::IsOnWordBoundary(const Coordinates & aAt) const
 {
-	if (aAt.mLine >= (int)mLines.size() || aAt.mColumn == 0)
+	if (aAt.mLine >= GetTotalLines() || aAt.mColumn == 0)
 		return true;
 
-	auto& line = mLines[aAt.mLine];
+	auto& line = GetLine(aAt.mLine);
 	auto cindex = GetCharacterIndex(aAt);
 	if (cindex >= (int)line.size())
 		return true;
@@ -576,7 +912,7 @@ void TextEditor::RemoveLine(int aStart, int aEnd)
 {
 	assert(!mReadOnly);
 	assert(aEnd >= aStart);
-	assert(mLines.size() > (size_t)(aEnd - aStart));
+	assert((int)mLineColors.size() > aEnd - aStart);
 
 	ErrorMarkers etmp;
 	for (auto& i : mErrorMarkers)
@@ -597,8 +933,16 @@ void TextEditor::RemoveLine(int aStart, int aEnd)
 	}
 	mBreakpoints = std::move(btmp);
 
-	mLines.erase(mLines.begin() + aStart, mLines.begin() + aEnd);
-	assert(!mLines.empty());
+	mLineColors.erase(mLineColors.begin() + aStart, mLineColors.begin() + aEnd);
+	mLineStates.erase(mLineStates.begin() + aStart, mLineStates.begin() + aEnd);
+	assert((int)mLineColors.size() == GetTotalLines());
+
+	if (mColorRangeMin < mColorRangeMax)
+	{
+		mColorRangeMin = mColorRangeMin >= aEnd ? mColorRangeMin - (aEnd - aStart) : std::min(mColorRangeMin, aStart);
+		mColorRangeMax = mColorRangeMax >= aEnd ? mColorRangeMax - (aEnd - aStart) : std::min(mColorRangeMax, aStart);
+	}
+	mColorizeGeneration++;
 
 	mTextChanged = true;
 }
@@ -606,7 +950,7 @@ void TextEditor::RemoveLine(int aStart, int aEnd)
 void TextEditor::RemoveLine(int aIndex)
 {
 	assert(!mReadOnly);
-	assert(mLines.size() > 1);
+	assert(mLineColors.size() > 1);
 
 	ErrorMarkers etmp;
 	for (auto& i : mErrorMarkers)
@@ -627,29 +971,140 @@ void TextEditor::RemoveLine(int aIndex)
 	}
 	mBreakpoints = std::move(btmp);
 
-	mLines.erase(mLines.begin() + aIndex);
-	assert(!mLines.empty());
+	mLineColors.erase(mLineColors.begin() + aIndex);
+	mLineStates.erase(mLineStates.begin() + aIndex);
+	assert((int)mLineColors.size() == GetTotalLines());
+
+	if (mColorRangeMin < mColorRangeMax)
+	{
+		if (mColorRangeMin > aIndex)
+			mColorRangeMin--;
+		if (mColorRangeMax > aIndex)
+			mColorRangeMax--;
+	}
+	mColorizeGeneration++;
 
 	mTextChanged = true;
 }
 
-TextEditor::Line& TextEditor::InsertLine(int aIndex)
+void TextEditor::InsertLines(int aIndex, int aCount)
 {
 	assert(!mReadOnly);
 
-	auto& result = *mLines.insert(mLines.begin() + aIndex, Line());
+	int count = aCount;
+	mLineColors.insert(mLineColors.begin() + aIndex, count, ColorRuns());
+	mLineStates.insert(mLineStates.begin() + aIndex, count, LineState());
+
+	if (mColorRangeMin < mColorRangeMax)
+	{
+		if (mColorRangeMin > aIndex)
+			mColorRangeMin += count;
+		if (mColorRangeMax > aIndex)
+			mColorRangeMax += count;
+	}
+	mColorizeGeneration++;
 
 	ErrorMarkers etmp;
 	for (auto& i : mErrorMarkers)
-		etmp.insert(ErrorMarkers::value_type(i.first >= aIndex ? i.first + 1 : i.first, i.second));
+		etmp.insert(ErrorMarkers::value_type(i.first >= aIndex ? i.first + count : i.first, i.second));
 	mErrorMarkers = std::move(etmp);
 
 	Breakpoints btmp;
 	for (auto i : mBreakpoints)
-		btmp.insert(i >= aIndex ? i + 1 : i);
+		btmp.insert(i >= aIndex ? i + count : i);
 	mBreakpoints = std::move(btmp);
+}
 
-	return result;
+size_t TextEditor::GetOffset(int aLine, int aIndex) const
+{
+	return mText.GetLineStart(aLine) + aIndex;
+}
+
+const TextEditor::Line& TextEditor::GetLine(int aIndex) const
+{
+	auto it = mLineCache.find(aIndex);
+	if (it != mLineCache.end())
+		return it->second;
+
+	auto& line = mLineCache[aIndex];
+	CopyLine(aIndex, line);
+	ExpandColors(mLineColors[aIndex], line);
+	return line;
+}
+
+void TextEditor::CopyLine(int aIndex, Line& aResult) const
+{
+	std::string text;
+	mText.Read(mText.GetLineStart(aIndex), mText.GetLineLength(aIndex), text);
+
+	aResult.clear();
+	aResult.reserve(text.size());
+	for (auto chr : text)
+		aResult.emplace_back(Glyph(chr, PaletteIndex::Default));
+}
+
+void TextEditor::InsertGlyphs(int aLine, int aIndex, const char* aText, int aLength, PaletteIndex aColor)
+{
+	mText.Insert(GetOffset(aLine, aIndex), aText, aLength);
+	InsertColors(mLineColors[aLine], aIndex, aLength, aColor);
+	TextEdited();
+}
+
+void TextEditor::EraseGlyphs(int aLine, int aFrom, int aTo)
+{
+	if (aTo <= aFrom)
+		return;
+
+	mText.Erase(GetOffset(aLine, aFrom), aTo - aFrom);
+	EraseColors(mLineColors[aLine], aFrom, aTo);
+	TextEdited();
+}
+
+void TextEditor::JoinLines(int aLine)
+{
+	mText.Erase(GetOffset(aLine + 1, 0) - 1, 1);
+
+	auto& colors = mLineColors[aLine];
+	auto& next = mLineColors[aLine + 1];
+	colors.insert(colors.end(), next.begin(), next.end());
+
+	RemoveLine(aLine + 1);
+	TextEdited();
+}
+
+void TextEditor::ResetLines()
+{
+	// Colours stay on lines that kept their length until they are lexed again
+	int count = GetTotalLines();
+	if ((int)mLineColors.size() != count)
+		mLineColors.assign(count, ColorRuns());
+	for (int i = 0; i < count; ++i)
+	{
+		auto& colors = mLineColors[i];
+		auto length = (int)mText.GetLineLength(i);
+		if (GetColorsLength(colors) != length)
+		{
+			colors.clear();
+			PushColors(colors, length, PaletteIndex::Default, 0);
+		}
+	}
+
+	mLineStates.assign(count, LineState());
+	mLineStates[0].mValid = true;
+	TextEdited();
+}
+
+void TextEditor::RestorePieces(const PieceTable::Pieces& aPieces)
+{
+	mText.SetPieces(aPieces);
+	ResetLines();
+	Colorize();
+}
+
+void TextEditor::TextEdited()
+{
+	mLineCache.clear();
+	mTextChanged = true;
 }
 
 std::string TextEditor::GetWordUnderCursor() const
@@ -668,8 +1123,8 @@ std::string TextEditor::GetWordAt(const Coordinates & aCoords) const
 	auto istart = GetCharacterIndex(start);
 	auto iend = GetCharacterIndex(end);
 
-	for (auto it = istart; it < iend; ++it)
-		r.push_back(mLines[aCoords.mLine][it].mChar);
+	if (iend > istart)
+		mText.Read(GetOffset(aCoords.mLine, istart), iend - istart, r);
 
 	return r;
 }
@@ -882,15 +1337,17 @@ void TextEditor::Render()
 	auto scrollY = ImGui::GetScrollY();
 
 	auto lineNo = (int)floor(scrollY / mCharAdvance.y);
-	auto globalLineMax = (int)mLines.size();
-	auto lineMax = std::max(0, std::min((int)mLines.size() - 1, lineNo + (int)floor((scrollY + contentSize.y) / mCharAdvance.y)));
+	auto globalLineMax = GetTotalLines();
+	auto lineMax = std::max(0, std::min(GetTotalLines() - 1, lineNo + (int)floor((scrollY + contentSize.y) / mCharAdvance.y)));
 
-	// Deduce mTextStart by evaluating mLines size (global lineMax) plus two spaces as text width
+	// Deduce mTextStart by evaluating the line count (global lineMax) plus two spaces as text width
 	char buf[16];
 	snprintf(buf, 16, " %d ", globalLineMax);
 	mTextStart = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf, nullptr, nullptr).x + mLeftMargin;
 
-	if (!mLines.empty())
+	// Only the lines drawn this frame stay expanded
+	mLineCache.clear();
+
 	{
 		float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ", nullptr, nullptr).x;
 
@@ -899,7 +1356,7 @@ void TextEditor::Render()
 			ImVec2 lineStartScreenPos = ImVec2(cursorScreenPos.x, cursorScreenPos.y + lineNo * mCharAdvance.y);
 			ImVec2 textScreenPos = ImVec2(lineStartScreenPos.x + mTextStart, lineStartScreenPos.y);
 
-			auto& line = mLines[lineNo];
+			auto& line = GetLine(lineNo);
 			longest = std::max(mTextStart + TextDistanceToLineStart(Coordinates(lineNo, GetLineMaxColumn(lineNo))), longest);
 			auto columnNo = 0;
 			Coordinates lineStartCoord(lineNo, 0);
@@ -1108,7 +1565,7 @@ void TextEditor::Render()
 	}
 
 
-	ImGui::Dummy(ImVec2((longest + 2), mLines.size() * mCharAdvance.y));
+	ImGui::Dummy(ImVec2((longest + 2), GetTotalLines() * mCharAdvance.y));
 
 	if (mScrollToCursor)
 	{
@@ -1155,58 +1612,49 @@ void TextEditor::Render(const char* aTitle, const ImVec2& aSize, bool aBorder)
 
 void TextEditor::SetText(const std::string & aText)
 {
-	mLines.clear();
-	mLines.emplace_back(Line());
+	std::string text;
+	text.reserve(aText.size());
 	for (auto chr : aText)
 	{
-		if (chr == '\r')
-		{
-			// ignore the carriage return character
-		}
-		else if (chr == '\n')
-			mLines.emplace_back(Line());
-		else
-		{
-			mLines.back().emplace_back(Glyph(chr, PaletteIndex::Default));
-		}
+		// ignore the carriage return character
+		if (chr != '\r')
+			text += chr;
 	}
 
+	mText.Reset(std::move(text));
+	mLineColors.clear();
+	ResetLines();
+
 	mTextChanged = true;
 	mScrollToTop = true;
 
 	mUndoBuffer.clear();
 	mUndoIndex = 0;
+	mSavedUndoIndex = 0;
 
 	Colorize();
 }
 
 void TextEditor::SetTextLines(const std::vector<std::string> & aLines)
 {
-	mLines.clear();
-
-	if (aLines.empty())
+	std::string text;
+	for (size_t i = 0; i < aLines.size(); ++i)
 	{
-		mLines.emplace_back(Line());
+		if (i > 0)
+			text += '\n';
+		text += aLines[i];
 	}
-	else
-	{
-		mLines.resize(aLines.size());
-
-		for (size_t i = 0; i < aLines.size(); ++i)
-		{
-			const std::string & aLine = aLines[i];
 
-			mLines[i].reserve(aLine.size());
-			for (size_t j = 0; j < aLine.size(); ++j)
-				mLines[i].emplace_back(Glyph(aLine[j], PaletteIndex::Default));
-		}
-	}
+	mText.Reset(std::move(text));
+	mLineColors.clear();
+	ResetLines();
 
 	mTextChanged = true;
 	mScrollToTop = true;
 
 	mUndoBuffer.clear();
 	mUndoIndex = 0;
+	mSavedUndoIndex = 0;
 
 	Colorize();
 }
@@ -1231,11 +1679,11 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 			if (start > end)
 				std::swap(start, end);
 			start.mColumn = 0;
-			//			end.mColumn = end.mLine < mLines.size() ? mLines[end.mLine].size() : 0;
+			//			end.mColumn = end.mLine < GetTotalLines() ? GetLine(end.mLine).size() : 0;
 			if (end.mColumn == 0 && end.mLine > 0)
 				--end.mLine;
-			if (end.mLine >= (int)mLines.size())
-				end.mLine = mLines.empty() ? 0 : (int)mLines.size() - 1;
+			if (end.mLine >= GetTotalLines())
+				end.mLine = GetTotalLines() - 1;
 			end.mColumn = GetLineMaxColumn(end.mLine);
 
 			//if (end.mColumn >= GetLineMaxColumn(end.mLine))
@@ -1249,21 +1697,24 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 
 			for (int i = start.mLine; i <= end.mLine; i++)
 			{
-				auto& line = mLines[i];
+				auto& line = GetLine(i);
 				if (aShift)
 				{
 					if (!line.empty())
 					{
 						if (line.front().mChar == '\t')
 						{
-							line.erase(line.begin());
+							EraseGlyphs(i, 0, 1);
 							modified = true;
 						}
 						else
 						{
-							for (int j = 0; j < mTabSize && !line.empty() && line.front().mChar == ' '; j++)
+							int spaces = 0;
+							while (spaces < mTabSize && spaces < (int)line.size() && line[spaces].mChar == ' ')
+								++spaces;
+							if (spaces > 0)
 							{
-								line.erase(line.begin());
+								EraseGlyphs(i, 0, spaces);
 								modified = true;
 							}
 						}
@@ -1271,7 +1722,7 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 				}
 				else
 				{
-					line.insert(line.begin(), Glyph('\t', TextEditor::PaletteIndex::Background));
+					InsertGlyphs(i, 0, "\t", 1, PaletteIndex::Background);
 					modified = true;
 				}
 			}
@@ -1320,22 +1771,18 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 	auto coord = GetActualCursorCoordinates();
 	u.mAddedStart = coord;
 
-	assert(!mLines.empty());
-
 	if (aChar == '\n')
 	{
-		InsertLine(coord.mLine + 1);
-		auto& line = mLines[coord.mLine];
-		auto& newLine = mLines[coord.mLine + 1];
+		auto& line = GetLine(coord.mLine);
+		std::string text(1, '\n');
 
 		if (mLanguageDefinition.mAutoIndentation)
 			for (size_t it = 0; it < line.size() && isascii(line[it].mChar) && isblank(line[it].mChar); ++it)
-				newLine.push_back(line[it]);
+				text += line[it].mChar;
 
-		const size_t whitespaceSize = newLine.size();
-		auto cindex = GetCharacterIndex(coord);
-		newLine.insert(newLine.end(), line.begin() + cindex, line.end());
-		line.erase(line.begin() + cindex, line.begin() + line.size());
+		const size_t whitespaceSize = text.size() - 1;
+		auto where = coord;
+		InsertTextAt(where, text.c_str());
 		SetCursorPosition(Coordinates(coord.mLine + 1, GetCharacterColumn(coord.mLine + 1, (int)whitespaceSize)));
 		u.mAdded = (char)aChar;
 	}
@@ -1346,7 +1793,7 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 		if (e > 0)
 		{
 			buf[e] = '\0';
-			auto& line = mLines[coord.mLine];
+			auto& line = GetLine(coord.mLine);
 			auto cindex = GetCharacterIndex(coord);
 
 			if (mOverwrite && cindex < (int)line.size())
@@ -1356,15 +1803,14 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 				u.mRemovedStart = mState.mCursorPosition;
 				u.mRemovedEnd = Coordinates(coord.mLine, GetCharacterColumn(coord.mLine, cindex + d));
 
-				while (d-- > 0 && cindex < (int)line.size())
-				{
-					u.mRemoved += line[cindex].mChar;
-					line.erase(line.begin() + cindex);
-				}
+				auto end = std::min(cindex + d, (int)line.size());
+				for (int i = cindex; i < end; ++i)
+					u.mRemoved += line[i].mChar;
+				EraseGlyphs(coord.mLine, cindex, end);
 			}
 
-			for (auto p = buf; *p != '\0'; p++, ++cindex)
-				line.insert(line.begin() + cindex, Glyph(*p, PaletteIndex::Default));
+			InsertGlyphs(coord.mLine, cindex, buf, e);
+			cindex += e;
 			u.mAdded = buf;
 
 			SetCursorPosition(Coordinates(coord.mLine, GetCharacterColumn(coord.mLine, cindex)));
@@ -1442,7 +1888,6 @@ void TextEditor::SetSelection(const Coordinates & aStart, const Coordinates & aE
 	case TextEditor::SelectionMode::Line:
 	{
 		const auto lineNo = mState.mSelectionEnd.mLine;
-		const auto lineSize = (size_t)lineNo < mLines.size() ? mLines[lineNo].size() : 0;
 		mState.mSelectionStart = Coordinates(mState.mSelectionStart.mLine, 0);
 		mState.mSelectionEnd = Coordinates(lineNo, GetLineMaxColumn(lineNo));
 		break;
@@ -1526,7 +1971,7 @@ void TextEditor::MoveDown(int aAmount, bool aSelect)
 {
 	assert(mState.mCursorPosition.mColumn >= 0);
 	auto oldPos = mState.mCursorPosition;
-	mState.mCursorPosition.mLine = std::max(0, std::min((int)mLines.size() - 1, mState.mCursorPosition.mLine + aAmount));
+	mState.mCursorPosition.mLine = std::max(0, std::min(GetTotalLines() - 1, mState.mCursorPosition.mLine + aAmount));
 
 	if (mState.mCursorPosition != oldPos)
 	{
@@ -1557,9 +2002,6 @@ static bool IsUTFSequence(char c)
 
 void TextEditor::MoveLeft(int aAmount, bool aSelect, bool aWordMode)
 {
-	if (mLines.empty())
-		return;
-
 	auto oldPos = mState.mCursorPosition;
 	mState.mCursorPosition = GetActualCursorCoordinates();
 	auto line = mState.mCursorPosition.mLine;
@@ -1572,8 +2014,8 @@ void TextEditor::MoveLeft(int aAmount, bool aSelect, bool aWordMode)
 			if (line > 0)
 			{
 				--line;
-				if ((int)mLines.size() > line)
-					cindex = (int)mLines[line].size();
+				if (GetTotalLines() > line)
+					cindex = (int)GetLine(line).size();
 				else
 					cindex = 0;
 			}
@@ -1583,9 +2025,9 @@ void TextEditor::MoveLeft(int aAmount, bool aSelect, bool aWordMode)
 			--cindex;
 			if (cindex > 0)
 			{
-				if ((int)mLines.size() > line)
+				if (GetTotalLines() > line)
 				{
-					while (cindex > 0 && IsUTFSequence(mLines[line][cindex].mChar))
+					while (cindex > 0 && IsUTFSequence(GetLine(line)[cindex].mChar))
 						--cindex;
 				}
 			}
@@ -1625,20 +2067,20 @@ void TextEditor::MoveRight(int aAmount, bool aSelect, bool aWordMode)
 {
 	auto oldPos = mState.mCursorPosition;
 
-	if (mLines.empty() || oldPos.mLine >= mLines.size())
+	if (oldPos.mLine >= GetTotalLines())
 		return;
 
 	auto cindex = GetCharacterIndex(mState.mCursorPosition);
 	while (aAmount-- > 0)
 	{
 		auto lindex = mState.mCursorPosition.mLine;
-		auto& line = mLines[lindex];
+		auto& line = GetLine(lindex);
 
 		if (cindex >= line.size())
 		{
-			if (mState.mCursorPosition.mLine < mLines.size() - 1)
+			if (mState.mCursorPosition.mLine < GetTotalLines() - 1)
 			{
-				mState.mCursorPosition.mLine = std::max(0, std::min((int)mLines.size() - 1, mState.mCursorPosition.mLine + 1));
+				mState.mCursorPosition.mLine = std::max(0, std::min(GetTotalLines() - 1, mState.mCursorPosition.mLine + 1));
 				mState.mCursorPosition.mColumn = 0;
 			}
 			else
@@ -1693,7 +2135,7 @@ void TextEditor::MoveTop(bool aSelect)
 void TextEditor::TextEditor::MoveBottom(bool aSelect)
 {
 	auto oldPos = GetCursorPosition();
-	auto newPos = Coordinates((int)mLines.size() - 1, 0);
+	auto newPos = Coordinates(GetTotalLines() - 1, 0);
 	SetCursorPosition(newPos);
 	if (aSelect)
 	{
@@ -1759,9 +2201,6 @@ void TextEditor::Delete()
 {
 	assert(!mReadOnly);
 
-	if (mLines.empty())
-		return;
-
 	UndoRecord u;
 	u.mBefore = mState;
 
@@ -1777,31 +2216,28 @@ void TextEditor::Delete()
 	{
 		auto pos = GetActualCursorCoordinates();
 		SetCursorPosition(pos);
-		auto& line = mLines[pos.mLine];
 
 		if (pos.mColumn == GetLineMaxColumn(pos.mLine))
 		{
-			if (pos.mLine == (int)mLines.size() - 1)
+			if (pos.mLine == GetTotalLines() - 1)
 				return;
 
 			u.mRemoved = '\n';
 			u.mRemovedStart = u.mRemovedEnd = GetActualCursorCoordinates();
 			Advance(u.mRemovedEnd);
 
-			auto& nextLine = mLines[pos.mLine + 1];
-			line.insert(line.end(), nextLine.begin(), nextLine.end());
-			RemoveLine(pos.mLine + 1);
+			JoinLines(pos.mLine);
 		}
 		else
 		{
+			auto& line = GetLine(pos.mLine);
 			auto cindex = GetCharacterIndex(pos);
 			u.mRemovedStart = u.mRemovedEnd = GetActualCursorCoordinates();
 			u.mRemovedEnd.mColumn++;
 			u.mRemoved = GetText(u.mRemovedStart, u.mRemovedEnd);
 
 			auto d = UTF8CharLength(line[cindex].mChar);
-			while (d-- > 0 && cindex < (int)line.size())
-				line.erase(line.begin() + cindex);
+			EraseGlyphs(pos.mLine, cindex, std::min(cindex + d, (int)line.size()));
 		}
 
 		mTextChanged = true;
@@ -1817,9 +2253,6 @@ void TextEditor::Backspace()
 {
 	assert(!mReadOnly);
 
-	if (mLines.empty())
-		return;
-
 	UndoRecord u;
 	u.mBefore = mState;
 
@@ -1845,23 +2278,20 @@ void TextEditor::Backspace()
 			u.mRemovedStart = u.mRemovedEnd = Coordinates(pos.mLine - 1, GetLineMaxColumn(pos.mLine - 1));
 			Advance(u.mRemovedEnd);
 
-			auto& line = mLines[mState.mCursorPosition.mLine];
-			auto& prevLine = mLines[mState.mCursorPosition.mLine - 1];
 			auto prevSize = GetLineMaxColumn(mState.mCursorPosition.mLine - 1);
-			prevLine.insert(prevLine.end(), line.begin(), line.end());
 
 			ErrorMarkers etmp;
 			for (auto& i : mErrorMarkers)
 				etmp.insert(ErrorMarkers::value_type(i.first - 1 == mState.mCursorPosition.mLine ? i.first - 1 : i.first, i.second));
 			mErrorMarkers = std::move(etmp);
 
-			RemoveLine(mState.mCursorPosition.mLine);
+			JoinLines(mState.mCursorPosition.mLine - 1);
 			--mState.mCursorPosition.mLine;
 			mState.mCursorPosition.mColumn = prevSize;
 		}
 		else
 		{
-			auto& line = mLines[mState.mCursorPosition.mLine];
+			auto& line = GetLine(mState.mCursorPosition.mLine);
 			auto cindex = GetCharacterIndex(pos) - 1;
 			auto cend = cindex + 1;
 			while (cindex > 0 && IsUTFSequence(line[cindex].mChar))
@@ -1874,11 +2304,10 @@ void TextEditor::Backspace()
 			--u.mRemovedStart.mColumn;
 			--mState.mCursorPosition.mColumn;
 
-			while (cindex < line.size() && cend-- > cindex)
-			{
-				u.mRemoved += line[cindex].mChar;
-				line.erase(line.begin() + cindex);
-			}
+			auto end = std::min(cend, (int)line.size());
+			for (int i = cindex; i < end; ++i)
+				u.mRemoved += line[i].mChar;
+			EraseGlyphs(mState.mCursorPosition.mLine, cindex, end);
 		}
 
 		mTextChanged = true;
@@ -1899,7 +2328,7 @@ void TextEditor::SelectWordUnderCursor()
 
 void TextEditor::SelectAll()
 {
-	SetSelection(Coordinates(0, 0), Coordinates((int)mLines.size(), 0));
+	SetSelection(Coordinates(0, 0), Coordinates(GetTotalLines(), 0));
 }
 
 bool TextEditor::HasSelection() const
@@ -1915,10 +2344,9 @@ void TextEditor::Copy()
 	}
 	else
 	{
-		if (!mLines.empty())
 		{
 			std::string str;
-			auto& line = mLines[GetActualCursorCoordinates().mLine];
+			auto& line = GetLine(GetActualCursorCoordinates().mLine);
 			for (auto& g : line)
 				str.push_back(g.mChar);
 			ImGui::SetClipboardText(str.c_str());
@@ -1981,19 +2409,192 @@ void TextEditor::Paste()
 	}
 }
 
-bool TextEditor::CanUndo() const
+size_t TextEditor::FindInText(const char* aText, size_t aSize, const std::string& aPattern, size_t aFrom, bool aCaseSensitive)
 {
-	return !mReadOnly && mUndoIndex > 0;
-}
+	const size_t length = aPattern.size();
+	if (length == 0 || aSize < length || aFrom > aSize - length)
+		return std::string::npos;
 
-bool TextEditor::CanRedo() const
-{
-	return !mReadOnly && mUndoIndex < (int)mUndoBuffer.size();
-}
+	const char* pattern = aPattern.c_str();
+	const char lower = (char)tolower((unsigned char)pattern[0]);
+	const char upper = (char)toupper((unsigned char)pattern[0]);
+	const bool folded = !aCaseSensitive && lower != upper;
 
-void TextEditor::Undo(int aSteps)
-{
-	while (CanUndo() && aSteps-- > 0)
+	// Candidates are found by scanning for the first byte with memchr, only
+	// those get compared in full
+	const char* end = aText + aSize - length + 1;
+	const char* p = aText + aFrom;
+
+	while (p < end)
+	{
+		const char* hit = (const char*)memchr(p, folded ? lower : pattern[0], end - p);
+
+		if (folded)
+		{
+			const char* other = (const char*)memchr(p, upper, (hit != nullptr ? hit : end) - p);
+			if (other != nullptr)
+				hit = other;
+		}
+
+		if (hit == nullptr)
+			return std::string::npos;
+
+		bool match;
+		if (aCaseSensitive)
+			match = memcmp(hit + 1, pattern + 1, length - 1) == 0;
+		else
+		{
+			match = true;
+			for (size_t i = 1; i < length && match; ++i)
+				match = tolower((unsigned char)hit[i]) == tolower((unsigned char)pattern[i]);
+		}
+
+		if (match)
+			return hit - aText;
+
+		p = hit + 1;
+	}
+
+	return std::string::npos;
+}
+
+void TextEditor::UpdateSearchText()
+{
+	if (mSearchGeneration == mColorizeGeneration)
+		return;
+
+	mSearchText.clear();
+	mSearchText.reserve(mText.GetSize());
+	mText.Read(0, mText.GetSize(), mSearchText);
+
+	mSearchLineStarts.assign(1, 0);
+	mSearchLineStarts.reserve(GetTotalLines());
+
+	auto data = mSearchText.data();
+	auto end = data + mSearchText.size();
+	for (auto it = data; (it = (const char*)memchr(it, '\n', end - it)) != nullptr; ++it)
+		mSearchLineStarts.push_back(it - data + 1);
+
+	mSearchGeneration = mColorizeGeneration;
+}
+
+bool TextEditor::FindFrom(const Coordinates& aFrom, const std::string& aText, bool aCaseSensitive)
+{
+	UpdateSearchText();
+
+	auto from = SanitizeCoordinates(aFrom);
+	size_t offset = mSearchLineStarts[from.mLine] + GetCharacterIndex(from);
+
+	size_t found = FindInText(mSearchText.data(), mSearchText.size(), aText, offset, aCaseSensitive);
+	if (found == std::string::npos)
+		found = FindInText(mSearchText.data(), mSearchText.size(), aText, 0, aCaseSensitive);
+
+	if (found == std::string::npos)
+		return false;
+
+	auto toCoordinates = [this](size_t aOffset) {
+		int line = int(std::upper_bound(mSearchLineStarts.begin(), mSearchLineStarts.end(), aOffset) - mSearchLineStarts.begin()) - 1;
+		return Coordinates(line, GetCharacterColumn(line, int(aOffset - mSearchLineStarts[line])));
+	};
+
+	auto start = toCoordinates(found);
+	auto end = toCoordinates(found + aText.size());
+
+	SetSelection(start, end);
+	SetCursorPosition(end);
+
+	return true;
+}
+
+bool TextEditor::Find(const std::string& aText, bool aCaseSensitive)
+{
+	return FindFrom(HasSelection() ? mState.mSelectionStart : mState.mCursorPosition, aText, aCaseSensitive);
+}
+
+bool TextEditor::FindNext(const std::string& aText, bool aCaseSensitive)
+{
+	return FindFrom(HasSelection() ? mState.mSelectionEnd : mState.mCursorPosition, aText, aCaseSensitive);
+}
+
+int TextEditor::ReplaceAll(const std::string& aText, const std::string& aReplacement, bool aCaseSensitive)
+{
+	if (IsReadOnly() || aText.empty())
+		return 0;
+
+	UpdateSearchText();
+
+	std::vector<size_t> found;
+	size_t offset = 0;
+	while ((offset = FindInText(mSearchText.data(), mSearchText.size(), aText, offset, aCaseSensitive)) != std::string::npos)
+	{
+		found.push_back(offset);
+		offset += aText.size();
+	}
+
+	if (found.empty())
+		return 0;
+
+	// One undo step for the whole replacement, it keeps the pieces from
+	// before and after so neither the undo nor the edit copies the text
+	auto cursor = mState.mCursorPosition;
+
+	UndoRecord u;
+	u.mBefore = mState;
+	u.mReplacedPieces = true;
+	u.mPiecesBefore = mText.GetPieces();
+
+	if (aText.find('\n') == std::string::npos && aReplacement.find('\n') == std::string::npos)
+	{
+		// The lines stay the same, only the colours of lines with a match change
+		int firstLine = -1;
+		int lastLine = -1;
+		for (auto it = found.rbegin(); it != found.rend(); ++it)
+		{
+			int line = int(std::upper_bound(mSearchLineStarts.begin(), mSearchLineStarts.end(), *it) - mSearchLineStarts.begin()) - 1;
+			int index = int(*it - mSearchLineStarts[line]);
+			EraseColors(mLineColors[line], index, index + (int)aText.size());
+			InsertColors(mLineColors[line], index, (int)aReplacement.size(), PaletteIndex::Default);
+
+			if (lastLine < 0)
+				lastLine = line;
+			firstLine = line;
+		}
+
+		mText.Replace(found, aText.size(), aReplacement);
+		TextEdited();
+		Colorize(firstLine, lastLine - firstLine + 1);
+	}
+	else
+	{
+		mText.Replace(found, aText.size(), aReplacement);
+		ResetLines();
+		Colorize();
+	}
+
+	u.mPiecesAfter = mText.GetPieces();
+
+	SetSelection(cursor, cursor);
+	SetCursorPosition(SanitizeCoordinates(cursor));
+
+	u.mAfter = mState;
+	AddUndo(u);
+
+	return (int)found.size();
+}
+
+bool TextEditor::CanUndo() const
+{
+	return !mReadOnly && mUndoIndex > 0;
+}
+
+bool TextEditor::CanRedo() const
+{
+	return !mReadOnly && mUndoIndex < (int)mUndoBuffer.size();
+}
+
+void TextEditor::Undo(int aSteps)
+{
+	while (CanUndo() && aSteps-- > 0)
 		mUndoBuffer[--mUndoIndex].Undo(this);
 }
 
@@ -2090,24 +2691,31 @@ const TextEditor::Palette & TextEditor::GetRetroBluePalette()
 
 std::string TextEditor::GetText() const
 {
-	return GetText(Coordinates(), Coordinates((int)mLines.size(), 0));
+	// Same result as GetText(Coordinates(), Coordinates(GetTotalLines(), 0))
+	std::string result;
+	result.reserve(mText.GetSize() + 1);
+	mText.Read(0, mText.GetSize(), result);
+	result += '\n';
+
+	return result;
+}
+
+void TextEditor::WriteText(std::ostream& aStream) const
+{
+	mText.Write(aStream);
+	aStream.put('\n');
 }
 
 std::vector<std::string> TextEditor::GetTextLines() const
 {
 	std::vector<std::string> result;
 
-	result.reserve(mLines.size());
+	result.reserve(GetTotalLines());
 
-	for (auto & line : mLines)
+	for (int i = 0; i < GetTotalLines(); ++i)
 	{
 		std::string text;
-
-		text.resize(line.size());
-
-		for (size_t i = 0; i < line.size(); ++i)
-			text[i] = line[i].mChar;
-
+		mText.Read(mText.GetLineStart(i), mText.GetLineLength(i), text);
 		result.emplace_back(std::move(text));
 	}
 
@@ -2131,267 +2739,404 @@ void TextEditor::ProcessInputs()
 {
 }
 
+// Lines the colorizer thread lexes per job, and how far past the edited lines
+// it looks for the lexer state to match what it was before the edit
+static const int sColorizeBatch = 4096;
+static const int sColorizeLookahead = 64;
+
 void TextEditor::Colorize(int aFromLine, int aLines)
 {
-	int toLine = aLines == -1 ? (int)mLines.size() : std::min((int)mLines.size(), aFromLine + aLines);
+	int toLine = aLines == -1 ? GetTotalLines() : std::min(GetTotalLines(), aFromLine + aLines);
 	mColorRangeMin = std::min(mColorRangeMin, aFromLine);
 	mColorRangeMax = std::max(mColorRangeMax, toLine);
 	mColorRangeMin = std::max(0, mColorRangeMin);
 	mColorRangeMax = std::max(mColorRangeMin, mColorRangeMax);
-	mCheckComments = true;
+	mColorizeGeneration++;
+	mColorizeLookahead = sColorizeLookahead;
 }
 
-void TextEditor::ColorizeRange(int aFromLine, int aToLine)
+void TextEditor::ColorizeLine(Line& aLine, LineState& aState, std::string& aBuffer) const
 {
-	if (mLines.empty() || aFromLine >= aToLine)
-		return;
+	if (!aState.mConcatenate)
+	{
+		aState.mWithinSingleLineComment = false;
+		aState.mWithinPreproc = false;
+		aState.mFirstChar = true;
+	}
 
-	std::string buffer;
-	std::cmatch results;
-	std::string id;
+	aState.mConcatenate = false;
+
+	// Multi-line comments are tracked as the index they start at on this line
+	const int noComment = std::numeric_limits<int>::max();
+	int commentStart = aState.mWithinComment ? 0 : noComment;
 
-	int endLine = std::max(0, std::min((int)mLines.size(), aToLine));
-	for (int i = aFromLine; i < endLine; ++i)
+	// Not every branch below sets every flag, so clear what the last pass left
+	for (auto& glyph : aLine)
 	{
-		auto& line = mLines[i];
+		glyph.mComment = false;
+		glyph.mMultiLineComment = false;
+		glyph.mPreprocessor = false;
+	}
 
-		if (line.empty())
-			continue;
+	for (int i = 0; i < (int)aLine.size(); )
+	{
+		auto c = aLine[i].mChar;
 
-		buffer.resize(line.size());
-		for (size_t j = 0; j < line.size(); ++j)
-		{
-			auto& col = line[j];
-			buffer[j] = col.mChar;
-			col.mColorIndex = PaletteIndex::Default;
-		}
+		if (c != mLanguageDefinition.mPreprocChar && !isspace(c))
+			aState.mFirstChar = false;
 
-		const char * bufferBegin = &buffer.front();
-		const char * bufferEnd = bufferBegin + buffer.size();
+		if (i == (int)aLine.size() - 1 && aLine[aLine.size() - 1].mChar == '\\')
+			aState.mConcatenate = true;
 
-		auto last = bufferEnd;
+		bool inComment = commentStart <= i;
 
-		for (auto first = bufferBegin; first != last; )
+		if (aState.mWithinString)
 		{
-			const char * token_begin = nullptr;
-			const char * token_end = nullptr;
-			PaletteIndex token_color = PaletteIndex::Default;
-
-			bool hasTokenizeResult = false;
+			aLine[i].mMultiLineComment = inComment;
 
-			if (mLanguageDefinition.mTokenize != nullptr)
+			if (c == '\"')
 			{
-				if (mLanguageDefinition.mTokenize(first, last, token_begin, token_end, token_color))
-					hasTokenizeResult = true;
-			}
-
-			if (hasTokenizeResult == false)
-			{
-				// todo : remove
-				//printf("using regex for %.*s\n", first + 10 < last ? 10 : int(last - first), first);
-
-				for (auto& p : mRegexList)
+				if (i + 1 < (int)aLine.size() && aLine[i + 1].mChar == '\"')
 				{
-					if (std::regex_search(first, last, results, p.first, std::regex_constants::match_continuous))
-					{
-						hasTokenizeResult = true;
-
-						auto& v = *results.begin();
-						token_begin = v.first;
-						token_end = v.second;
-						token_color = p.second;
-						break;
-					}
+					i += 1;
+					if (i < (int)aLine.size())
+						aLine[i].mMultiLineComment = inComment;
 				}
+				else
+					aState.mWithinString = false;
+			}
+			else if (c == '\\')
+			{
+				i += 1;
+				if (i < (int)aLine.size())
+					aLine[i].mMultiLineComment = inComment;
 			}
+		}
+		else
+		{
+			if (aState.mFirstChar && c == mLanguageDefinition.mPreprocChar)
+				aState.mWithinPreproc = true;
 
-			if (hasTokenizeResult == false)
+			if (c == '\"')
 			{
-				first++;
+				aState.mWithinString = true;
+				aLine[i].mMultiLineComment = inComment;
 			}
 			else
 			{
-				const size_t token_length = token_end - token_begin;
-
-				if (token_color == PaletteIndex::Identifier)
+				auto pred = [](const char& a, const Glyph& b) { return a == b.mChar; };
+				auto from = aLine.begin() + i;
+				auto& startStr = mLanguageDefinition.mCommentStart;
+				auto& singleStartStr = mLanguageDefinition.mSingleLineComment;
+
+				if (singleStartStr.size() > 0 &&
+					i + singleStartStr.size() <= aLine.size() &&
+					equals(singleStartStr.begin(), singleStartStr.end(), from, from + singleStartStr.size(), pred))
 				{
-					id.assign(token_begin, token_end);
-
-					// todo : allmost all language definitions use lower case to specify keywords, so shouldn't this use ::tolower ?
-					if (!mLanguageDefinition.mCaseSensitive)
-						std::transform(id.begin(), id.end(), id.begin(), ::toupper);
-
-					if (!line[first - bufferBegin].mPreprocessor)
-					{
-						if (mLanguageDefinition.mKeywords.count(id) != 0)
-							token_color = PaletteIndex::Keyword;
-						else if (mLanguageDefinition.mIdentifiers.count(id) != 0)
-							token_color = PaletteIndex::KnownIdentifier;
-						else if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
-							token_color = PaletteIndex::PreprocIdentifier;
-					}
-					else
-					{
-						if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
-							token_color = PaletteIndex::PreprocIdentifier;
-					}
+					aState.mWithinSingleLineComment = true;
+				}
+				else if (!aState.mWithinSingleLineComment && i + startStr.size() <= aLine.size() &&
+					equals(startStr.begin(), startStr.end(), from, from + startStr.size(), pred))
+				{
+					commentStart = i;
 				}
 
-				for (size_t j = 0; j < token_length; ++j)
-					line[(token_begin - bufferBegin) + j].mColorIndex = token_color;
+				inComment = commentStart <= i;
+
+				aLine[i].mMultiLineComment = inComment;
+				aLine[i].mComment = aState.mWithinSingleLineComment;
 
-				first = token_end;
+				auto& endStr = mLanguageDefinition.mCommentEnd;
+				if (i + 1 >= (int)endStr.size() &&
+					equals(endStr.begin(), endStr.end(), from + 1 - endStr.size(), from + 1, pred))
+				{
+					commentStart = noComment;
+				}
 			}
 		}
+		if (i < (int)aLine.size())
+			aLine[i].mPreprocessor = aState.mWithinPreproc;
+		i += UTF8CharLength(c);
 	}
-}
 
-void TextEditor::ColorizeInternal()
-{
-	if (mLines.empty() || !mColorizerEnabled)
+	aState.mWithinComment = commentStart != noComment;
+	aState.mValid = true;
+
+	// Without a trailing backslash these are reset by the next line anyway,
+	// clearing them keeps states comparable
+	if (!aState.mConcatenate)
+	{
+		aState.mWithinSingleLineComment = false;
+		aState.mWithinPreproc = false;
+		aState.mFirstChar = true;
+	}
+
+	std::cmatch results;
+	std::string id;
+
+	if (aLine.empty())
 		return;
 
-	if (mCheckComments)
+	aBuffer.resize(aLine.size());
+	for (size_t j = 0; j < aLine.size(); ++j)
 	{
-		auto endLine = mLines.size();
-		auto endIndex = 0;
-		auto commentStartLine = endLine;
-		auto commentStartIndex = endIndex;
-		auto withinString = false;
-		auto withinSingleLineComment = false;
-		auto withinPreproc = false;
-		auto firstChar = true;			// there is no other non-whitespace characters in the line before
-		auto concatenate = false;		// '\' on the very end of the line
-		auto currentLine = 0;
-		auto currentIndex = 0;
-		while (currentLine < endLine || currentIndex < endIndex)
-		{
-			auto& line = mLines[currentLine];
+		auto& col = aLine[j];
+		aBuffer[j] = col.mChar;
+		col.mColorIndex = PaletteIndex::Default;
+	}
 
-			if (currentIndex == 0 && !concatenate)
-			{
-				withinSingleLineComment = false;
-				withinPreproc = false;
-				firstChar = true;
-			}
+	const char * bufferBegin = &aBuffer.front();
+	const char * bufferEnd = bufferBegin + aBuffer.size();
 
-			concatenate = false;
+	auto last = bufferEnd;
 
-			if (!line.empty())
-			{
-				auto& g = line[currentIndex];
-				auto c = g.mChar;
+	for (auto first = bufferBegin; first != last; )
+	{
+		const char * token_begin = nullptr;
+		const char * token_end = nullptr;
+		PaletteIndex token_color = PaletteIndex::Default;
 
-				if (c != mLanguageDefinition.mPreprocChar && !isspace(c))
-					firstChar = false;
+		bool hasTokenizeResult = false;
 
-				if (currentIndex == (int)line.size() - 1 && line[line.size() - 1].mChar == '\\')
-					concatenate = true;
+		if (mLanguageDefinition.mTokenize != nullptr)
+		{
+			if (mLanguageDefinition.mTokenize(first, last, token_begin, token_end, token_color))
+				hasTokenizeResult = true;
+		}
 
-				bool inComment = (commentStartLine < currentLine || (commentStartLine == currentLine && commentStartIndex <= currentIndex));
+		if (hasTokenizeResult == false)
+		{
+			// todo : remove
+			//printf("using regex for %.*s\n", first + 10 < last ? 10 : int(last - first), first);
 
-				if (withinString)
+			for (auto& p : mRegexList)
+			{
+				if (std::regex_search(first, last, results, p.first, std::regex_constants::match_continuous))
 				{
-					line[currentIndex].mMultiLineComment = inComment;
+					hasTokenizeResult = true;
 
-					if (c == '\"')
-					{
-						if (currentIndex + 1 < (int)line.size() && line[currentIndex + 1].mChar == '\"')
-						{
-							currentIndex += 1;
-							if (currentIndex < (int)line.size())
-								line[currentIndex].mMultiLineComment = inComment;
-						}
-						else
-							withinString = false;
-					}
-					else if (c == '\\')
-					{
-						currentIndex += 1;
-						if (currentIndex < (int)line.size())
-							line[currentIndex].mMultiLineComment = inComment;
-					}
+					auto& v = *results.begin();
+					token_begin = v.first;
+					token_end = v.second;
+					token_color = p.second;
+					break;
 				}
-				else
-				{
-					if (firstChar && c == mLanguageDefinition.mPreprocChar)
-						withinPreproc = true;
+			}
+		}
 
-					if (c == '\"')
-					{
-						withinString = true;
-						line[currentIndex].mMultiLineComment = inComment;
-					}
-					else
-					{
-						auto pred = [](const char& a, const Glyph& b) { return a == b.mChar; };
-						auto from = line.begin() + currentIndex;
-						auto& startStr = mLanguageDefinition.mCommentStart;
-						auto& singleStartStr = mLanguageDefinition.mSingleLineComment;
-
-						if (singleStartStr.size() > 0 &&
-							currentIndex + singleStartStr.size() <= line.size() &&
-							equals(singleStartStr.begin(), singleStartStr.end(), from, from + singleStartStr.size(), pred))
-						{
-							withinSingleLineComment = true;
-						}
-						else if (!withinSingleLineComment && currentIndex + startStr.size() <= line.size() &&
-							equals(startStr.begin(), startStr.end(), from, from + startStr.size(), pred))
-						{
-							commentStartLine = currentLine;
-							commentStartIndex = currentIndex;
-						}
+		if (hasTokenizeResult == false)
+		{
+			first++;
+		}
+		else
+		{
+			const size_t token_length = token_end - token_begin;
 
-						inComment = inComment = (commentStartLine < currentLine || (commentStartLine == currentLine && commentStartIndex <= currentIndex));
+			if (token_color == PaletteIndex::Identifier)
+			{
+				id.assign(token_begin, token_end);
 
-						line[currentIndex].mMultiLineComment = inComment;
-						line[currentIndex].mComment = withinSingleLineComment;
+				// todo : allmost all language definitions use lower case to specify keywords, so shouldn't this use ::tolower ?
+				if (!mLanguageDefinition.mCaseSensitive)
+					std::transform(id.begin(), id.end(), id.begin(), ::toupper);
 
-						auto& endStr = mLanguageDefinition.mCommentEnd;
-						if (currentIndex + 1 >= (int)endStr.size() &&
-							equals(endStr.begin(), endStr.end(), from + 1 - endStr.size(), from + 1, pred))
-						{
-							commentStartIndex = endIndex;
-							commentStartLine = endLine;
-						}
-					}
+				if (!aLine[first - bufferBegin].mPreprocessor)
+				{
+					if (mLanguageDefinition.mKeywords.count(id) != 0)
+						token_color = PaletteIndex::Keyword;
+					else if (mLanguageDefinition.mIdentifiers.count(id) != 0)
+						token_color = PaletteIndex::KnownIdentifier;
+					else if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
+						token_color = PaletteIndex::PreprocIdentifier;
 				}
-				line[currentIndex].mPreprocessor = withinPreproc;
-				currentIndex += UTF8CharLength(c);
-				if (currentIndex >= (int)line.size())
+				else
 				{
-					currentIndex = 0;
-					++currentLine;
+					if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
+						token_color = PaletteIndex::PreprocIdentifier;
 				}
 			}
-			else
-			{
-				currentIndex = 0;
-				++currentLine;
-			}
+
+			for (size_t j = 0; j < token_length; ++j)
+				aLine[(token_begin - bufferBegin) + j].mColorIndex = token_color;
+
+			first = token_end;
 		}
-		mCheckComments = false;
 	}
+}
 
-	if (mColorRangeMin < mColorRangeMax)
+// aStates holds the state at the start of each line and one past the last.
+// Lexing stops early once a line at or after aCheckFrom starts in the same
+// state it had before, since nothing below it can change.
+int TextEditor::ColorizeLines(Line* aLines, int aCount, LineState* aStates, int aCheckFrom, bool& aConverged) const
+{
+	std::string buffer;
+	aConverged = false;
+
+	for (int i = 0; i < aCount; ++i)
 	{
-		const int increment = (mLanguageDefinition.mTokenize == nullptr) ? 10 : 10000;
-		const int to = std::min(mColorRangeMin + increment, mColorRangeMax);
-		ColorizeRange(mColorRangeMin, to);
-		mColorRangeMin = to;
+		LineState state = aStates[i];
+		ColorizeLine(aLines[i], state, buffer);
 
-		if (mColorRangeMax == mColorRangeMin)
+		if (i + 1 >= aCheckFrom && state == aStates[i + 1])
 		{
-			mColorRangeMin = std::numeric_limits<int>::max();
-			mColorRangeMax = 0;
+			aConverged = true;
+			return i + 1;
 		}
+
+		aStates[i + 1] = state;
+	}
+
+	return aCount;
+}
+
+void TextEditor::ColorizeAll()
+{
+	WaitForColorizer();
+	mColorizeJob.mStatus = ColorizeJob::Status::Idle;
+
+	if (!mColorizerEnabled)
 		return;
+
+	// One line at a time, so only the colour runs of the whole text are kept
+	int count = GetTotalLines();
+	mLineStates.assign(count, LineState());
+	mLineStates[0].mValid = true;
+
+	LineState state = mLineStates[0];
+	Line line;
+	std::string buffer;
+	for (int i = 0; i < count; ++i)
+	{
+		mLineStates[i] = state;
+		CopyLine(i, line);
+		ColorizeLine(line, state, buffer);
+		CompressColors(line, mLineColors[i]);
+	}
+	mLineCache.clear();
+
+	mColorRangeMin = std::numeric_limits<int>::max();
+	mColorRangeMax = 0;
+}
+
+void TextEditor::ColorizerThread()
+{
+	std::unique_lock<std::mutex> lock(mColorizerMutex);
+
+	for (;;)
+	{
+		mColorizerCondition.wait(lock, [this] { return mColorizerQuit || mColorizeJob.mStatus == ColorizeJob::Status::Queued; });
+
+		if (mColorizerQuit)
+			return;
+
+		// The editor leaves a queued job alone, so it can be lexed unlocked
+		lock.unlock();
+
+		auto& job = mColorizeJob;
+		job.mCount = ColorizeLines(job.mLines.data(), (int)job.mLines.size(), job.mStates.data(), job.mCheckFrom, job.mConverged);
+
+		lock.lock();
+		job.mStatus = ColorizeJob::Status::Done;
+		mColorizerCondition.notify_all();
 	}
 }
 
+void TextEditor::WaitForColorizer()
+{
+	std::unique_lock<std::mutex> lock(mColorizerMutex);
+	mColorizerCondition.wait(lock, [this] { return mColorizeJob.mStatus != ColorizeJob::Status::Queued; });
+}
+
+void TextEditor::ColorizeInternal()
+{
+	if (!mColorizerEnabled)
+		return;
+
+	auto& job = mColorizeJob;
+
+	{
+		std::lock_guard<std::mutex> lock(mColorizerMutex);
+
+		if (job.mStatus == ColorizeJob::Status::Queued)
+			return;
+	}
+
+	if (job.mStatus == ColorizeJob::Status::Done)
+	{
+		job.mStatus = ColorizeJob::Status::Idle;
+
+		// Results for text that has been edited since are dropped, the edited
+		// range is still pending and gets queued again below
+		if (job.mGeneration == mColorizeGeneration)
+		{
+			for (int i = 0; i < job.mCount; ++i)
+			{
+				auto& colors = mLineColors[job.mFirstLine + i];
+				auto& colored = job.mLines[i];
+
+				if (GetColorsLength(colors) == (int)colored.size())
+					CompressColors(colored, colors);
+
+				if (job.mFirstLine + i + 1 < GetTotalLines())
+					mLineStates[job.mFirstLine + i + 1] = job.mStates[i + 1];
+			}
+
+			mLineCache.clear();
+
+			int end = job.mFirstLine + job.mCount;
+
+			if (job.mConverged || end >= GetTotalLines())
+			{
+				mColorRangeMin = std::numeric_limits<int>::max();
+				mColorRangeMax = 0;
+			}
+			else
+			{
+				// The state change runs past what was copied, keep going with a longer lookahead
+				mColorRangeMin = end;
+				mColorRangeMax = std::max(mColorRangeMax, end + 1);
+				mColorizeLookahead = std::min(mColorizeLookahead * 2, sColorizeBatch);
+			}
+		}
+	}
+
+	if (mColorRangeMin >= mColorRangeMax)
+		return;
+
+	// Start from a line whose state is known, lines inserted since have none yet
+	mLineStates[0] = LineState();
+	mLineStates[0].mValid = true;
+
+	int first = std::min(mColorRangeMin, GetTotalLines() - 1);
+	while (first > 0 && !mLineStates[first].mValid)
+		--first;
+
+	int checkFrom = std::min(mColorRangeMax, first + sColorizeBatch);
+	int last = std::min(GetTotalLines(), checkFrom + mColorizeLookahead);
+
+	job.mGeneration = mColorizeGeneration;
+	job.mFirstLine = first;
+	job.mCheckFrom = checkFrom - first;
+	job.mLines.resize(last - first);
+	for (int i = first; i < last; ++i)
+		CopyLine(i, job.mLines[i - first]);
+	job.mStates.assign(mLineStates.begin() + first, mLineStates.begin() + last);
+	job.mStates.push_back(last < GetTotalLines() ? mLineStates[last] : LineState());
+
+	{
+		std::lock_guard<std::mutex> lock(mColorizerMutex);
+		job.mStatus = ColorizeJob::Status::Queued;
+	}
+
+	if (!mColorizerThread.joinable())
+		mColorizerThread = std::thread(&TextEditor::ColorizerThread, this);
+	else
+		mColorizerCondition.notify_all();
+}
+
 float TextEditor::TextDistanceToLineStart(const Coordinates& aFrom) const
 {
-	auto& line = mLines[aFrom.mLine];
+	auto& line = GetLine(aFrom.mLine);
 	float distance = 0.0f;
 	float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ", nullptr, nullptr).x;
 	int colIndex = GetCharacterIndex(aFrom);
@@ -2481,6 +3226,9 @@ TextEditor::UndoRecord::UndoRecord(
 
 void TextEditor::UndoRecord::Undo(TextEditor * aEditor)
 {
+	if (mReplacedPieces)
+		aEditor->RestorePieces(mPiecesBefore);
+
 	if (!mAdded.empty())
 	{
 		aEditor->DeleteRange(mAddedStart, mAddedEnd);
@@ -2501,6 +3249,9 @@ void TextEditor::UndoRecord::Undo(TextEditor * aEditor)
 
 void TextEditor::UndoRecord::Redo(TextEditor * aEditor)
 {
+	if (mReplacedPieces)
+		aEditor->RestorePieces(mPiecesAfter);
+
 	if (!mRemoved.empty())
 	{
 		aEditor->DeleteRange(mRemovedStart, mRemovedEnd);
@@ -3055,6 +3806,173 @@ const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::SQL()
 	return langDef;
 }
 
+static bool IsAngelScriptIdentifierChar(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || (c & 0x80) != 0;
+}
+
+// Single pass lexer for AngelScript, so the colorizer never has to fall back to
+// the regular expressions. Every character produces a token, unknown ones
+// are returned on their own with the default color.
+static bool TokenizeAngelScript(const char * in_begin, const char * in_end, const char *& out_begin, const char *& out_end, TextEditor::PaletteIndex & paletteIndex)
+{
+	const char * p = in_begin;
+
+	while (p < in_end && (*p == ' ' || *p == '\t'))
+		p++;
+
+	out_begin = p;
+
+	if (p == in_end)
+	{
+		out_end = in_end;
+		paletteIndex = TextEditor::PaletteIndex::Default;
+		return true;
+	}
+
+	const char c = *p;
+	const char next = p + 1 < in_end ? p[1] : '\0';
+
+	// Comments, the rest of a block comment is flagged by the multi-line pass
+	if (c == '/' && next == '/')
+	{
+		out_end = in_end;
+		paletteIndex = TextEditor::PaletteIndex::Comment;
+		return true;
+	}
+
+	if (c == '/' && next == '*')
+	{
+		p += 2;
+
+		while (p + 1 < in_end && !(p[0] == '*' && p[1] == '/'))
+			p++;
+
+		out_end = p + 1 < in_end ? p + 2 : in_end;
+		paletteIndex = TextEditor::PaletteIndex::MultiLineComment;
+		return true;
+	}
+
+	// Heredoc strings run to the closing triple quote, or the end of the line
+	if (c == '"' && next == '"' && p + 2 < in_end && p[2] == '"')
+	{
+		p += 3;
+
+		while (p + 2 < in_end && !(p[0] == '"' && p[1] == '"' && p[2] == '"'))
+			p++;
+
+		out_end = p + 2 < in_end ? p + 3 : in_end;
+		paletteIndex = TextEditor::PaletteIndex::String;
+		return true;
+	}
+
+	// Both quote characters delimit strings in AngelScript
+	if (c == '"' || c == '\'')
+	{
+		p++;
+
+		while (p < in_end && *p != c)
+		{
+			if (*p == '\\' && p + 1 < in_end)
+				p++;
+
+			p++;
+		}
+
+		out_end = p < in_end ? p + 1 : in_end;
+		paletteIndex = TextEditor::PaletteIndex::String;
+		return true;
+	}
+
+	if ((c >= '0' && c <= '9') || (c == '.' && next >= '0' && next <= '9'))
+	{
+		if (c == '0' && (next == 'x' || next == 'X' || next == 'b' || next == 'B' || next == 'o' || next == 'O' || next == 'd' || next == 'D'))
+		{
+			p += 2;
+
+			while (p < in_end && ((*p >= '0' && *p <= '9') || (*p >= 'a' && *p <= 'f') || (*p >= 'A' && *p <= 'F')))
+				p++;
+		}
+		else
+		{
+			while (p < in_end && *p >= '0' && *p <= '9')
+				p++;
+
+			if (p < in_end && *p == '.')
+			{
+				p++;
+
+				while (p < in_end && *p >= '0' && *p <= '9')
+					p++;
+			}
+
+			if (p < in_end && (*p == 'e' || *p == 'E'))
+			{
+				const char * exponent = p + 1;
+
+				if (exponent < in_end && (*exponent == '+' || *exponent == '-'))
+					exponent++;
+
+				if (exponent < in_end && *exponent >= '0' && *exponent <= '9')
+				{
+					p = exponent;
+
+					while (p < in_end && *p >= '0' && *p <= '9')
+						p++;
+				}
+			}
+
+			if (p < in_end && (*p == 'f' || *p == 'F' || *p == 'd' || *p == 'D'))
+				p++;
+		}
+
+		out_end = p;
+		paletteIndex = TextEditor::PaletteIndex::Number;
+		return true;
+	}
+
+	if (IsAngelScriptIdentifierChar(c))
+	{
+		p++;
+
+		while (p < in_end && IsAngelScriptIdentifierChar(*p))
+			p++;
+
+		out_end = p;
+		paletteIndex = TextEditor::PaletteIndex::Identifier;
+		return true;
+	}
+
+	if (c == '#')
+	{
+		p++;
+
+		while (p < in_end && IsAngelScriptIdentifierChar(*p))
+			p++;
+
+		out_end = p;
+		paletteIndex = TextEditor::PaletteIndex::Preprocessor;
+		return true;
+	}
+
+	out_end = p + 1;
+
+	switch (c)
+	{
+	case '[': case ']': case '{': case '}': case '(': case ')':
+	case '!': case '%': case '^': case '&': case '*': case '-': case '+':
+	case '=': case '~': case '|': case '<': case '>': case '?': case ':':
+	case '/': case ';': case ',': case '.': case '@':
+		paletteIndex = TextEditor::PaletteIndex::Punctuation;
+		break;
+	default:
+		paletteIndex = TextEditor::PaletteIndex::Default;
+		break;
+	}
+
+	return true;
+}
+
 const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::AngelScript()
 {
 	static bool inited = false;
@@ -3064,7 +3982,7 @@ const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::AngelScrip
 		static const char* const keywords[] = {
 			"and", "abstract", "auto", "bool", "break", "case", "cast", "class", "const", "continue", "default", "do", "double", "else", "enum", "false", "final", "float", "for",
 			"from", "funcdef", "function", "get", "if", "import", "in", "inout", "int", "interface", "int8", "int16", "int32", "int64", "is", "mixin", "namespace", "not",
-			"null", "or", "out", "override", "private", "protected", "return", "set", "shared", "super", "switch", "this ", "true", "typedef", "uint", "uint8", "uint16", "uint32",
+			"null", "or", "out", "override", "private", "protected", "return", "set", "shared", "super", "switch", "this", "true", "typedef", "uint", "uint8", "uint16", "uint32",
 			"uint64", "void", "while", "xor"
 		};
 
@@ -3091,6 +4009,9 @@ const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::AngelScrip
 		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[a-zA-Z_][a-zA-Z0-9_]*", PaletteIndex::Identifier));
 		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[\\[\\]\\{\\}\\!\\%\\^\\&\\*\\(\\)\\-\\+\\=\\~\\|\\<\\>\\?\\/\\;\\,\\.]", PaletteIndex::Punctuation));
 
+		// The regular expressions above are only used if mTokenize is cleared
+		langDef.mTokenize = TokenizeAngelScript;
+
 		langDef.mCommentStart = "/*";
 		langDef.mCommentEnd = "*/";
 		langDef.mSingleLineComment = "//";
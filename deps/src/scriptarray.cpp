@@ -5,6 +5,7 @@
 #include <stdio.h> // sprintf
 #include <string>
 #include <algorithm> // std::sort
+#include <vector>
 
 #include "scriptarray.h"
 
@@ -298,6 +299,8 @@ static void RegisterScriptArray_Native(asIScriptEngine *engine)
 	r = engine->RegisterObjectMethod("array<T>", "void removeAt(uint index)", asMETHOD(CScriptArray, RemoveAt), asCALL_THISCALL); assert(r >= 0);
 	r = engine->RegisterObjectMethod("array<T>", "void removeLast()", asMETHOD(CScriptArray, RemoveLast), asCALL_THISCALL); assert( r >= 0 );
 	r = engine->RegisterObjectMethod("array<T>", "void removeRange(uint start, uint count)", asMETHOD(CScriptArray, RemoveRange), asCALL_THISCALL); assert(r >= 0);
+	r = engine->RegisterObjectMethod("array<T>", "void swapRemove(uint index)", asMETHOD(CScriptArray, SwapRemove), asCALL_THISCALL); assert(r >= 0);
+	r = engine->RegisterObjectMethod("array<T>", "uint compact(const array<bool>@ keepMask)", asMETHOD(CScriptArray, Compact), asCALL_THISCALL); assert(r >= 0);
 	// TODO: Should length() and resize() be deprecated as the property accessors do the same thing?
 	// TODO: Register as size() for consistency with other types
 #if AS_USE_ACCESSORS != 1
@@ -324,6 +327,14 @@ static void RegisterScriptArray_Native(asIScriptEngine *engine)
 	r = engine->RegisterFuncdef("bool array<T>::less(const T&in if_handle_then_const a, const T&in if_handle_then_const b)");
 	r = engine->RegisterObjectMethod("array<T>", "void sort(const less &in, uint startAt = 0, uint count = uint(-1))", asMETHODPR(CScriptArray, Sort, (asIScriptFunction*, asUINT, asUINT), void), asCALL_THISCALL); assert(r >= 0);
 
+	// Sort by a key that is evaluated once per element
+	r = engine->RegisterFuncdef("float array<T>::sortKey(const T&in if_handle_then_const a)");
+	r = engine->RegisterObjectMethod("array<T>", "void sortByKey(const sortKey &in, bool ascending = true)", asMETHOD(CScriptArray, SortByKey), asCALL_THISCALL); assert(r >= 0);
+
+	// Remove elements matching a predicate in a single pass
+	r = engine->RegisterFuncdef("bool array<T>::predicate(const T&in if_handle_then_const a)");
+	r = engine->RegisterObjectMethod("array<T>", "uint removeIf(const predicate &in)", asMETHOD(CScriptArray, RemoveIf), asCALL_THISCALL); assert(r >= 0);
+
 #if AS_USE_STLNAMES != 1 && AS_USE_ACCESSORS == 1
 	// Register virtual properties
 	r = engine->RegisterObjectMethod("array<T>", "uint get_length() const property", asMETHOD(CScriptArray, GetSize), asCALL_THISCALL); assert( r >= 0 );
@@ -911,11 +922,171 @@ void CScriptArray::RemoveAt(asUINT index)
 	Resize(-1, index);
 }
 
+// Reuses the active context for script callbacks when possible, otherwise
+// borrows one from the engine
+static asIScriptContext *RequestCallbackContext(asIScriptEngine *engine, bool &isNested)
+{
+	asIScriptContext *ctx = asGetActiveContext();
+
+	isNested = false;
+	if( ctx )
+	{
+		if( ctx->GetEngine() == engine && ctx->PushState() >= 0 )
+			isNested = true;
+		else
+			ctx = 0;
+	}
+	if( ctx == 0 )
+		ctx = engine->RequestContext();
+
+	return ctx;
+}
+
+static void ReturnCallbackContext(asIScriptEngine *engine, asIScriptContext *ctx, bool isNested)
+{
+	if( ctx == 0 )
+		return;
+
+	if( isNested )
+	{
+		asEContextState state = ctx->GetState();
+		ctx->PopState();
+		if( state == asEXECUTION_ABORTED )
+			ctx->Abort();
+	}
+	else
+		engine->ReturnContext(ctx);
+}
+
 void CScriptArray::RemoveLast()
 {
 	RemoveAt(buffer->numElements-1);
 }
 
+// Remove an element by moving the last element into its place. The order of
+// the remaining elements is not preserved, but nothing has to be shifted
+void CScriptArray::SwapRemove(asUINT index)
+{
+	if( index >= buffer->numElements )
+	{
+		// If this is called from a script we raise a script exception
+		asIScriptContext *ctx = asGetActiveContext();
+		if( ctx )
+			ctx->SetException("Index out of bounds");
+		return;
+	}
+
+	asUINT last = buffer->numElements - 1;
+
+	Destruct(buffer, index, index + 1);
+
+	// As objects in arrays of objects are not stored inline, it is safe to use memcpy here
+	// since we're just moving the pointers to objects and not the actual objects.
+	if( index != last )
+		memcpy(buffer->data + index*elementSize, buffer->data + last*elementSize, elementSize);
+
+	buffer->numElements--;
+}
+
+// Remove the elements whose keep flag is false in a single pass, preserving order
+asUINT CScriptArray::RemoveUnmarked(const bool *keep)
+{
+	asUINT count = buffer->numElements;
+	asUINT write = 0;
+	asUINT read = 0;
+
+	while( read < count )
+	{
+		// Release the run of removed elements
+		asUINT start = read;
+		while( read < count && !keep[read] )
+			read++;
+		if( read > start )
+			Destruct(buffer, start, read);
+
+		// Move the following run of kept elements down in one go
+		start = read;
+		while( read < count && keep[read] )
+			read++;
+		if( read > start )
+		{
+			if( write != start )
+				memmove(buffer->data + write*elementSize, buffer->data + start*elementSize, (read - start)*elementSize);
+			write += read - start;
+		}
+	}
+
+	buffer->numElements = write;
+
+	return count - write;
+}
+
+// Remove every element for which the mask holds false
+asUINT CScriptArray::Compact(const CScriptArray *keepMask)
+{
+	if( keepMask == 0 || keepMask->GetElementTypeId() != asTYPEID_BOOL || keepMask->GetSize() != buffer->numElements )
+	{
+		asIScriptContext *ctx = asGetActiveContext();
+		if( ctx )
+			ctx->SetException(keepMask == 0 ? "Null pointer access" : "Mask size does not match the array");
+		return 0;
+	}
+
+	if( buffer->numElements == 0 )
+		return 0;
+
+	return RemoveUnmarked(reinterpret_cast<const bool*>(keepMask->At(0)));
+}
+
+// Remove every element for which the script predicate returns true, preserving order
+asUINT CScriptArray::RemoveIf(asIScriptFunction *func)
+{
+	asUINT count = buffer->numElements;
+
+	if( count == 0 || func == 0 )
+		return 0;
+
+	bool isNested = false;
+	asIScriptContext *predContext = RequestCallbackContext(objType->GetEngine(), isNested);
+
+	// Evaluate the predicate for every element first, so the script never
+	// observes the array in a partially compacted state
+	bool *keep = reinterpret_cast<bool*>(userAlloc(count * sizeof(bool)));
+	bool completed = keep != 0;
+
+	for( asUINT i = 0; completed && i < count; i++ )
+	{
+		predContext->Prepare(func);
+		predContext->SetArgAddress(0, At(i));
+		int r = predContext->Execute();
+		if( r != asEXECUTION_FINISHED || buffer->numElements != count )
+		{
+			completed = false;
+			break;
+		}
+
+		keep[i] = predContext->GetReturnByte() == 0;
+	}
+
+	ReturnCallbackContext(objType->GetEngine(), predContext, isNested);
+
+	asUINT removed = 0;
+
+	if( completed )
+		removed = RemoveUnmarked(keep);
+	else if( keep == 0 || buffer->numElements != count )
+	{
+		asIScriptContext *ctx = asGetActiveContext();
+		if( ctx )
+			ctx->SetException(keep == 0 ? "Out of memory" : "Array was modified during removeIf");
+	}
+
+	if( keep )
+		userFree(keep);
+
+	return removed;
+}
+
 // Return a pointer to the array element. Returns 0 if the index is out of bounds
 const void *CScriptArray::At(asUINT index) const
 {
@@ -1426,6 +1597,153 @@ void CScriptArray::SortDesc(asUINT startAt, asUINT count)
 }
 
 
+// Arrays shorter than this are sorted with a plain insertion sort, the fixed
+// cost of the histogram passes only pays off for larger inputs
+static const asUINT RADIX_SORT_THRESHOLD = 64;
+
+// How the bits of a primitive are turned into an unsigned key with the same ordering
+enum ERadixKind
+{
+	RADIX_UNSIGNED,
+	RADIX_SIGNED,
+	RADIX_FLOAT
+};
+
+template<class U, ERadixKind kind>
+static inline U ToRadixKey(U bits)
+{
+	const U signBit = U(U(1) << (sizeof(U) * 8 - 1));
+
+	if( kind == RADIX_SIGNED )
+		return U(bits ^ signBit);
+	if( kind == RADIX_FLOAT )
+		return (bits & signBit) ? U(~bits) : U(bits | signBit);
+
+	return bits;
+}
+
+template<class U, ERadixKind kind>
+static inline U FromRadixKey(U key)
+{
+	const U signBit = U(U(1) << (sizeof(U) * 8 - 1));
+
+	if( kind == RADIX_SIGNED )
+		return U(key ^ signBit);
+	if( kind == RADIX_FLOAT )
+		return (key & signBit) ? U(key ^ signBit) : U(~key);
+
+	return key;
+}
+
+// Key and original position of an element, used by sortByKey
+struct SSortKey
+{
+	asDWORD key;
+	asUINT  index;
+};
+
+template<class U>
+static inline U GetRadixKey(U value) { return value; }
+static inline asDWORD GetRadixKey(const SSortKey &value) { return value.key; }
+
+// Stable LSD radix sort, one pass per byte of the key. Passes where every
+// element has the same digit are skipped.
+template<class R, class U>
+static void RadixSort(R *data, R *tmp, asUINT count)
+{
+	R *src = data;
+	R *dst = tmp;
+
+	for( asUINT shift = 0; shift < sizeof(U) * 8; shift += 8 )
+	{
+		asUINT offsets[256] = {0};
+
+		for( asUINT i = 0; i < count; i++ )
+			offsets[(GetRadixKey(src[i]) >> shift) & 0xFF]++;
+
+		if( offsets[(GetRadixKey(src[0]) >> shift) & 0xFF] == count )
+			continue;
+
+		asUINT sum = 0;
+		for( asUINT d = 0; d < 256; d++ )
+		{
+			asUINT c = offsets[d];
+			offsets[d] = sum;
+			sum += c;
+		}
+
+		for( asUINT i = 0; i < count; i++ )
+			dst[offsets[(GetRadixKey(src[i]) >> shift) & 0xFF]++] = src[i];
+
+		R *swapTmp = src;
+		src = dst;
+		dst = swapTmp;
+	}
+
+	if( src != data )
+		memcpy(data, src, count * sizeof(R));
+}
+
+template<class T>
+static void InsertionSort(T *values, asUINT count, bool asc)
+{
+	for( asUINT i = 1; i < count; i++ )
+	{
+		T value = values[i];
+		asUINT j = i;
+
+		if( asc )
+		{
+			while( j > 0 && value < values[j - 1] )
+			{
+				values[j] = values[j - 1];
+				j--;
+			}
+		}
+		else
+		{
+			while( j > 0 && values[j - 1] < value )
+			{
+				values[j] = values[j - 1];
+				j--;
+			}
+		}
+
+		values[j] = value;
+	}
+}
+
+// Sorts a range of primitives of type T, whose bits are reinterpreted as the
+// unsigned type U of the same size. The type is resolved once by the caller
+// so no comparison has to switch on the element type.
+template<class T, class U, ERadixKind kind>
+static void SortPrimitives(void *data, asUINT count, bool asc)
+{
+	if( count < RADIX_SORT_THRESHOLD )
+	{
+		InsertionSort(reinterpret_cast<T*>(data), count, asc);
+		return;
+	}
+
+	std::vector<U> keys(count);
+	std::vector<U> tmp(count);
+
+	memcpy(&keys[0], data, count * sizeof(U));
+
+	for( asUINT i = 0; i < count; i++ )
+	{
+		U key = ToRadixKey<U, kind>(keys[i]);
+		keys[i] = asc ? key : U(~key);
+	}
+
+	RadixSort<U, U>(&keys[0], &tmp[0], count);
+
+	for( asUINT i = 0; i < count; i++ )
+		keys[i] = FromRadixKey<U, kind>(asc ? keys[i] : U(~keys[i]));
+
+	memcpy(data, &keys[0], count * sizeof(U));
+}
+
 // internal
 void CScriptArray::Sort(asUINT startAt, asUINT count, bool asc)
 {
@@ -1560,23 +1878,23 @@ void CScriptArray::Sort(asUINT startAt, asUINT count, bool asc)
 	}
 	else
 	{
-		// TODO: Use std::sort for primitive types too
+		void  *data = GetArrayItemPointer(start);
+		asUINT n = asUINT(end - start);
 
-		// Insertion sort
-		asBYTE tmp[16];
-		for( int i = start + 1; i < end; i++ )
+		switch( subTypeId )
 		{
-			Copy(tmp, GetArrayItemPointer(i));
-
-			int j = i - 1;
-
-			while( j >= start && Less(GetDataPointer(tmp), At(j), asc) )
-			{
-				Copy(GetArrayItemPointer(j + 1), GetArrayItemPointer(j));
-				j--;
-			}
-
-			Copy(GetArrayItemPointer(j + 1), tmp);
+		case asTYPEID_BOOL:
+		case asTYPEID_UINT8:  SortPrimitives<asBYTE, asBYTE, RADIX_UNSIGNED>(data, n, asc); break;
+		case asTYPEID_INT8:   SortPrimitives<asINT8, asBYTE, RADIX_SIGNED>(data, n, asc); break;
+		case asTYPEID_INT16:  SortPrimitives<asINT16, asWORD, RADIX_SIGNED>(data, n, asc); break;
+		case asTYPEID_UINT16: SortPrimitives<asWORD, asWORD, RADIX_UNSIGNED>(data, n, asc); break;
+		case asTYPEID_INT32:  SortPrimitives<asINT32, asDWORD, RADIX_SIGNED>(data, n, asc); break;
+		case asTYPEID_UINT32: SortPrimitives<asDWORD, asDWORD, RADIX_UNSIGNED>(data, n, asc); break;
+		case asTYPEID_INT64:  SortPrimitives<asINT64, asQWORD, RADIX_SIGNED>(data, n, asc); break;
+		case asTYPEID_UINT64: SortPrimitives<asQWORD, asQWORD, RADIX_UNSIGNED>(data, n, asc); break;
+		case asTYPEID_FLOAT:  SortPrimitives<float, asDWORD, RADIX_FLOAT>(data, n, asc); break;
+		case asTYPEID_DOUBLE: SortPrimitives<double, asQWORD, RADIX_FLOAT>(data, n, asc); break;
+		default:              SortPrimitives<signed int, asDWORD, RADIX_SIGNED>(data, n, asc); break; // All enums fall in this case
 		}
 	}
 }
@@ -1661,6 +1979,68 @@ void CScriptArray::Sort(asIScriptFunction *func, asUINT startAt, asUINT count)
 	}
 }
 
+// Sort by a key that the script callback computes once for each element
+void CScriptArray::SortByKey(asIScriptFunction *func, bool asc)
+{
+	asUINT count = buffer->numElements;
+
+	// No need to sort
+	if( count < 2 || func == 0 )
+		return;
+
+	bool isNested = false;
+	asIScriptContext *keyContext = RequestCallbackContext(objType->GetEngine(), isNested);
+
+	std::vector<SSortKey> keys(count);
+	bool completed = true;
+
+	for( asUINT i = 0; i < count; i++ )
+	{
+		keyContext->Prepare(func);
+		keyContext->SetArgAddress(0, At(i));
+		int r = keyContext->Execute();
+		if( r != asEXECUTION_FINISHED || buffer->numElements != count )
+		{
+			completed = false;
+			break;
+		}
+
+		float value = keyContext->GetReturnFloat();
+		asDWORD bits;
+		memcpy(&bits, &value, sizeof(bits));
+
+		// Descending order flips the keys so the sort stays stable
+		asDWORD key = ToRadixKey<asDWORD, RADIX_FLOAT>(bits);
+		keys[i].key = asc ? key : ~key;
+		keys[i].index = i;
+	}
+
+	ReturnCallbackContext(objType->GetEngine(), keyContext, isNested);
+
+	if( !completed )
+	{
+		if( buffer->numElements != count )
+		{
+			asIScriptContext *ctx = asGetActiveContext();
+			if( ctx )
+				ctx->SetException("Array was modified during sortByKey");
+		}
+
+		return;
+	}
+
+	std::vector<SSortKey> tmp(count);
+	RadixSort<SSortKey, asDWORD>(&keys[0], &tmp[0], count);
+
+	// Elements are moved as raw bytes, for object arrays that only moves the
+	// pointers so no reference counts change
+	std::vector<asBYTE> sorted(count * elementSize);
+	for( asUINT i = 0; i < count; i++ )
+		memcpy(&sorted[i * elementSize], GetArrayItemPointer(keys[i].index), elementSize);
+
+	memcpy(GetArrayItemPointer(0), &sorted[0], count * elementSize);
+}
+
 // internal
 void CScriptArray::CopyBuffer(SArrayBuffer *dst, SArrayBuffer *src)
 {
@@ -2158,6 +2538,35 @@ static void ScriptArraySortCallback_Generic(asIScriptGeneric *gen)
 	self->Sort(callback, startAt, count);
 }
 
+static void ScriptArraySwapRemove_Generic(asIScriptGeneric *gen)
+{
+	asUINT index = gen->GetArgDWord(0);
+	CScriptArray *self = (CScriptArray*)gen->GetObject();
+	self->SwapRemove(index);
+}
+
+static void ScriptArrayCompact_Generic(asIScriptGeneric *gen)
+{
+	CScriptArray *mask = (CScriptArray*)gen->GetArgAddress(0);
+	CScriptArray *self = (CScriptArray*)gen->GetObject();
+	gen->SetReturnDWord(self->Compact(mask));
+}
+
+static void ScriptArrayRemoveIf_Generic(asIScriptGeneric *gen)
+{
+	asIScriptFunction *callback = (asIScriptFunction*)gen->GetArgAddress(0);
+	CScriptArray *self = (CScriptArray*)gen->GetObject();
+	gen->SetReturnDWord(self->RemoveIf(callback));
+}
+
+static void ScriptArraySortByKey_Generic(asIScriptGeneric *gen)
+{
+	asIScriptFunction *callback = (asIScriptFunction*)gen->GetArgAddress(0);
+	bool asc = gen->GetArgByte(1) ? true : false;
+	CScriptArray *self = (CScriptArray*)gen->GetObject();
+	self->SortByKey(callback, asc);
+}
+
 static void ScriptArrayAddRef_Generic(asIScriptGeneric *gen)
 {
 	CScriptArray *self = (CScriptArray*)gen->GetObject();
@@ -2228,6 +2637,8 @@ static void RegisterScriptArray_Generic(asIScriptEngine *engine)
 	r = engine->RegisterObjectMethod("array<T>", "void removeAt(uint index)", asFUNCTION(ScriptArrayRemoveAt_Generic), asCALL_GENERIC); assert( r >= 0 );
 	r = engine->RegisterObjectMethod("array<T>", "void removeLast()", asFUNCTION(ScriptArrayRemoveLast_Generic), asCALL_GENERIC); assert( r >= 0 );
 	r = engine->RegisterObjectMethod("array<T>", "void removeRange(uint start, uint count)", asFUNCTION(ScriptArrayRemoveRange_Generic), asCALL_GENERIC); assert(r >= 0);
+	r = engine->RegisterObjectMethod("array<T>", "void swapRemove(uint index)", asFUNCTION(ScriptArraySwapRemove_Generic), asCALL_GENERIC); assert(r >= 0);
+	r = engine->RegisterObjectMethod("array<T>", "uint compact(const array<bool>@ keepMask)", asFUNCTION(ScriptArrayCompact_Generic), asCALL_GENERIC); assert(r >= 0);
 #if AS_USE_ACCESSORS != 1
 	r = engine->RegisterObjectMethod("array<T>", "uint length() const", asFUNCTION(ScriptArrayLength_Generic), asCALL_GENERIC); assert( r >= 0 );
 #endif
@@ -2246,6 +2657,10 @@ static void RegisterScriptArray_Generic(asIScriptEngine *engine)
 	r = engine->RegisterObjectMethod("array<T>", "bool isEmpty() const", asFUNCTION(ScriptArrayIsEmpty_Generic), asCALL_GENERIC); assert( r >= 0 );
 	r = engine->RegisterFuncdef("bool array<T>::less(const T&in if_handle_then_const a, const T&in if_handle_then_const b)");
 	r = engine->RegisterObjectMethod("array<T>", "void sort(const less &in, uint startAt = 0, uint count = uint(-1))", asFUNCTION(ScriptArraySortCallback_Generic), asCALL_GENERIC); assert(r >= 0);
+	r = engine->RegisterFuncdef("float array<T>::sortKey(const T&in if_handle_then_const a)");
+	r = engine->RegisterObjectMethod("array<T>", "void sortByKey(const sortKey &in, bool ascending = true)", asFUNCTION(ScriptArraySortByKey_Generic), asCALL_GENERIC); assert(r >= 0);
+	r = engine->RegisterFuncdef("bool array<T>::predicate(const T&in if_handle_then_const a)");
+	r = engine->RegisterObjectMethod("array<T>", "uint removeIf(const predicate &in)", asFUNCTION(ScriptArrayRemoveIf_Generic), asCALL_GENERIC); assert(r >= 0);
 #if AS_USE_STLNAMES != 1 && AS_USE_ACCESSORS == 1
 	r = engine->RegisterObjectMethod("array<T>", "uint get_length() const property", asFUNCTION(ScriptArrayLength_Generic), asCALL_GENERIC); assert( r >= 0 );
 	r = engine->RegisterObjectMethod("array<T>", "void set_length(uint) property", asFUNCTION(ScriptArrayResize_Generic), asCALL_GENERIC); assert( r >= 0 );
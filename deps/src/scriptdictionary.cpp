@@ -2,6 +2,7 @@
 #include <string.h>
 #include "scriptdictionary.h"
 #include "scriptarray.h"
+#include "scriptstdstring.h"
 
 BEGIN_AS_NAMESPACE
 
@@ -15,6 +16,118 @@ using namespace std;
 // through 1999 for this purpose, so we should be fine.
 const asPWORD DICTIONARY_CACHE = 1003;
 
+// Smallest number of slots allocated for the hash indices. Must be a power of two
+const asUINT DICTIONARY_MIN_SLOTS = 8;
+
+//------------------------------------------------------------------------
+// Table of interned keys shared by all dictionaries of an engine. Property
+// bags on many objects tend to use the same handful of keys, so each
+// distinct string is only allocated once and then reference counted.
+
+class CScriptDictKeyTable
+{
+public:
+	CScriptDictKeyTable() : m_slots(0), m_mask(0), m_size(0) {}
+
+	~CScriptDictKeyTable()
+	{
+		for( asUINT n = 0; m_slots && n <= m_mask; n++ )
+			if( m_slots[n] )
+				delete m_slots[n];
+
+		if( m_slots )
+			asFreeMem(m_slots);
+	}
+
+	// Returns the interned key for the string with one more reference
+	SDictKey *Acquire(const dictKey_t &str, asUINT hash)
+	{
+		if( m_slots )
+		{
+			for( asUINT n = hash & m_mask; m_slots[n]; n = (n + 1) & m_mask )
+			{
+				SDictKey *key = m_slots[n];
+				if( key->hash == hash && key->str == str )
+				{
+					key->refCount++;
+					return key;
+				}
+			}
+		}
+
+		// Keep the load factor below 1/2 so the probe sequences stay short
+		if( (m_size + 1) * 2 > m_mask + 1 )
+			Rehash(m_slots ? (m_mask + 1) * 2 : DICTIONARY_MIN_SLOTS * 4);
+
+		SDictKey *key = new SDictKey;
+		key->str = str;
+		key->hash = hash;
+		key->refCount = 1;
+
+		asUINT n = hash & m_mask;
+		while( m_slots[n] )
+			n = (n + 1) & m_mask;
+		m_slots[n] = key;
+		m_size++;
+
+		return key;
+	}
+
+	void Release(SDictKey *key)
+	{
+		if( --key->refCount > 0 )
+			return;
+
+		asUINT n = key->hash & m_mask;
+		while( m_slots[n] != key )
+			n = (n + 1) & m_mask;
+
+		// Shift the following keys of the probe sequence back so
+		// that no tombstones are needed to keep lookups working
+		for( asUINT next = (n + 1) & m_mask; m_slots[next]; next = (next + 1) & m_mask )
+		{
+			asUINT home = m_slots[next]->hash & m_mask;
+			if( ((next - home) & m_mask) >= ((next - n) & m_mask) )
+			{
+				m_slots[n] = m_slots[next];
+				n = next;
+			}
+		}
+		m_slots[n] = 0;
+		m_size--;
+
+		delete key;
+	}
+
+protected:
+	void Rehash(asUINT slotCount)
+	{
+		SDictKey **slots = (SDictKey**)asAllocMem(sizeof(SDictKey*) * slotCount);
+		memset(slots, 0, sizeof(SDictKey*) * slotCount);
+
+		asUINT mask = slotCount - 1;
+		for( asUINT n = 0; m_slots && n <= m_mask; n++ )
+		{
+			if( m_slots[n] == 0 )
+				continue;
+
+			asUINT i = m_slots[n]->hash & mask;
+			while( slots[i] )
+				i = (i + 1) & mask;
+			slots[i] = m_slots[n];
+		}
+
+		if( m_slots )
+			asFreeMem(m_slots);
+		m_slots = slots;
+		m_mask = mask;
+	}
+
+	SDictKey **m_slots;
+	asUINT     m_mask;
+	asUINT     m_size;
+};
+
 // This cache holds the object type of the dictionary type and array type
 // so it isn't necessary to look this up each time the dictionary or array
 // is created.
@@ -23,6 +136,7 @@ struct SDictionaryCache
 	asITypeInfo *dictType;
 	asITypeInfo *arrayType;
 	asITypeInfo *keyType;
+	CScriptDictKeyTable *keyTable;
 
 	// This is called from RegisterScriptDictionary
 	static void Setup(asIScriptEngine *engine)
@@ -37,6 +151,7 @@ struct SDictionaryCache
 			cache->dictType = engine->GetTypeInfoByName("dictionary");
 			cache->arrayType = engine->GetTypeInfoByDecl("array<string>");
 			cache->keyType = engine->GetTypeInfoByDecl("string");
+			cache->keyTable = new CScriptDictKeyTable;
 		}
 	}
 
@@ -45,10 +160,150 @@ struct SDictionaryCache
 	{
 		SDictionaryCache *cache = reinterpret_cast<SDictionaryCache*>(engine->GetUserData(DICTIONARY_CACHE));
 		if( cache )
+		{
+			delete cache->keyTable;
 			delete cache;
+		}
 	}
 };
 
+//--------------------------------------------------------------------------
+// CScriptDictMap implementation
+
+CScriptDictMap::CScriptDictMap()
+	: m_entries(0), m_size(0), m_capacity(0), m_slots(0), m_mask(0)
+{
+}
+
+CScriptDictMap::~CScriptDictMap()
+{
+	// The dictionary has already freed the values, so
+	// the entries don't need to be destroyed one by one
+	if( m_entries )
+		asFreeMem(m_entries);
+	if( m_slots )
+		asFreeMem(m_slots);
+}
+
+CScriptDictMap::SEntry *CScriptDictMap::Find(const dictKey_t &key, asUINT hash) const
+{
+	if( m_size == 0 )
+		return 0;
+
+	for( asUINT n = hash & m_mask; m_slots[n].entry; n = (n + 1) & m_mask )
+	{
+		if( m_slots[n].hash != hash )
+			continue;
+
+		SEntry *entry = m_entries + m_slots[n].entry - 1;
+		if( entry->key->str == key )
+			return entry;
+	}
+
+	return 0;
+}
+
+CScriptDictMap::SEntry *CScriptDictMap::Insert(SDictKey *key)
+{
+	if( m_size == m_capacity )
+	{
+		// The values are plain unions with a type id, so the
+		// entries can be relocated without calling any constructors
+		asUINT capacity = m_capacity ? m_capacity * 2 : DICTIONARY_MIN_SLOTS / 2;
+		SEntry *entries = (SEntry*)asAllocMem(sizeof(SEntry) * capacity);
+		if( m_entries )
+		{
+			memcpy((void*)entries, m_entries, sizeof(SEntry) * m_size);
+			asFreeMem(m_entries);
+		}
+		m_entries = entries;
+		m_capacity = capacity;
+	}
+
+	// Keep the load factor of the index at or below 3/4
+	if( (m_size + 1) * 4 > (m_slots ? m_mask + 1 : 0) * 3 )
+		Rehash(m_slots ? (m_mask + 1) * 2 : DICTIONARY_MIN_SLOTS);
+
+	SEntry *entry = m_entries + m_size;
+	entry->key = key;
+	new(&entry->value) CScriptDictValue();
+	m_size++;
+
+	asUINT n = key->hash & m_mask;
+	while( m_slots[n].entry )
+		n = (n + 1) & m_mask;
+	m_slots[n].hash = key->hash;
+	m_slots[n].entry = m_size;
+
+	return entry;
+}
+
+void CScriptDictMap::Erase(SEntry *entry)
+{
+	asUINT index = asUINT(entry - m_entries);
+	asUINT n = FindSlot(entry->key->hash, index + 1);
+
+	// Shift the following slots of the probe sequence back so
+	// that no tombstones are needed to keep lookups working
+	for( asUINT next = (n + 1) & m_mask; m_slots[next].entry; next = (next + 1) & m_mask )
+	{
+		asUINT home = m_slots[next].hash & m_mask;
+		if( ((next - home) & m_mask) >= ((next - n) & m_mask) )
+		{
+			m_slots[n] = m_slots[next];
+			n = next;
+		}
+	}
+	m_slots[n].entry = 0;
+
+	// Move the last entry into the hole to keep the entries packed
+	m_size--;
+	if( index != m_size )
+	{
+		m_slots[FindSlot(m_entries[m_size].key->hash, m_size + 1)].entry = index + 1;
+		memcpy((void*)entry, m_entries + m_size, sizeof(SEntry));
+	}
+}
+
+void CScriptDictMap::Clear()
+{
+	m_size = 0;
+	if( m_slots )
+		memset(m_slots, 0, sizeof(SSlot) * (m_mask + 1));
+}
+
+void CScriptDictMap::Rehash(asUINT slotCount)
+{
+	SSlot *slots = (SSlot*)asAllocMem(sizeof(SSlot) * slotCount);
+	memset(slots, 0, sizeof(SSlot) * slotCount);
+
+	// Rebuilding from the entries rather than the old slots
+	// visits the keys in the same order they were inserted
+	asUINT mask = slotCount - 1;
+	for( asUINT e = 0; e < m_size; e++ )
+	{
+		asUINT hash = m_entries[e].key->hash;
+		asUINT n = hash & mask;
+		while( slots[n].entry )
+			n = (n + 1) & mask;
+		slots[n].hash = hash;
+		slots[n].entry = e + 1;
+	}
+
+	if( m_slots )
+		asFreeMem(m_slots);
+	m_slots = slots;
+	m_mask = mask;
+}
+
+asUINT CScriptDictMap::FindSlot(asUINT hash, asUINT entry) const
+{
+	asUINT n = hash & m_mask;
+	while( m_slots[n].entry != entry )
+		n = (n + 1) & m_mask;
+	return n;
+}
+
 //--------------------------------------------------------------------------
 // CScriptDictionary implementation
 
@@ -86,6 +341,7 @@ void CScriptDictionary::Init(asIScriptEngine *e)
 
 	// The dictionary object type is cached to avoid dynamically parsing it each time
 	SDictionaryCache *cache = reinterpret_cast<SDictionaryCache*>(engine->GetUserData(DICTIONARY_CACHE));
+	keys = cache->keyTable;
 
 	// Notify the garbage collector of this object
 	engine->NotifyGarbageCollectorOfNewObject(this, cache->dictType);
@@ -239,19 +495,19 @@ void CScriptDictionary::EnumReferences(asIScriptEngine *inEngine)
 	dictMap_t::iterator it;
 	for( it = dict.begin(); it != dict.end(); it++ )
 	{
-		if (it->second.m_typeId & asTYPEID_MASK_OBJECT)
+		if (it->value.m_typeId & asTYPEID_MASK_OBJECT)
 		{
-			asITypeInfo *subType = engine->GetTypeInfoById(it->second.m_typeId);
+			asITypeInfo *subType = engine->GetTypeInfoById(it->value.m_typeId);
 			if ((subType->GetFlags() & asOBJ_VALUE) && (subType->GetFlags() & asOBJ_GC))
 			{
 				// For value types we need to forward the enum callback
 				// to the object so it can decide what to do
-				engine->ForwardGCEnumReferences(it->second.m_valueObj, subType);
+				engine->ForwardGCEnumReferences(it->value.m_valueObj, subType);
 			}
 			else
 			{
 				// For others, simply notify the GC about the reference
-				inEngine->GCEnumCallback(it->second.m_valueObj);
+				inEngine->GCEnumCallback(it->value.m_valueObj);
 			}
 		}
 	}
@@ -269,34 +525,47 @@ CScriptDictionary &CScriptDictionary::operator =(const CScriptDictionary &other)
 	// Clear everything we had before
 	DeleteAll();
 
-	// Do a shallow copy of the dictionary
+	// Do a shallow copy of the dictionary. The keys are already
+	// interned, so they are shared instead of hashed again
 	dictMap_t::const_iterator it;
 	for( it = other.dict.begin(); it != other.dict.end(); it++ )
 	{
-		if( it->second.m_typeId & asTYPEID_OBJHANDLE )
-			Set(it->first, (void*)&it->second.m_valueObj, it->second.m_typeId);
-		else if( it->second.m_typeId & asTYPEID_MASK_OBJECT )
-			Set(it->first, (void*)it->second.m_valueObj, it->second.m_typeId);
+		it->key->refCount++;
+		dictMap_t::SEntry *entry = dict.Insert(it->key);
+
+		if( it->value.m_typeId & asTYPEID_OBJHANDLE )
+			entry->value.Set(engine, (void*)&it->value.m_valueObj, it->value.m_typeId);
+		else if( it->value.m_typeId & asTYPEID_MASK_OBJECT )
+			entry->value.Set(engine, (void*)it->value.m_valueObj, it->value.m_typeId);
 		else
-			Set(it->first, (void*)&it->second.m_valueInt, it->second.m_typeId);
+			entry->value.Set(engine, (void*)&it->value.m_valueInt, it->value.m_typeId);
 	}
 
 	return *this;
 }
 
+dictMap_t::SEntry *CScriptDictionary::FindOrInsert(const dictKey_t &key)
+{
+	asUINT hash = GetStdStringHash(key);
+	dictMap_t::SEntry *entry = dict.Find(key, hash);
+	if( entry == 0 )
+		entry = dict.Insert(keys->Acquire(key, hash));
+
+	return entry;
+}
+
 CScriptDictValue *CScriptDictionary::operator[](const dictKey_t &key)
 {
 	// Return the existing value if it exists, else insert an empty value
-	return &dict[key];
+	return &FindOrInsert(key)->value;
 }
 
 const CScriptDictValue *CScriptDictionary::operator[](const dictKey_t &key) const
 {
 	// Return the existing value if it exists
-	dictMap_t::const_iterator it;
-	it = dict.find(key);
-	if( it != dict.end() )
-		return &it->second;
+	dictMap_t::SEntry *entry = dict.Find(key, GetStdStringHash(key));
+	if( entry )
+		return &entry->value;
 
 	// Else raise an exception
 	asIScriptContext *ctx = asGetActiveContext();
@@ -308,12 +577,7 @@ const CScriptDictValue *CScriptDictionary::operator[](const dictKey_t &key) cons
 
 void CScriptDictionary::Set(const dictKey_t &key, void *value, int typeId)
 {
-	dictMap_t::iterator it;
-	it = dict.find(key);
-	if( it == dict.end() )
-		it = dict.insert(dictMap_t::value_type(key, CScriptDictValue())).first;
-
-	it->second.Set(engine, value, typeId);
+	FindOrInsert(key)->value.Set(engine, value, typeId);
 }
 
 // This overloaded method is implemented so that all integer and
@@ -338,10 +602,9 @@ void CScriptDictionary::Set(const dictKey_t &key, const double &value)
 // Returns true if the value was successfully retrieved
 bool CScriptDictionary::Get(const dictKey_t &key, void *value, int typeId) const
 {
-	dictMap_t::const_iterator it;
-	it = dict.find(key);
-	if( it != dict.end() )
-		return it->second.Get(engine, value, typeId);
+	dictMap_t::SEntry *entry = dict.Find(key, GetStdStringHash(key));
+	if( entry )
+		return entry->value.Get(engine, value, typeId);
 
 	// AngelScript has already initialized the value with a default value,
 	// so we don't have to do anything if we don't find the element, or if
@@ -353,10 +616,9 @@ bool CScriptDictionary::Get(const dictKey_t &key, void *value, int typeId) const
 // Returns the type id of the stored value
 int CScriptDictionary::GetTypeId(const dictKey_t &key) const
 {
-	dictMap_t::const_iterator it;
-	it = dict.find(key);
-	if( it != dict.end() )
-		return it->second.m_typeId;
+	dictMap_t::SEntry *entry = dict.Find(key, GetStdStringHash(key));
+	if( entry )
+		return entry->value.m_typeId;
 
 	return -1;
 }
@@ -373,12 +635,7 @@ bool CScriptDictionary::Get(const dictKey_t &key, double &value) const
 
 bool CScriptDictionary::Exists(const dictKey_t &key) const
 {
-	dictMap_t::const_iterator it;
-	it = dict.find(key);
-	if( it != dict.end() )
-		return true;
-
-	return false;
+	return dict.Find(key, GetStdStringHash(key)) != 0;
 }
 
 bool CScriptDictionary::IsEmpty() const
@@ -396,12 +653,14 @@ asUINT CScriptDictionary::GetSize() const
 
 bool CScriptDictionary::Delete(const dictKey_t &key)
 {
-	dictMap_t::iterator it;
-	it = dict.find(key);
-	if( it != dict.end() )
+	dictMap_t::SEntry *entry = dict.Find(key, GetStdStringHash(key));
+	if( entry )
 	{
-		it->second.FreeValue(engine);
-		dict.erase(it);
+		// Erase still reads the key's hash, so it can only be released after
+		SDictKey *dictKey = entry->key;
+		entry->value.FreeValue(engine);
+		dict.Erase(entry);
+		keys->Release(dictKey);
 		return true;
 	}
 
@@ -412,9 +671,12 @@ void CScriptDictionary::DeleteAll()
 {
 	dictMap_t::iterator it;
 	for( it = dict.begin(); it != dict.end(); it++ )
-		it->second.FreeValue(engine);
+	{
+		it->value.FreeValue(engine);
+		keys->Release(it->key);
+	}
 
-	dict.clear();
+	dict.Clear();
 }
 
 CScriptArray* CScriptDictionary::GetKeys() const
@@ -430,7 +692,7 @@ CScriptArray* CScriptDictionary::GetKeys() const
 	for( it = dict.begin(); it != dict.end(); it++ )
 	{
 		current++;
-		*(dictKey_t*)array->At(current) = it->first;
+		*(dictKey_t*)array->At(current) = it->key->str;
 	}
 
 	return array;
@@ -1227,7 +1489,8 @@ CScriptDictionary::CIterator CScriptDictionary::end() const
 
 CScriptDictionary::CIterator CScriptDictionary::find(const dictKey_t &key) const
 {
-	return CIterator(*this, dict.find(key));
+	dictMap_t::const_iterator it = dict.Find(key, GetStdStringHash(key));
+	return CIterator(*this, it ? it : dict.end());
 }
 
 CScriptDictionary::CIterator::CIterator(
@@ -1266,32 +1529,32 @@ bool CScriptDictionary::CIterator::operator!=(const CIterator &other) const
 
 const dictKey_t &CScriptDictionary::CIterator::GetKey() const
 {
-	return m_it->first;
+	return m_it->key->str;
 }
 
 int CScriptDictionary::CIterator::GetTypeId() const
 {
-	return m_it->second.m_typeId;
+	return m_it->value.m_typeId;
 }
 
 bool CScriptDictionary::CIterator::GetValue(asINT64 &value) const
 {
-	return m_it->second.Get(m_dict.engine, &value, asTYPEID_INT64);
+	return m_it->value.Get(m_dict.engine, &value, asTYPEID_INT64);
 }
 
 bool CScriptDictionary::CIterator::GetValue(double &value) const
 {
-	return m_it->second.Get(m_dict.engine, &value, asTYPEID_DOUBLE);
+	return m_it->value.Get(m_dict.engine, &value, asTYPEID_DOUBLE);
 }
 
 bool CScriptDictionary::CIterator::GetValue(void *value, int typeId) const
 {
-	return m_it->second.Get(m_dict.engine, value, typeId);
+	return m_it->value.Get(m_dict.engine, value, typeId);
 }
 
 const void *CScriptDictionary::CIterator::GetAddressOfValue() const
 {
-	return m_it->second.GetAddressOfValue();
+	return m_it->value.GetAddressOfValue();
 }
 
 END_AS_NAMESPACE
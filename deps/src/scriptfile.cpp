@@ -16,6 +16,13 @@ using namespace std;
 
 BEGIN_AS_NAMESPACE
 
+static SCRIPTFILE_OPEN_CALLBACK_t openCallback = 0;
+
+void SetScriptFileOpenCallback(SCRIPTFILE_OPEN_CALLBACK_t callback)
+{
+	openCallback = callback;
+}
+
 CScriptFile *ScriptFile_Factory()
 {
 	return new CScriptFile();
@@ -244,6 +251,10 @@ CScriptFile::CScriptFile()
 {
 	refCount = 1;
 	file = 0;
+	memory = 0;
+	memorySize = 0;
+	memoryPos = 0;
+	memoryEOF = false;
 	mostSignificantByteFirst = false;
 }
 
@@ -266,7 +277,7 @@ void CScriptFile::Release() const
 int CScriptFile::Open(const std::string &filename, const std::string &mode)
 {
 	// Close the previously opened file handle
-	if( file )
+	if( file || memory )
 		Close();
 
 	std::string myFilename = filename;
@@ -310,6 +321,14 @@ int CScriptFile::Open(const std::string &filename, const std::string &mode)
 #endif
 
 
+	// Let the application serve the contents from memory, e.g. from an archive
+	if( m == "r" && openCallback && openCallback(myFilename, &memory, &memorySize) )
+	{
+		memoryPos = 0;
+		memoryEOF = false;
+		return 0;
+	}
+
 	// By default windows translates "\r\n" to "\n", but we want to read the file as-is.
 	m += "b";
 
@@ -329,6 +348,12 @@ int CScriptFile::Open(const std::string &filename, const std::string &mode)
 
 int CScriptFile::Close()
 {
+	if( memory )
+	{
+		memory = 0;
+		return 0;
+	}
+
 	if( file == 0 )
 		return -1;
 
@@ -340,6 +365,9 @@ int CScriptFile::Close()
 
 int CScriptFile::GetSize() const
 {
+	if( memory )
+		return int(memorySize);
+
 	if( file == 0 )
 		return -1;
 
@@ -353,6 +381,9 @@ int CScriptFile::GetSize() const
 
 int CScriptFile::GetPos() const
 {
+	if( memory )
+		return int(memoryPos);
+
 	if( file == 0 )
 		return -1;
 
@@ -361,6 +392,16 @@ int CScriptFile::GetPos() const
  
 int CScriptFile::SetPos(int pos)
 {
+	if( memory )
+	{
+		if( pos < 0 )
+			return -1;
+
+		memoryPos = size_t(pos);
+		memoryEOF = false;
+		return 0;
+	}
+
 	if( file == 0 )
 		return -1;
 
@@ -372,6 +413,9 @@ int CScriptFile::SetPos(int pos)
 
 int CScriptFile::MovePos(int delta)
 {
+	if( memory )
+		return SetPos(int(memoryPos) + delta);
+
 	if( file == 0 )
 		return -1;
 
@@ -381,15 +425,33 @@ int CScriptFile::MovePos(int delta)
 	return r ? -1 : 0;
 }
 
+size_t CScriptFile::ReadBytes(void *buf, size_t size)
+{
+	if( memory == 0 )
+		return fread(buf, 1, size, file);
+
+	size_t left = memoryPos < memorySize ? memorySize - memoryPos : 0;
+	if( size > left )
+	{
+		size = left;
+		memoryEOF = true;
+	}
+
+	memcpy(buf, memory + memoryPos, size);
+	memoryPos += size;
+
+	return size;
+}
+
 string CScriptFile::ReadString(unsigned int length)
 {
-	if( file == 0 )
+	if( file == 0 && memory == 0 )
 		return "";
 
 	// Read the string
 	string str;
 	str.resize(length);
-	int size = (int)fread(&str[0], 1, length, file); 
+	int size = (int)ReadBytes(&str[0], length);
 	str.resize(size);
 
 	return str;
@@ -397,6 +459,26 @@ string CScriptFile::ReadString(unsigned int length)
 
 string CScriptFile::ReadLine()
 {
+	if( memory )
+	{
+		if( memoryPos >= memorySize )
+		{
+			memoryEOF = true;
+			return "";
+		}
+
+		// Read until and including the first new-line character
+		const char *start = memory + memoryPos;
+		const char *end = (const char*)memchr(start, '\n', memorySize - memoryPos);
+		size_t length = end ? size_t(end - start) + 1 : memorySize - memoryPos;
+
+		memoryPos += length;
+		if( end == 0 )
+			memoryEOF = true;
+
+		return string(start, length);
+	}
+
 	if( file == 0 )
 		return "";
 
@@ -429,15 +511,14 @@ string CScriptFile::ReadLine()
 
 asINT64 CScriptFile::ReadInt(asUINT bytes)
 {
-	if( file == 0 )
+	if( file == 0 && memory == 0 )
 		return 0;
 
 	if( bytes > 8 ) bytes = 8;
 	if( bytes == 0 ) return 0;
 
 	unsigned char buf[8];
-	size_t r = fread(buf, bytes, 1, file);
-	if( r == 0 ) return 0;
+	if( ReadBytes(buf, bytes) != bytes ) return 0;
 
 	asINT64 val = 0;
 	if( mostSignificantByteFirst )
@@ -470,15 +551,14 @@ asINT64 CScriptFile::ReadInt(asUINT bytes)
 
 asQWORD CScriptFile::ReadUInt(asUINT bytes)
 {
-	if( file == 0 )
+	if( file == 0 && memory == 0 )
 		return 0;
 
 	if( bytes > 8 ) bytes = 8;
 	if( bytes == 0 ) return 0;
 
 	unsigned char buf[8];
-	size_t r = fread(buf, bytes, 1, file);
-	if( r == 0 ) return 0;
+	if( ReadBytes(buf, bytes) != bytes ) return 0;
 
 	asQWORD val = 0;
 	if( mostSignificantByteFirst )
@@ -499,12 +579,11 @@ asQWORD CScriptFile::ReadUInt(asUINT bytes)
 
 float CScriptFile::ReadFloat()
 {
-	if( file == 0 )
+	if( file == 0 && memory == 0 )
 		return 0;
 
 	unsigned char buf[4];
-	size_t r = fread(buf, 4, 1, file);
-	if( r == 0 ) return 0;
+	if( ReadBytes(buf, 4) != 4 ) return 0;
 
 	asUINT val = 0;
 	if( mostSignificantByteFirst )
@@ -525,12 +604,11 @@ float CScriptFile::ReadFloat()
 
 double CScriptFile::ReadDouble()
 {
-	if( file == 0 )
+	if( file == 0 && memory == 0 )
 		return 0;
 
 	unsigned char buf[8];
-	size_t r = fread(buf, 8, 1, file);
-	if( r == 0 ) return 0;
+	if( ReadBytes(buf, 8) != 8 ) return 0;
 
 	asQWORD val = 0;
 	if( mostSignificantByteFirst )
@@ -551,6 +629,9 @@ double CScriptFile::ReadDouble()
 
 bool CScriptFile::IsEOF() const
 {
+	if( memory )
+		return memoryEOF;
+
 	if( file == 0 )
 		return true;
 
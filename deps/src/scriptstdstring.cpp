@@ -29,6 +29,19 @@ END_AS_NAMESPACE
 #endif
 
 BEGIN_AS_NAMESPACE
+
+// 32 bit FNV-1a
+static asUINT HashStdString(const char *data, size_t length)
+{
+	asUINT hash = 2166136261u;
+	for( size_t n = 0; n < length; n++ )
+	{
+		hash ^= (unsigned char)data[n];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
 class CStdStringFactory : public asIStringFactory
 {
 public:
@@ -142,6 +155,11 @@ public:
 
 static CStdStringFactoryCleaner cleaner;
 
+asUINT GetStdStringHash(const string &str)
+{
+	return HashStdString(str.data(), str.length());
+}
+
 
 static void ConstructString(string *thisPointer)
 {
@@ -1,12 +1,21 @@
 #include "api.h"
+#include "input.h"
+#include "log.h"
 
 #include <cstdio>
+#include <cstdlib>
 #include <cmath>
+#include <climits>
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <random>
 #include <algorithm>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "angelscript.h"
 #include "raylib.h"
@@ -14,14 +23,130 @@
 using namespace std;
 
 Color currentColor = WHITE;
-map<int, Texture> loadedTextures;
+
+// Live images by canonical path, each removes itself when it's destroyed
+unordered_map<string, Api::Image *> loadedImages;
+Api::TextureStats textureStats = { 0, 0, 0, 0, 0 };
+
+Api::Image *newestImage = 0;
+Api::Image *oldestImage = 0;
+unsigned textureFrame = 0;
+unsigned evictAfterFrames = 120;
+
+// Decodes evicted images on a worker thread, the upload happens on the main
+// thread in updateTextures since it needs the GL context.
+struct TextureLoader
+{
+    thread worker;
+    mutex lock;
+    condition_variable wake;
+    deque<Api::Image *> requests;
+    vector<pair<Api::Image *, Image> > loaded;
+    bool stopping = false;
+
+    ~TextureLoader()
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+
+        wake.notify_all();
+
+        if (worker.joinable())
+            worker.join();
+
+        for (size_t i = 0; i < loaded.size(); i++)
+            UnloadImage(loaded[i].second);
+    }
+
+    void request(Api::Image *image)
+    {
+        lock_guard<mutex> guard(lock);
+
+        if (!worker.joinable())
+            worker = thread(&TextureLoader::run, this);
+
+        requests.push_back(image);
+        wake.notify_one();
+    }
+
+    void run()
+    {
+        unique_lock<mutex> guard(lock);
+
+        while (true)
+        {
+            wake.wait(guard, [this] { return stopping || !requests.empty(); });
+
+            if (stopping)
+                return;
+
+            Api::Image *image = requests.front();
+            requests.pop_front();
+
+            // The path never changes, and the pending reference keeps the image alive
+            guard.unlock();
+            Image pixels = LoadImage(image->path.c_str());
+            guard.lock();
+
+            loaded.push_back(make_pair(image, pixels));
+        }
+    }
+};
+
+TextureLoader textureLoader;
+
+static string canonicalPath(const string &path)
+{
+#if defined(_WIN32)
+    char buffer[_MAX_PATH];
+    const char *full = _fullpath(buffer, path.c_str(), sizeof(buffer));
+#else
+    char buffer[PATH_MAX];
+    const char *full = realpath(path.c_str(), buffer);
+#endif
+
+    // Files that only exist in a pack keep the path they were asked for
+    string result = full ? full : path;
+    replace(result.begin(), result.end(), '\\', '/');
+
+#if defined(_WIN32)
+    transform(result.begin(), result.end(), result.begin(), ::tolower);
+#endif
+
+    return result;
+}
+
+static size_t textureSize(const Texture &texture)
+{
+    size_t size = GetPixelDataSize(texture.width, texture.height, texture.format);
+
+    // A full mip chain adds a third
+    return texture.mipmaps > 1 ? size + size / 3 : size;
+}
 
 namespace Api
 {
     void log(string &str)
     {
-        printf("%s\n", str.c_str());
-        consoleHistory.push_back(str + "\n");
+        Log::write(Console::LEVEL_INFO, str);
+
+        Input::noteLog(str);
+    }
+
+    void logWarning(string &str)
+    {
+        Log::write(Console::LEVEL_WARNING, str);
+
+        Input::noteLog(str);
+    }
+
+    void logError(string &str)
+    {
+        Log::write(Console::LEVEL_ERROR, str);
+
+        Input::noteLog(str);
     }
 
     string toString(int value)
@@ -39,6 +164,170 @@ namespace Api
         return to_string(value);
     }
 
+    Image::Image(const string &key, const string &path, Texture texture)
+        : key(key), path(path), texture(texture), width(texture.width), height(texture.height),
+          lastUsed(textureFrame), pending(false), newer(0), older(0), refCount(1)
+    {
+        if (texture.id != 0)
+            link();
+    }
+
+    Image::~Image()
+    {
+        if (texture.id != 0)
+        {
+            unlink();
+            UnloadTexture(texture);
+        }
+        else if (width > 0)
+            textureStats.evicted--;
+    }
+
+    Image *Image::load(const string &path)
+    {
+        string key = canonicalPath(path);
+
+        unordered_map<string, Image *>::iterator it = loadedImages.find(key);
+
+        if (it != loadedImages.end())
+        {
+            it->second->addRef();
+            return it->second;
+        }
+
+        Image *image = new Image(key, path, LoadTexture(path.c_str()));
+
+        // Failed loads aren't cached, so fixing the file and calling newImage again works
+        if (image->texture.id != 0)
+            loadedImages[key] = image;
+
+        return image;
+    }
+
+    void Image::addRef()
+    {
+        asAtomicInc(refCount);
+    }
+
+    void Image::release()
+    {
+        if (asAtomicDec(refCount) == 0)
+        {
+            unordered_map<string, Image *>::iterator it = loadedImages.find(key);
+
+            if (it != loadedImages.end() && it->second == this)
+                loadedImages.erase(it);
+
+            delete this;
+        }
+    }
+
+    int Image::getWidth() const
+    {
+        return width;
+    }
+
+    int Image::getHeight() const
+    {
+        return height;
+    }
+
+    void Image::link()
+    {
+        older = newestImage;
+        newer = 0;
+
+        if (newestImage)
+            newestImage->newer = this;
+        else
+            oldestImage = this;
+
+        newestImage = this;
+
+        textureStats.count++;
+        textureStats.bytes += textureSize(texture);
+    }
+
+    void Image::unlink()
+    {
+        if (newer)
+            newer->older = older;
+        else
+            newestImage = older;
+
+        if (older)
+            older->newer = newer;
+        else
+            oldestImage = newer;
+
+        newer = 0;
+        older = 0;
+
+        textureStats.count--;
+        textureStats.bytes -= textureSize(texture);
+    }
+
+    bool Image::use()
+    {
+        if (texture.id == 0)
+        {
+            // Only images that were loaded once are reloaded, failed loads stay empty
+            if (!pending && width > 0)
+            {
+                pending = true;
+                textureStats.pending++;
+
+                addRef();
+                textureLoader.request(this);
+            }
+
+            return false;
+        }
+
+        if (lastUsed != textureFrame)
+        {
+            lastUsed = textureFrame;
+
+            if (newestImage != this)
+            {
+                unlink();
+                link();
+            }
+        }
+
+        return true;
+    }
+
+    void Image::evict()
+    {
+        unlink();
+        UnloadTexture(texture);
+
+        texture.id = 0;
+        textureStats.evicted++;
+    }
+
+    void Image::upload(::Image pixels)
+    {
+        pending = false;
+        textureStats.pending--;
+
+        if (pixels.data)
+        {
+            texture = LoadTextureFromImage(pixels);
+            lastUsed = textureFrame;
+
+            if (texture.id != 0)
+            {
+                link();
+                textureStats.evicted--;
+            }
+        }
+
+        UnloadImage(pixels);
+        release();
+    }
+
     Version getVersion()
     {
         Version version;
@@ -69,27 +358,59 @@ namespace Api
             }
         }
 
-        Image newImage(string &path)
+        Image *newImage(string &path)
         {
-            int id = GetRandomValue(0, 1000000);
+            return Image::load(path);
+        }
 
-            Image newImage;
+        // Handles passed to the application are released by it
+        void drawImage(Image *image, int x, int y)
+        {
+            if (image == 0)
+                return;
 
-            newImage.id = id;
+            if (image->use())
+                DrawTexture(image->texture, x, y, WHITE);
 
-            loadedTextures[id] = LoadTexture(path.c_str());
+            image->release();
+        }
 
-            return newImage;
+        void point(int x, int y)
+        {
+            DrawPixel(x, y, currentColor);
         }
 
-        void drawImage(Image image, int x, int y)
+        void setTextureBudget(int megabytes, int frames)
         {
-            DrawTexture(loadedTextures[image.id], x, y, WHITE);
+            textureStats.budget = (size_t)max(megabytes, 0) * 1024 * 1024;
+            evictAfterFrames = (unsigned)max(frames, 1);
         }
 
-        void point(int x, int y)
+        void updateTextures()
         {
-            DrawPixel(x, y, currentColor);
+            textureFrame++;
+
+            vector<pair<Image *, ::Image> > loaded;
+
+            {
+                lock_guard<mutex> guard(textureLoader.lock);
+                loaded.swap(textureLoader.loaded);
+            }
+
+            for (size_t i = 0; i < loaded.size(); i++)
+                loaded[i].first->upload(loaded[i].second);
+
+            if (textureStats.budget == 0)
+                return;
+
+            // Least recently drawn first, and never anything drawn in the last few frames
+            while (textureStats.bytes > textureStats.budget && oldestImage && oldestImage->lastUsed + evictAfterFrames <= textureFrame)
+                oldestImage->evict();
+        }
+
+        TextureStats getTextureStats()
+        {
+            return textureStats;
         }
     }
 
@@ -115,17 +436,17 @@ namespace Api
 
         bool isDown(MouseButton button)
         {
-            return IsMouseButtonDown(button);
+            return Input::isMouseDown(button);
         }
 
         bool isPressed(MouseButton button)
         {
-            return IsMouseButtonPressed(button);
+            return Input::isMousePressed(button);
         }
 
         bool isReleased(MouseButton button)
         {
-            return IsMouseButtonReleased(button);
+            return Input::isMouseReleased(button);
         }
     }
 
@@ -133,17 +454,17 @@ namespace Api
     {
         bool isDown(Key key)
         {
-            return IsKeyDown(key);
+            return Input::isKeyDown(key);
         }
 
         bool isPressed(Key key)
         {
-            return IsKeyPressed(key);
+            return Input::isKeyPressed(key);
         }
 
         bool isReleased(Key key)
         {
-            return IsKeyReleased(key);
+            return Input::isKeyReleased(key);
         }
     }
 
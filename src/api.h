@@ -9,7 +9,6 @@
 
 using namespace std;
 
-extern vector<string> consoleHistory;
 extern Vector2 virtualMouse;
 
 namespace Api
@@ -27,12 +26,60 @@ namespace Api
         float y;
     };
 
-    struct Image
+    // A texture shared by every newImage call with the same canonical path.
+    // The GPU texture is unloaded when the last handle to it is released, or
+    // earlier when it goes unused under a texture budget, in which case it is
+    // reloaded in the background the next time it's drawn.
+    class Image
     {
-        int id;
+    public:
+        static Image *load(const string &path);
+
+        void addRef();
+        void release();
+
+        int getWidth() const;
+        int getHeight() const;
+
+        // Marks the image as drawn this frame, returns false while it isn't resident
+        bool use();
+        void evict();
+        void upload(::Image pixels);
+
+        string key;
+        string path;
+        Texture texture;
+        int width;
+        int height;
+        unsigned lastUsed;
+        bool pending;
+
+        // Resident images, from the most to the least recently drawn
+        Image *newer;
+        Image *older;
+
+    private:
+        Image(const string &key, const string &path, Texture texture);
+        ~Image();
+
+        void link();
+        void unlink();
+
+        int refCount;
+    };
+
+    struct TextureStats
+    {
+        int count;
+        size_t bytes;
+        size_t budget;
+        int evicted;
+        int pending;
     };
 
     void log(string &str);
+    void logWarning(string &str);
+    void logError(string &str);
     string toString(int value);
     string toString(float value);
     string toString(bool value);
@@ -42,9 +89,14 @@ namespace Api
     {
         void print(string &str, int x, int y);
         void rectangle(string &mode, int x, int y, int width, int height);
-        Image newImage(string &path);
-        void drawImage(Image image, int x, int y);
+        Image *newImage(string &path);
+        void drawImage(Image *image, int x, int y);
         void point(int x, int y);
+
+        void setTextureBudget(int megabytes, int frames);
+        // Once per frame before drawing: uploads reloaded textures and evicts over budget
+        void updateTextures();
+        TextureStats getTextureStats();
     }
 
     namespace Math
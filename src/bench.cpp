@@ -0,0 +1,310 @@
+#include "bench.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+using namespace std;
+
+static const char *phaseNames[] = { "frame", "update", "draw", "present" };
+
+static const vector<double> &phaseSamples(const Bench::Scene &scene, int phase)
+{
+    switch (phase)
+    {
+        case 1: return scene.update;
+        case 2: return scene.draw;
+        case 3: return scene.present;
+        default: return scene.frame;
+    }
+}
+
+// Minimal reader for the files written by writeJson, every number ends up
+// in a flat map keyed by its dotted path ("scenes.points.frame.mean").
+struct JsonReader
+{
+    const char *p;
+    map<string, double> values;
+
+    void skipSpace()
+    {
+        while (*p && isspace((unsigned char)*p))
+            p++;
+    }
+
+    bool readString(string &out)
+    {
+        skipSpace();
+
+        if (*p != '"')
+            return false;
+
+        p++;
+        out.clear();
+
+        while (*p && *p != '"')
+        {
+            if (*p == '\\' && p[1])
+                p++;
+
+            out += *p++;
+        }
+
+        if (*p != '"')
+            return false;
+
+        p++;
+        return true;
+    }
+
+    bool readValue(const string &path)
+    {
+        skipSpace();
+
+        if (*p == '{')
+        {
+            p++;
+            skipSpace();
+
+            if (*p == '}')
+            {
+                p++;
+                return true;
+            }
+
+            while (true)
+            {
+                string key;
+
+                if (!readString(key))
+                    return false;
+
+                skipSpace();
+
+                if (*p != ':')
+                    return false;
+
+                p++;
+
+                if (!readValue(path.empty() ? key : path + "." + key))
+                    return false;
+
+                skipSpace();
+
+                if (*p == ',')
+                {
+                    p++;
+                    continue;
+                }
+
+                if (*p != '}')
+                    return false;
+
+                p++;
+                return true;
+            }
+        }
+        else if (*p == '[')
+        {
+            p++;
+            skipSpace();
+
+            if (*p == ']')
+            {
+                p++;
+                return true;
+            }
+
+            for (int i = 0; ; i++)
+            {
+                if (!readValue(path + "." + to_string(i)))
+                    return false;
+
+                skipSpace();
+
+                if (*p == ',')
+                {
+                    p++;
+                    continue;
+                }
+
+                if (*p != ']')
+                    return false;
+
+                p++;
+                return true;
+            }
+        }
+        else if (*p == '"')
+        {
+            string ignored;
+            return readString(ignored);
+        }
+        else if (*p == '-' || isdigit((unsigned char)*p))
+        {
+            char *end;
+            double value = strtod(p, &end);
+
+            if (end == p)
+                return false;
+
+            values[path] = value;
+            p = end;
+            return true;
+        }
+
+        while (isalpha((unsigned char)*p))
+            p++;
+
+        return true;
+    }
+};
+
+namespace Bench
+{
+    Stats computeStats(const vector<double> &samples)
+    {
+        Stats stats = { 0.0, 0.0, 0.0, 0.0 };
+
+        if (samples.empty())
+            return stats;
+
+        vector<double> sorted(samples);
+        sort(sorted.begin(), sorted.end());
+
+        double sum = 0.0;
+
+        for (double sample : sorted)
+            sum += sample;
+
+        size_t n = sorted.size();
+
+        stats.mean = sum / n;
+        stats.p50 = sorted[(size_t)ceil(0.50 * n) - 1];
+        stats.p99 = sorted[(size_t)ceil(0.99 * n) - 1];
+        stats.max = sorted[n - 1];
+
+        return stats;
+    }
+
+    bool writeJson(const string &path, const vector<Scene> &scenes, int frames, int warmup)
+    {
+        FILE *file = path.empty() ? stdout : fopen(path.c_str(), "w");
+
+        if (file == 0)
+        {
+            printf("Failed to open %s for writing.\n", path.c_str());
+            return false;
+        }
+
+        fprintf(file, "{\n");
+        fprintf(file, "    \"frames\": %d,\n", frames);
+        fprintf(file, "    \"warmup\": %d,\n", warmup);
+        fprintf(file, "    \"scenes\": {");
+
+        for (size_t i = 0; i < scenes.size(); i++)
+        {
+            const Scene &scene = scenes[i];
+
+            fprintf(file, "%s\n        \"%s\": {\n", i > 0 ? "," : "", scene.name.c_str());
+            fprintf(file, "            \"failed\": %s,\n", scene.failed ? "true" : "false");
+            fprintf(file, "            \"samples\": %d", (int)scene.frame.size());
+
+            for (int phase = 0; phase < 4; phase++)
+            {
+                Stats stats = computeStats(phaseSamples(scene, phase));
+
+                fprintf(file, ",\n            \"%s\": { \"mean\": %.4f, \"p50\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+                    phaseNames[phase], stats.mean, stats.p50, stats.p99, stats.max);
+            }
+
+            fprintf(file, "\n        }");
+        }
+
+        fprintf(file, "\n    }\n}\n");
+
+        if (file != stdout)
+            fclose(file);
+
+        return true;
+    }
+
+    int compare(const vector<Scene> &scenes, const string &baselinePath, double threshold)
+    {
+        FILE *file = fopen(baselinePath.c_str(), "rb");
+
+        if (file == 0)
+        {
+            printf("Failed to open baseline %s.\n", baselinePath.c_str());
+            return -1;
+        }
+
+        string text;
+        char chunk[4096];
+        size_t read;
+
+        while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+            text.append(chunk, read);
+
+        fclose(file);
+
+        JsonReader reader;
+        reader.p = text.c_str();
+
+        if (!reader.readValue(""))
+        {
+            printf("Failed to parse baseline %s.\n", baselinePath.c_str());
+            return -1;
+        }
+
+        // Differences below this many milliseconds are treated as timer noise.
+        const double noiseFloor = 0.05;
+        const char *statNames[] = { "mean", "p99" };
+
+        int regressions = 0;
+
+        printf("%-16s %-8s %-5s %10s %10s %8s\n", "scene", "phase", "stat", "baseline", "current", "change");
+
+        for (const Scene &scene : scenes)
+        {
+            if (scene.failed)
+            {
+                printf("%-16s failed to run\n", scene.name.c_str());
+                regressions++;
+                continue;
+            }
+
+            for (int phase = 0; phase < 4; phase++)
+            {
+                Stats stats = computeStats(phaseSamples(scene, phase));
+                double current[] = { stats.mean, stats.p99 };
+
+                for (int s = 0; s < 2; s++)
+                {
+                    string key = "scenes." + scene.name + "." + phaseNames[phase] + "." + statNames[s];
+                    map<string, double>::iterator it = reader.values.find(key);
+
+                    if (it == reader.values.end())
+                        continue;
+
+                    double base = it->second;
+                    double change = base > 0.0 ? (current[s] - base) / base : 0.0;
+                    bool regressed = current[s] - base > noiseFloor && change > threshold;
+
+                    printf("%-16s %-8s %-5s %10.4f %10.4f %+7.1f%%%s\n", scene.name.c_str(), phaseNames[phase], statNames[s],
+                        base, current[s], change * 100.0, regressed ? "  REGRESSION" : "");
+
+                    if (regressed)
+                        regressions++;
+                }
+            }
+        }
+
+        return regressions;
+    }
+}
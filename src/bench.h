@@ -0,0 +1,34 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace Bench
+{
+    struct Stats
+    {
+        double mean;
+        double p50;
+        double p99;
+        double max;
+    };
+
+    struct Scene
+    {
+        string name;
+        bool failed;
+        vector<double> frame;
+        vector<double> update;
+        vector<double> draw;
+        vector<double> present;
+    };
+
+    Stats computeStats(const vector<double> &samples);
+    bool writeJson(const string &path, const vector<Scene> &scenes, int frames, int warmup);
+    int compare(const vector<Scene> &scenes, const string &baselinePath, double threshold);
+}
+
+#endif
@@ -0,0 +1,103 @@
+#include "console.h"
+
+#include <cstring>
+#include <cstdint>
+
+using namespace std;
+
+static const uint32_t arenaSize = 1 << 20;
+static const int maxRecords = 16384;
+
+struct Record
+{
+    uint32_t offset;
+    uint32_t length;
+    Console::Level level;
+};
+
+static char arena[arenaSize];
+static uint32_t head = 0;
+
+static Record records[maxRecords];
+static int first = 0;
+static int used = 0;
+
+static void dropOldest()
+{
+    first = (first + 1) % maxRecords;
+    used--;
+}
+
+namespace Console
+{
+    void print(Level level, const char *text, size_t length)
+    {
+        // Trailing newlines are implied by the console
+        while (length > 0 && (text[length - 1] == '\n' || text[length - 1] == '\r'))
+            length--;
+
+        if (length > arenaSize)
+            length = arenaSize;
+
+        uint32_t start = head;
+
+        if (start + length > arenaSize)
+        {
+            // Whatever is still between the head and the end of the arena is
+            // older than anything at the front, so it goes first
+            while (used > 0 && records[first].offset >= start)
+                dropOldest();
+
+            start = 0;
+        }
+
+        uint32_t end = start + (uint32_t)length;
+
+        // Records left from the previous pass over the arena all start at or
+        // after the head, oldest first, so the ones in the way are at the front
+        while (used > 0 && records[first].offset >= start && records[first].offset < end)
+            dropOldest();
+
+        if (used == maxRecords)
+            dropOldest();
+
+        memcpy(arena + start, text, length);
+
+        Record &record = records[(first + used) % maxRecords];
+        record.offset = start;
+        record.length = (uint32_t)length;
+        record.level = level;
+        used++;
+
+        head = end;
+    }
+
+    void print(Level level, const string &text)
+    {
+        print(level, text.data(), text.size());
+    }
+
+    void clear()
+    {
+        head = 0;
+        first = 0;
+        used = 0;
+    }
+
+    int count()
+    {
+        return used;
+    }
+
+    Line line(int index)
+    {
+        const Record &record = records[(first + index) % maxRecords];
+
+        Line result;
+        result.text = arena + record.offset;
+        result.length = record.length;
+        result.level = record.level;
+
+        return result;
+    }
+}
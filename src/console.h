@@ -0,0 +1,39 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <string>
+#include <cstddef>
+
+using namespace std;
+
+// The dev console's log. Messages are copied into one fixed size arena and
+// indexed by a fixed size ring of records, so logging never allocates and
+// the oldest messages are dropped once either is full.
+namespace Console
+{
+    enum Level
+    {
+        LEVEL_INFO,
+        LEVEL_WARNING,
+        LEVEL_ERROR,
+        LEVEL_COUNT
+    };
+
+    struct Line
+    {
+        const char *text;
+        size_t length;
+        Level level;
+    };
+
+    void print(Level level, const char *text, size_t length);
+    void print(Level level, const string &text);
+    void clear();
+
+    // Number of messages kept, line 0 is the oldest. The text points into the
+    // arena and is only valid until the next print.
+    int count();
+    Line line(int index);
+}
+
+#endif
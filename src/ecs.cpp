@@ -0,0 +1,575 @@
+#include "ecs.h"
+#include "log.h"
+
+#include <cassert>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Entity ids pack the slot index in the low bits and a generation counter in
+// the high bits, so ids of destroyed entities never match a reused slot.
+static const int indexBits = 20;
+static const uint32_t indexMask = (1u << indexBits) - 1;
+static const uint32_t generationMask = (1u << (31 - indexBits)) - 1;
+
+static vector<Api::Ecs::Component> components;
+static vector<uint32_t> generations;
+static vector<uint8_t> living;
+static vector<uint32_t> freeSlots;
+static int livingCount = 0;
+
+struct Api::Ecs::State
+{
+    vector<Api::Ecs::Component> components;
+    vector<uint32_t> generations;
+    vector<uint8_t> living;
+    vector<uint32_t> freeSlots;
+    int livingCount;
+};
+
+static void swapState(Api::Ecs::State &state)
+{
+    components.swap(state.components);
+    generations.swap(state.generations);
+    living.swap(state.living);
+    freeSlots.swap(state.freeSlots);
+    swap(livingCount, state.livingCount);
+}
+
+static void setException(const char *message)
+{
+    asIScriptContext *ctx = asGetActiveContext();
+
+    if (ctx)
+        ctx->SetException(message);
+}
+
+static uint32_t entityIndex(int entity)
+{
+    return (uint32_t)entity & indexMask;
+}
+
+static Api::Ecs::Component *getComponent(int component)
+{
+    if (component < 0 || component >= (int)components.size())
+    {
+        setException("Invalid component");
+        return 0;
+    }
+
+    return &components[component];
+}
+
+static int getRow(const Api::Ecs::Component &c, int entity)
+{
+    uint32_t slot = entityIndex(entity);
+
+    if (slot >= c.sparse.size())
+        return -1;
+
+    return c.sparse[slot];
+}
+
+static Api::Ecs::Field *getField(Api::Ecs::Component &c, const string &name)
+{
+    for (Api::Ecs::Field &field : c.fields)
+    {
+        if (field.name == name)
+            return &field;
+    }
+
+    setException("Invalid component field");
+    return 0;
+}
+
+static float *getFloats(Api::Ecs::Component &c, const char *name)
+{
+    Api::Ecs::Field *field = getField(c, name);
+
+    if (field == 0)
+        return 0;
+
+    if (field->floats == 0)
+    {
+        setException("Component field must be a float");
+        return 0;
+    }
+
+    return field->floats->data.data();
+}
+
+static void removeRow(Api::Ecs::Component &c, int entity)
+{
+    int row = getRow(c, entity);
+
+    if (row < 0)
+        return;
+
+    // Move the last row into the hole so the columns stay packed.
+    int last = (int)c.entities->data.size() - 1;
+    int moved = c.entities->data[last];
+
+    c.entities->data[row] = moved;
+    c.entities->data.pop_back();
+
+    for (Api::Ecs::Field &field : c.fields)
+    {
+        if (field.floats)
+        {
+            field.floats->data[row] = field.floats->data[last];
+            field.floats->data.pop_back();
+        }
+        else
+        {
+            field.ints->data[row] = field.ints->data[last];
+            field.ints->data.pop_back();
+        }
+    }
+
+    c.sparse[entityIndex(moved)] = row;
+    c.sparse[entityIndex(entity)] = -1;
+}
+
+static bool isComponent(const vector<string> &metadata)
+{
+    for (const string &entry : metadata)
+    {
+        size_t begin = entry.find_first_not_of(" \t");
+        size_t end = entry.find_last_not_of(" \t");
+
+        if (begin != string::npos && entry.compare(begin, end - begin + 1, "component") == 0)
+            return true;
+    }
+
+    return false;
+}
+
+namespace Api
+{
+    namespace Ecs
+    {
+        void loadComponents(asIScriptModule *module, CScriptBuilder &builder)
+        {
+            reset();
+
+            for (asUINT i = 0; i < module->GetObjectTypeCount(); i++)
+            {
+                asITypeInfo *type = module->GetObjectTypeByIndex(i);
+
+                if (!isComponent(builder.GetMetadataForType(type->GetTypeId())))
+                    continue;
+
+                Component c;
+                c.name = type->GetName();
+                c.entities = Int32Array::create();
+                c.entities->fixedLength = true;
+
+                for (asUINT p = 0; p < type->GetPropertyCount(); p++)
+                {
+                    const char *name;
+                    int typeId;
+
+                    type->GetProperty(p, &name, &typeId);
+
+                    Field field;
+                    field.name = name;
+                    field.floats = 0;
+                    field.ints = 0;
+
+                    if (typeId == asTYPEID_FLOAT || typeId == asTYPEID_DOUBLE)
+                        field.floats = Float32Array::create();
+                    else if (typeId >= asTYPEID_BOOL && typeId <= asTYPEID_UINT64)
+                        field.ints = Int32Array::create();
+                    else
+                    {
+                        Log::write(Console::LEVEL_WARNING, "Component " + c.name + ": field " + name + " is not a number and is ignored.");
+                        continue;
+                    }
+
+                    // Columns only hold 32 bit values
+                    if (typeId == asTYPEID_DOUBLE)
+                        Log::write(Console::LEVEL_WARNING, "Component " + c.name + ": field " + name + " is a double and is stored as a float.");
+                    else if (typeId == asTYPEID_INT64 || typeId == asTYPEID_UINT64 || typeId == asTYPEID_UINT32)
+                        Log::write(Console::LEVEL_WARNING, "Component " + c.name + ": field " + name + " is stored as a 32 bit signed integer.");
+
+                    if (field.floats)
+                        field.floats->fixedLength = true;
+                    else
+                        field.ints->fixedLength = true;
+
+                    c.fields.push_back(field);
+                }
+
+                components.push_back(c);
+            }
+        }
+
+        void reset()
+        {
+            for (Component &c : components)
+            {
+                c.entities->release();
+
+                for (Field &field : c.fields)
+                {
+                    if (field.floats)
+                        field.floats->release();
+                    if (field.ints)
+                        field.ints->release();
+                }
+            }
+
+            components.clear();
+            generations.clear();
+            living.clear();
+            freeSlots.clear();
+            livingCount = 0;
+        }
+
+        State *setAside()
+        {
+            State *state = new State();
+            state->livingCount = 0;
+            swapState(*state);
+            return state;
+        }
+
+        void putBack(State *state)
+        {
+            reset();
+            swapState(*state);
+            delete state;
+        }
+
+        void discard(State *state)
+        {
+            // reset only knows how to release the live state
+            swapState(*state);
+            reset();
+            swapState(*state);
+            delete state;
+        }
+
+        int create()
+        {
+            uint32_t slot;
+
+            if (!freeSlots.empty())
+            {
+                slot = freeSlots.back();
+                freeSlots.pop_back();
+            }
+            else
+            {
+                if (generations.size() > indexMask)
+                {
+                    setException("Too many entities");
+                    return -1;
+                }
+
+                slot = (uint32_t)generations.size();
+                generations.push_back(0);
+                living.push_back(0);
+            }
+
+            living[slot] = 1;
+            livingCount++;
+
+            return (int)(slot | (generations[slot] << indexBits));
+        }
+
+        void destroy(int entity)
+        {
+            if (!alive(entity))
+                return;
+
+            for (Component &c : components)
+                removeRow(c, entity);
+
+            uint32_t slot = entityIndex(entity);
+
+            living[slot] = 0;
+            generations[slot] = (generations[slot] + 1) & generationMask;
+            freeSlots.push_back(slot);
+            livingCount--;
+        }
+
+        bool alive(int entity)
+        {
+            if (entity < 0)
+                return false;
+
+            uint32_t slot = entityIndex(entity);
+
+            return slot < living.size() && living[slot] && generations[slot] == ((uint32_t)entity >> indexBits);
+        }
+
+        int count()
+        {
+            return livingCount;
+        }
+
+        int component(const string &name)
+        {
+            for (size_t i = 0; i < components.size(); i++)
+            {
+                if (components[i].name == name)
+                    return (int)i;
+            }
+
+            setException("Unknown component, is the class marked with [component]?");
+            return -1;
+        }
+
+        void add(int entity, int component)
+        {
+            Component *c = getComponent(component);
+
+            if (c == 0)
+                return;
+
+            if (!alive(entity))
+            {
+                setException("Invalid entity");
+                return;
+            }
+
+            if (getRow(*c, entity) >= 0)
+                return;
+
+            uint32_t slot = entityIndex(entity);
+
+            if (slot >= c->sparse.size())
+                c->sparse.resize(generations.size(), -1);
+
+            c->sparse[slot] = (int32_t)c->entities->data.size();
+            c->entities->data.push_back(entity);
+
+            for (Field &field : c->fields)
+            {
+                if (field.floats)
+                    field.floats->data.push_back(0.0f);
+                else
+                    field.ints->data.push_back(0);
+            }
+        }
+
+        void remove(int entity, int component)
+        {
+            Component *c = getComponent(component);
+
+            if (c && alive(entity))
+                removeRow(*c, entity);
+        }
+
+        bool has(int entity, int component)
+        {
+            return index(entity, component) >= 0;
+        }
+
+        int index(int entity, int component)
+        {
+            Component *c = getComponent(component);
+
+            if (c == 0 || !alive(entity))
+                return -1;
+
+            return getRow(*c, entity);
+        }
+
+        Float32Array *floats(int component, const string &name)
+        {
+            Component *c = getComponent(component);
+            Field *field = c ? getField(*c, name) : 0;
+
+            if (field == 0)
+                return 0;
+
+            if (field->floats == 0)
+            {
+                setException("Component field is not a float, use ints()");
+                return 0;
+            }
+
+            field->floats->addRef();
+            return field->floats;
+        }
+
+        Int32Array *ints(int component, const string &name)
+        {
+            Component *c = getComponent(component);
+            Field *field = c ? getField(*c, name) : 0;
+
+            if (field == 0)
+                return 0;
+
+            if (field->ints == 0)
+            {
+                setException("Component field is not an integer, use floats()");
+                return 0;
+            }
+
+            field->ints->addRef();
+            return field->ints;
+        }
+
+        const Int32Array *entities(int component)
+        {
+            Component *c = getComponent(component);
+
+            if (c == 0)
+                return 0;
+
+            c->entities->addRef();
+            return c->entities;
+        }
+
+        void query(const CScriptArray *required, Int32Array *out)
+        {
+            if (required == 0 || out == 0)
+            {
+                setException("Null pointer access");
+                return;
+            }
+
+            if (out->fixedLength)
+            {
+                setException("The array has a fixed length");
+                return;
+            }
+
+            out->data.clear();
+
+            vector<Component *> sets;
+
+            for (asUINT i = 0; i < required->GetSize(); i++)
+            {
+                Component *c = getComponent(*(const int *)required->At(i));
+
+                if (c == 0)
+                    return;
+
+                sets.push_back(c);
+            }
+
+            if (sets.empty())
+                return;
+
+            // Walk the smallest set and probe the others, so the cost only
+            // depends on how many entities could possibly match.
+            size_t smallest = 0;
+
+            for (size_t i = 1; i < sets.size(); i++)
+            {
+                if (sets[i]->entities->data.size() < sets[smallest]->entities->data.size())
+                    smallest = i;
+            }
+
+            for (int32_t entity : sets[smallest]->entities->data)
+            {
+                bool match = true;
+
+                for (size_t i = 0; i < sets.size() && match; i++)
+                    match = i == smallest || getRow(*sets[i], entity) >= 0;
+
+                if (match)
+                    out->data.push_back(entity);
+            }
+        }
+
+        void integrate(int position, int velocity, float dt)
+        {
+            Component *p = getComponent(position);
+            Component *v = getComponent(velocity);
+
+            if (p == 0 || v == 0)
+                return;
+
+            float *px = getFloats(*p, "x");
+            float *py = getFloats(*p, "y");
+            const float *vx = getFloats(*v, "x");
+            const float *vy = getFloats(*v, "y");
+
+            if (px == 0 || py == 0 || vx == 0 || vy == 0)
+                return;
+
+            const vector<int32_t> &moving = v->entities->data;
+
+            for (size_t i = 0; i < moving.size(); i++)
+            {
+                int row = getRow(*p, moving[i]);
+
+                if (row < 0)
+                    continue;
+
+                px[row] += vx[i] * dt;
+                py[row] += vy[i] * dt;
+            }
+        }
+
+        void cull(int position, float left, float top, float right, float bottom, Int32Array *out)
+        {
+            Component *p = getComponent(position);
+
+            if (p == 0)
+                return;
+
+            if (out == 0)
+            {
+                setException("Null pointer access");
+                return;
+            }
+
+            if (out->fixedLength)
+            {
+                setException("The array has a fixed length");
+                return;
+            }
+
+            const float *x = getFloats(*p, "x");
+            const float *y = getFloats(*p, "y");
+
+            if (x == 0 || y == 0)
+                return;
+
+            const vector<int32_t> &placed = p->entities->data;
+
+            out->data.clear();
+
+            for (size_t i = 0; i < placed.size(); i++)
+            {
+                if (x[i] >= left && x[i] <= right && y[i] >= top && y[i] <= bottom)
+                    out->data.push_back(placed[i]);
+            }
+        }
+    }
+
+    void registerEcs(asIScriptEngine *engine)
+    {
+        int r;
+
+        r = engine->SetDefaultNamespace("vd::ecs"); assert(r >= 0);
+
+        r = engine->RegisterGlobalFunction("int create()", asFUNCTION(Ecs::create), asCALL_CDECL); assert(r >= 0);
+        r = engine->RegisterGlobalFunction("void destroy(int)", asFUNCTION(Ecs::destroy), asCALL_CDECL); assert(r >= 0);
+        r = engine->RegisterGlobalFunction("bool alive(int)", asFUNCTION(Ecs::alive), asCALL_CDECL); assert(r >= 0);
+        r = engine->RegisterGlobalFunction("int count()", asFUNCTION(Ecs::count), asCALL_CDECL); assert(r >= 0);
+
+        r = engine->RegisterGlobalFunction("int component(const string &in)", asFUNCTION(Ecs::component), asCALL_CDECL); assert(r >= 0);
+        r = engine->RegisterGlobalFunction("void add(int, int)", asFUNCTION(Ecs::add), asCALL_CDECL); assert(r >= 0);
+        r = engine->RegisterGlobalFunction("void remove(int, int)", asFUNCTION(Ecs::remove), asCALL_CDECL); assert(r >= 0);
+        r = engine->RegisterGlobalFunction("bool has(int, int)", asFUNCTION(Ecs::has), asCALL_CDECL); assert(r >= 0);
+        r = engine->RegisterGlobalFunction("int index(int, int)", asFUNCTION(Ecs::index), asCALL_CDECL); assert(r >= 0);
+
+        r = engine->RegisterGlobalFunction("float32array@ floats(int, const string &in)", asFUNCTION(Ecs::floats), asCALL_CDECL); assert(r >= 0);
+        r = engine->RegisterGlobalFunction("int32array@ ints(int, const string &in)", asFUNCTION(Ecs::ints), asCALL_CDECL); assert(r >= 0);
+        r = engine->RegisterGlobalFunction("const int32array@ entities(int)", asFUNCTION(Ecs::entities), asCALL_CDECL); assert(r >= 0);
+
+        r = engine->RegisterGlobalFunction("void query(const array<int>@, int32array@)", asFUNCTION(Ecs::query), asCALL_CDECL); assert(r >= 0);
+
+        r = engine->RegisterGlobalFunction("void integrate(int, int, float)", asFUNCTION(Ecs::integrate), asCALL_CDECL); assert(r >= 0);
+        r = engine->RegisterGlobalFunction("void cull(int, float, float, float, float, int32array@)", asFUNCTION(Ecs::cull), asCALL_CDECL); assert(r >= 0);
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef ECS_H
+#define ECS_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "angelscript.h"
+#include "scriptbuilder.h"
+#include "scriptarray.h"
+#include "typedarray.h"
+
+using namespace std;
+
+namespace Api
+{
+    namespace Ecs
+    {
+        // One field of a component, stored as its own column. Floating point
+        // fields live in a float32array, everything else in an int32array.
+        // Scripts get the columns with a fixed length, only add and remove
+        // change how many rows there are.
+        struct Field
+        {
+            string name;
+            Float32Array *floats;
+            Int32Array *ints;
+        };
+
+        // Components are sparse sets: the columns are packed so that row i of
+        // every column belongs to entities[i], and sparse maps an entity index
+        // to its row, or -1 if the entity doesn't have the component.
+        struct Component
+        {
+            string name;
+            vector<Field> fields;
+            Int32Array *entities;
+            vector<int32_t> sparse;
+        };
+
+        void loadComponents(asIScriptModule *module, CScriptBuilder &builder);
+        void reset();
+
+        // Moves the entities and components of the running game out of the
+        // way while a new build starts, so they can be put back if it fails
+        struct State;
+        State *setAside();
+        void putBack(State *state);
+        void discard(State *state);
+
+        int create();
+        void destroy(int entity);
+        bool alive(int entity);
+        int count();
+
+        int component(const string &name);
+        void add(int entity, int component);
+        void remove(int entity, int component);
+        bool has(int entity, int component);
+        int index(int entity, int component);
+
+        Float32Array *floats(int component, const string &field);
+        Int32Array *ints(int component, const string &field);
+        const Int32Array *entities(int component);
+
+        void query(const CScriptArray *components, Int32Array *out);
+
+        void integrate(int position, int velocity, float dt);
+        void cull(int position, float left, float top, float right, float bottom, Int32Array *out);
+    }
+
+    void registerEcs(asIScriptEngine *engine);
+}
+
+#endif
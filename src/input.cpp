@@ -0,0 +1,424 @@
+#include "input.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "raylib.h"
+
+using namespace std;
+
+// Keys the script can query through vd::keyboard, each gets one bit of Frame::keysDown.
+static const int trackedKeys[] = {
+    65, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 88, 89, 90,
+    32, 13, 27, 38, 40, 37, 39, 16, 17, 18, 9, 8, 20,
+    48, 49, 50, 51, 52, 53, 54, 55, 56, 57,
+    112, 113, 114, 115, 116, 117, 118, 119, 120, 121, 122, 123,
+};
+
+static const int trackedKeyCount = sizeof(trackedKeys) / sizeof(trackedKeys[0]);
+
+enum RecordFlag
+{
+    RECORD_MOUSE = 1 << 0,
+    RECORD_BUTTONS = 1 << 1,
+    RECORD_KEYS = 1 << 2,
+    RECORD_KEY = 1 << 3,
+    RECORD_CHAR = 1 << 4,
+    RECORD_FOCUS = 1 << 5,
+    RECORD_SIZE = 1 << 6,
+    RECORD_LOG = 1 << 7,
+};
+
+static const char recordMagic[4] = { 'V', 'R', 'E', 'C' };
+static const uint8_t recordVersion = 1;
+
+static Input::Frame currentFrame;
+static Input::Frame previousFrame;
+static unsigned int frameCounter = 0;
+static uint32_t logHash = 2166136261u;
+
+static FILE *recordFile = 0;
+static Input::Frame lastWritten;
+
+static FILE *replayFile = 0;
+static Input::Frame replayState;
+static bool diverged = false;
+static unsigned int divergedFrame = 0;
+
+static int keyBit(int key)
+{
+    for (int i = 0; i < trackedKeyCount; i++)
+    {
+        if (trackedKeys[i] == key)
+            return i;
+    }
+
+    return -1;
+}
+
+static void writeVarint(FILE *file, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        fputc((int)((value & 0x7f) | 0x80), file);
+        value >>= 7;
+    }
+
+    fputc((int)value, file);
+}
+
+static bool readVarint(FILE *file, uint32_t &value)
+{
+    value = 0;
+
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        int c = fgetc(file);
+
+        if (c == EOF)
+            return false;
+
+        value |= (uint32_t)(c & 0x7f) << shift;
+
+        if ((c & 0x80) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+static void writeBytes(FILE *file, const void *data, size_t size)
+{
+    fwrite(data, 1, size, file);
+}
+
+static bool readBytes(FILE *file, void *data, size_t size)
+{
+    return fread(data, 1, size, file) == size;
+}
+
+namespace Input
+{
+    void capture(Frame &frame, Vector2 mouse, float dt)
+    {
+        frame.frame = frameCounter;
+        frame.dt = dt;
+        frame.mouse = mouse;
+
+        frame.mouseDown = 0;
+
+        for (int button = 0; button < 3; button++)
+        {
+            if (IsMouseButtonDown(button))
+                frame.mouseDown |= 1 << button;
+        }
+
+        frame.keysDown = 0;
+
+        for (int i = 0; i < trackedKeyCount; i++)
+        {
+            if (IsKeyDown(trackedKeys[i]))
+                frame.keysDown |= (uint64_t)1 << i;
+        }
+
+        frame.keyPressed = GetKeyPressed();
+        frame.charPressed = GetCharPressed();
+        frame.focus = IsWindowFocused();
+        frame.resized = IsWindowResized();
+        frame.width = GetScreenWidth();
+        frame.height = GetScreenHeight();
+        frame.logHash = logHash;
+    }
+
+    void setFrame(const Frame &frame)
+    {
+        previousFrame = frameCounter == 0 ? frame : currentFrame;
+        currentFrame = frame;
+        frameCounter++;
+    }
+
+    const Frame &current()
+    {
+        return currentFrame;
+    }
+
+    bool startRecording(const string &path, unsigned int seed)
+    {
+        recordFile = fopen(path.c_str(), "wb");
+
+        if (recordFile == 0)
+        {
+            printf("Failed to open %s for recording.\n", path.c_str());
+            return false;
+        }
+
+        writeBytes(recordFile, recordMagic, sizeof(recordMagic));
+        fputc(recordVersion, recordFile);
+        writeVarint(recordFile, seed);
+        writeVarint(recordFile, GetScreenWidth());
+        writeVarint(recordFile, GetScreenHeight());
+
+        memset(&lastWritten, 0, sizeof(lastWritten));
+        lastWritten.focus = true;
+        lastWritten.width = GetScreenWidth();
+        lastWritten.height = GetScreenHeight();
+        lastWritten.logHash = logHash;
+
+        return true;
+    }
+
+    void writeFrame(const Frame &frame)
+    {
+        if (recordFile == 0)
+            return;
+
+        uint8_t flags = 0;
+
+        if (frame.mouse.x != lastWritten.mouse.x || frame.mouse.y != lastWritten.mouse.y)
+            flags |= RECORD_MOUSE;
+        if (frame.mouseDown != lastWritten.mouseDown)
+            flags |= RECORD_BUTTONS;
+        if (frame.keysDown != lastWritten.keysDown)
+            flags |= RECORD_KEYS;
+        if (frame.keyPressed != 0)
+            flags |= RECORD_KEY;
+        if (frame.charPressed != 0)
+            flags |= RECORD_CHAR;
+        if (frame.focus != lastWritten.focus)
+            flags |= RECORD_FOCUS;
+        if (frame.resized)
+            flags |= RECORD_SIZE;
+        if (frame.logHash != lastWritten.logHash)
+            flags |= RECORD_LOG;
+
+        fputc(flags, recordFile);
+        writeVarint(recordFile, frame.frame);
+        writeBytes(recordFile, &frame.dt, sizeof(frame.dt));
+
+        if (flags & RECORD_MOUSE)
+        {
+            writeBytes(recordFile, &frame.mouse.x, sizeof(frame.mouse.x));
+            writeBytes(recordFile, &frame.mouse.y, sizeof(frame.mouse.y));
+        }
+
+        if (flags & RECORD_BUTTONS)
+            fputc(frame.mouseDown, recordFile);
+        if (flags & RECORD_KEYS)
+            writeBytes(recordFile, &frame.keysDown, sizeof(frame.keysDown));
+        if (flags & RECORD_KEY)
+            writeVarint(recordFile, frame.keyPressed);
+        if (flags & RECORD_CHAR)
+            writeVarint(recordFile, frame.charPressed);
+        if (flags & RECORD_FOCUS)
+            fputc(frame.focus ? 1 : 0, recordFile);
+
+        if (flags & RECORD_SIZE)
+        {
+            writeVarint(recordFile, frame.width);
+            writeVarint(recordFile, frame.height);
+        }
+
+        if (flags & RECORD_LOG)
+            writeBytes(recordFile, &frame.logHash, sizeof(frame.logHash));
+
+        lastWritten = frame;
+    }
+
+    bool isRecording()
+    {
+        return recordFile != 0;
+    }
+
+    bool startReplay(const string &path, unsigned int &seed)
+    {
+        replayFile = fopen(path.c_str(), "rb");
+
+        if (replayFile == 0)
+        {
+            printf("Failed to open replay %s.\n", path.c_str());
+            return false;
+        }
+
+        char magic[4];
+        uint32_t value, width, height;
+
+        if (!readBytes(replayFile, magic, sizeof(magic)) || memcmp(magic, recordMagic, sizeof(magic)) != 0 ||
+            fgetc(replayFile) != recordVersion || !readVarint(replayFile, value) ||
+            !readVarint(replayFile, width) || !readVarint(replayFile, height))
+        {
+            printf("%s is not a valid recording.\n", path.c_str());
+            fclose(replayFile);
+            replayFile = 0;
+            return false;
+        }
+
+        seed = value;
+
+        memset(&replayState, 0, sizeof(replayState));
+        replayState.focus = true;
+        replayState.width = width;
+        replayState.height = height;
+        replayState.logHash = logHash;
+
+        diverged = false;
+        divergedFrame = 0;
+
+        return true;
+    }
+
+    bool readFrame(Frame &frame)
+    {
+        if (replayFile == 0)
+            return false;
+
+        int flags = fgetc(replayFile);
+        uint32_t value;
+
+        if (flags == EOF || !readVarint(replayFile, value) || !readBytes(replayFile, &replayState.dt, sizeof(replayState.dt)))
+            return false;
+
+        replayState.frame = value;
+        replayState.keyPressed = 0;
+        replayState.charPressed = 0;
+        replayState.resized = false;
+
+        bool ok = true;
+
+        if (flags & RECORD_MOUSE)
+        {
+            ok = ok && readBytes(replayFile, &replayState.mouse.x, sizeof(replayState.mouse.x));
+            ok = ok && readBytes(replayFile, &replayState.mouse.y, sizeof(replayState.mouse.y));
+        }
+
+        if (flags & RECORD_BUTTONS)
+        {
+            int c = fgetc(replayFile);
+            ok = ok && c != EOF;
+            replayState.mouseDown = (uint8_t)c;
+        }
+
+        if (flags & RECORD_KEYS)
+            ok = ok && readBytes(replayFile, &replayState.keysDown, sizeof(replayState.keysDown));
+
+        if (flags & RECORD_KEY)
+        {
+            ok = ok && readVarint(replayFile, value);
+            replayState.keyPressed = value;
+        }
+
+        if (flags & RECORD_CHAR)
+        {
+            ok = ok && readVarint(replayFile, value);
+            replayState.charPressed = value;
+        }
+
+        if (flags & RECORD_FOCUS)
+        {
+            int c = fgetc(replayFile);
+            ok = ok && c != EOF;
+            replayState.focus = c == 1;
+        }
+
+        if (flags & RECORD_SIZE)
+        {
+            uint32_t width = 0, height = 0;
+            ok = ok && readVarint(replayFile, width) && readVarint(replayFile, height);
+            replayState.width = width;
+            replayState.height = height;
+            replayState.resized = true;
+        }
+
+        if (flags & RECORD_LOG)
+            ok = ok && readBytes(replayFile, &replayState.logHash, sizeof(replayState.logHash));
+
+        if (!ok)
+            return false;
+
+        // The recorded hash covers everything logged before this frame started,
+        // so comparing it against ours spots the first frame that behaved differently.
+        if (!diverged && replayState.logHash != logHash)
+        {
+            diverged = true;
+            divergedFrame = replayState.frame;
+        }
+
+        frame = replayState;
+        frame.frame = frameCounter;
+        frame.logHash = logHash;
+
+        return true;
+    }
+
+    bool isReplaying()
+    {
+        return replayFile != 0;
+    }
+
+    bool hasDiverged()
+    {
+        return diverged;
+    }
+
+    unsigned int getDivergedFrame()
+    {
+        return divergedFrame;
+    }
+
+    void stop()
+    {
+        if (recordFile != 0)
+        {
+            fclose(recordFile);
+            recordFile = 0;
+        }
+
+        if (replayFile != 0)
+        {
+            fclose(replayFile);
+            replayFile = 0;
+        }
+    }
+
+    void noteLog(const string &str)
+    {
+        for (unsigned char c : str)
+        {
+            logHash ^= c;
+            logHash *= 16777619u;
+        }
+    }
+
+    bool isMouseDown(int button)
+    {
+        return button >= 0 && button < 8 && (currentFrame.mouseDown & (1 << button)) != 0;
+    }
+
+    bool isMousePressed(int button)
+    {
+        return isMouseDown(button) && (previousFrame.mouseDown & (1 << button)) == 0;
+    }
+
+    bool isMouseReleased(int button)
+    {
+        return button >= 0 && button < 8 && !isMouseDown(button) && (previousFrame.mouseDown & (1 << button)) != 0;
+    }
+
+    bool isKeyDown(int key)
+    {
+        int bit = keyBit(key);
+        return bit >= 0 && (currentFrame.keysDown & ((uint64_t)1 << bit)) != 0;
+    }
+
+    bool isKeyPressed(int key)
+    {
+        int bit = keyBit(key);
+        return bit >= 0 && (currentFrame.keysDown & ((uint64_t)1 << bit)) != 0 && (previousFrame.keysDown & ((uint64_t)1 << bit)) == 0;
+    }
+
+    bool isKeyReleased(int key)
+    {
+        int bit = keyBit(key);
+        return bit >= 0 && (currentFrame.keysDown & ((uint64_t)1 << bit)) == 0 && (previousFrame.keysDown & ((uint64_t)1 << bit)) != 0;
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <string>
+#include <cstdint>
+
+#include "raylib.h"
+
+using namespace std;
+
+namespace Input
+{
+    struct Frame
+    {
+        unsigned int frame;
+        float dt;
+        Vector2 mouse;
+        uint8_t mouseDown;
+        uint64_t keysDown;
+        int keyPressed;
+        int charPressed;
+        bool focus;
+        bool resized;
+        int width;
+        int height;
+        uint32_t logHash;
+    };
+
+    void capture(Frame &frame, Vector2 mouse, float dt);
+    void setFrame(const Frame &frame);
+    const Frame &current();
+
+    bool startRecording(const string &path, unsigned int seed);
+    void writeFrame(const Frame &frame);
+    bool isRecording();
+
+    bool startReplay(const string &path, unsigned int &seed);
+    bool readFrame(Frame &frame);
+    bool isReplaying();
+    bool hasDiverged();
+    unsigned int getDivergedFrame();
+
+    void stop();
+
+    void noteLog(const string &str);
+
+    bool isMouseDown(int button);
+    bool isMousePressed(int button);
+    bool isMouseReleased(int button);
+
+    bool isKeyDown(int key);
+    bool isKeyPressed(int key);
+    bool isKeyReleased(int key);
+}
+
+#endif
@@ -0,0 +1,349 @@
+#include "log.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+static const size_t queueSize = 256 * 1024;
+static const size_t maxMessage = 16 * 1024;
+static const long maxFileSize = 4 * 1024 * 1024;
+static const int keptFiles = 3;
+
+// Stored in front of every message, padded so headers stay aligned
+struct Header
+{
+    uint32_t length;
+    uint32_t frame;
+    double time;
+    Console::Level level;
+};
+
+static const uint32_t wrapMarker = 0xffffffff;
+
+static size_t padded(size_t size)
+{
+    return (size + 7) & ~(size_t)7;
+}
+
+// A ring of bytes written by one thread and read by the writer thread.
+// Positions only ever grow, the offset into the ring is the position modulo
+// its size.
+struct Queue
+{
+    char data[queueSize];
+    atomic<size_t> readPosition;
+    atomic<size_t> writePosition;
+
+    // Set once the thread that wrote to it has exited, the writer thread
+    // frees the queue when it has drained it
+    atomic<bool> retired;
+
+    Queue() : readPosition(0), writePosition(0), retired(false) {}
+};
+
+// Retires the thread's queue when the thread exits, so threads that come
+// and go, like the build thread, don't leave their queues behind
+struct QueueOwner
+{
+    Queue *queue;
+
+    QueueOwner() : queue(0) {}
+
+    ~QueueOwner()
+    {
+        if (queue)
+            queue->retired.store(true, memory_order_release);
+    }
+};
+
+struct ConsoleLine
+{
+    Console::Level level;
+    string text;
+};
+
+static mutex queuesMutex;
+static vector<Queue *> queues;
+static thread_local QueueOwner threadQueue;
+
+static thread writer;
+static atomic<bool> running(false);
+static atomic<unsigned int> currentFrame(0);
+static chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+
+static FILE *file = 0;
+static string filePath;
+
+static mutex consoleMutex;
+static vector<ConsoleLine> consoleLines;
+
+static const char *levelName(Console::Level level)
+{
+    if (level == Console::LEVEL_WARNING)
+        return "WARN";
+
+    if (level == Console::LEVEL_ERROR)
+        return "ERR";
+
+    return "INFO";
+}
+
+static Queue *getQueue()
+{
+    if (threadQueue.queue == 0)
+    {
+        threadQueue.queue = new Queue();
+
+        lock_guard<mutex> lock(queuesMutex);
+        queues.push_back(threadQueue.queue);
+    }
+
+    return threadQueue.queue;
+}
+
+static void rotate()
+{
+    fclose(file);
+
+    // void.log becomes void.log.1, void.log.1 becomes void.log.2 and so on
+    remove((filePath + "." + to_string(keptFiles)).c_str());
+
+    for (int i = keptFiles - 1; i >= 1; i--)
+        rename((filePath + "." + to_string(i)).c_str(), (filePath + "." + to_string(i + 1)).c_str());
+
+    rename(filePath.c_str(), (filePath + ".1").c_str());
+
+    file = fopen(filePath.c_str(), "w");
+}
+
+// Drains every queue and frees the retired ones, returns whether anything
+// was written
+static bool drain(string &out, vector<ConsoleLine> &lines)
+{
+    vector<Queue *> snapshot;
+    vector<Queue *> finished;
+
+    {
+        lock_guard<mutex> lock(queuesMutex);
+        snapshot = queues;
+    }
+
+    out.clear();
+
+    for (auto queue : snapshot)
+    {
+        // Checked before reading the write position, so a retired queue is
+        // known to hold everything its thread wrote
+        bool retired = queue->retired.load(memory_order_acquire);
+
+        size_t read = queue->readPosition.load(memory_order_relaxed);
+        size_t end = queue->writePosition.load(memory_order_acquire);
+
+        while (read < end)
+        {
+            size_t offset = read % queueSize;
+
+            // The end of the ring may only have room for the marker
+            uint32_t length;
+            memcpy(&length, queue->data + offset, sizeof(length));
+
+            if (length == wrapMarker)
+            {
+                read += queueSize - offset;
+                continue;
+            }
+
+            Header header;
+            memcpy(&header, queue->data + offset, sizeof(header));
+
+            const char *text = queue->data + offset + sizeof(Header);
+
+            char prefix[64];
+            int prefixLength = snprintf(prefix, sizeof(prefix), "[%10.3f] [%6u] %-4s ", header.time, header.frame, levelName(header.level));
+
+            out.append(prefix, prefixLength);
+            out.append(text, header.length);
+            out += '\n';
+
+            ConsoleLine line;
+            line.level = header.level;
+            line.text.assign(text, header.length);
+            lines.push_back(line);
+
+            read += padded(sizeof(Header) + header.length);
+        }
+
+        queue->readPosition.store(read, memory_order_release);
+
+        if (retired)
+            finished.push_back(queue);
+    }
+
+    if (!finished.empty())
+    {
+        lock_guard<mutex> lock(queuesMutex);
+
+        for (auto queue : finished)
+        {
+            queues.erase(find(queues.begin(), queues.end(), queue));
+            delete queue;
+        }
+    }
+
+    if (out.empty())
+        return false;
+
+    fwrite(out.data(), 1, out.size(), stdout);
+    fflush(stdout);
+
+    if (file)
+    {
+        fwrite(out.data(), 1, out.size(), file);
+        fflush(file);
+
+        if (ftell(file) > maxFileSize)
+            rotate();
+    }
+
+    return true;
+}
+
+static void writeLoop()
+{
+    string out;
+    vector<ConsoleLine> lines;
+
+    for (;;)
+    {
+        bool stopping = !running;
+
+        lines.clear();
+        bool wrote = drain(out, lines);
+
+        if (!lines.empty())
+        {
+            lock_guard<mutex> lock(consoleMutex);
+
+            for (auto &line : lines)
+                consoleLines.push_back(move(line));
+        }
+
+        // Anything queued before running was cleared has been written now
+        if (stopping)
+            break;
+
+        if (!wrote)
+            this_thread::sleep_for(chrono::milliseconds(2));
+    }
+}
+
+namespace Log
+{
+    void start(const string &path)
+    {
+        if (running)
+            return;
+
+        filePath = path;
+        file = fopen(path.c_str(), "w");
+
+        if (file == 0)
+            printf("Failed to open %s for writing.\n", path.c_str());
+
+        running = true;
+        writer = thread(writeLoop);
+    }
+
+    void stop()
+    {
+        if (!running)
+            return;
+
+        running = false;
+        writer.join();
+
+        if (file)
+            fclose(file);
+
+        file = 0;
+    }
+
+    void write(Console::Level level, const char *text, size_t length)
+    {
+        while (length > 0 && (text[length - 1] == '\n' || text[length - 1] == '\r'))
+            length--;
+
+        if (length > maxMessage)
+            length = maxMessage;
+
+        if (!running)
+        {
+            printf("%.*s\n", (int)length, text);
+            Console::print(level, text, length);
+            return;
+        }
+
+        Queue *queue = getQueue();
+
+        Header header;
+        header.length = (uint32_t)length;
+        header.frame = currentFrame.load(memory_order_relaxed);
+        header.time = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+        header.level = level;
+
+        size_t size = padded(sizeof(Header) + length);
+        size_t write = queue->writePosition.load(memory_order_relaxed);
+        size_t offset = write % queueSize;
+
+        // Messages never straddle the end of the ring
+        size_t skip = offset + size > queueSize ? queueSize - offset : 0;
+
+        // A full queue waits for the writer thread rather than dropping messages
+        while (write + skip + size - queue->readPosition.load(memory_order_acquire) > queueSize)
+            this_thread::yield();
+
+        if (skip > 0)
+        {
+            uint32_t marker = wrapMarker;
+            memcpy(queue->data + offset, &marker, sizeof(marker));
+            write += skip;
+            offset = 0;
+        }
+
+        memcpy(queue->data + offset, &header, sizeof(header));
+        memcpy(queue->data + offset + sizeof(Header), text, length);
+
+        queue->writePosition.store(write + size, memory_order_release);
+    }
+
+    void write(Console::Level level, const string &text)
+    {
+        write(level, text.data(), text.size());
+    }
+
+    void setFrame(unsigned int frame)
+    {
+        currentFrame.store(frame, memory_order_relaxed);
+    }
+
+    void update()
+    {
+        vector<ConsoleLine> lines;
+
+        {
+            lock_guard<mutex> lock(consoleMutex);
+            lines.swap(consoleLines);
+        }
+
+        for (auto &line : lines)
+            Console::print(line.level, line.text);
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <string>
+#include <cstddef>
+
+#include "console.h"
+
+using namespace std;
+
+// Asynchronous logging. Every thread that logs gets its own single producer
+// queue, so writing a message is a copy into that queue and never takes a
+// lock. A writer thread drains the queues to stdout and a rotating log file,
+// and hands the lines to the main thread for the console.
+namespace Log
+{
+    void start(const string &path);
+    // Writes out everything still queued and stops the writer thread
+    void stop();
+
+    // Can be called from any thread. Without a running writer the message is
+    // printed and sent to the console straight away.
+    void write(Console::Level level, const char *text, size_t length);
+    void write(Console::Level level, const string &text);
+
+    // The frame number stamped on messages from now on
+    void setFrame(unsigned int frame);
+
+    // Moves lines written since the last call into the console, main thread only
+    void update();
+}
+
+#endif
@@ -1,8 +1,14 @@
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <string>
 #include <cassert>
 #include <fstream>
 #include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <atomic>
 
 #include "raylib.h"
 #include "raymath.h"
@@ -29,12 +35,26 @@
 #include "scripthelper.h"
 
 #include "api.h"
+#include "typedarray.h"
+#include "ecs.h"
+#include "spatial.h"
+#include "physics.h"
+#include "net.h"
+#include "rollback.h"
+#include "pack.h"
+#include "bench.h"
+#include "input.h"
+#include "search.h"
+#include "console.h"
+#include "log.h"
+#include "resolution.h"
+#include "pacer.h"
 
 #define WINDOW_WIDTH 1280
 #define WINDOW_HEIGHT 720
-#define WIDTH 800
-#define HEIGHT 600
 #define REFRESH_RATE 60
+#define BACKGROUND_RATE 10
+#define MAX_DT 0.1f
 
 #define MAX(a, b) ((a)>(b)? (a) : (b))
 #define MIN(a, b) ((a)<(b)? (a) : (b))
@@ -47,6 +67,15 @@ enum Mode
     MODE_RUNTIME
 };
 
+// What the game does while the window is in the background, or in dev
+// mode while the editor rather than the viewport has focus
+enum Background
+{
+    BACKGROUND_RUN,
+    BACKGROUND_THROTTLE,
+    BACKGROUND_PAUSE
+};
+
 struct Error
 {
     string message;
@@ -57,13 +86,36 @@ struct Error
     vector<string> tracelog;
 };
 
+// A script compiled into its own engine, ready to replace the running one
+struct Build
+{
+    asIScriptEngine *engine;
+    CScriptBuilder builder;
+    Error error;
+    string failure;
+};
+
 Mode mode = MODE_DEV;
 bool devRunning = false;
 bool error = false;
 Error errorMessage;
-vector<string> consoleHistory;
+ImGuiTextFilter consoleFilter;
+bool consoleLevels[Console::LEVEL_COUNT] = { true, true, true };
+vector<int> consoleVisible;
 string baseDir = "demo";
+string mainScript = "main.as";
+string editorScript = "main.as";
+string pendingScript;
+int pendingLine = 0;
+char findText[256] = "";
+char replaceText[256] = "";
+bool findCaseSensitive = false;
+string searchPattern;
+bool searchCaseSensitive = false;
+vector<Search::Match> searchResults;
 bool focus = true;
+Background background = BACKGROUND_THROTTLE;
+bool editorFocused = false;
 Vector2 virtualMouse;
 
 asIScriptEngine *engine;
@@ -79,7 +131,7 @@ asIScriptFunction *textinputFunc;
 
 void errorHandler(string message)
 {
-    printf("Error: %s\n", message.c_str());
+    Log::write(Console::LEVEL_ERROR, message);
 
     if (ctx)
     {
@@ -95,8 +147,10 @@ void errorHandler(string message)
     errorMessage.message = message;
 }
 
+// param is the Error to fill in, builds running on the build thread have their own
 void messageCallback(const asSMessageInfo *msg, void *param)
 {
+    Error &target = *(Error *)param;
     const char *type = "ERR";
 
     if (msg->type == asMSGTYPE_WARNING)
@@ -104,13 +158,138 @@ void messageCallback(const asSMessageInfo *msg, void *param)
     else if (msg->type == asMSGTYPE_INFORMATION)
         type = "INFO";
 
-    printf("%s (%d, %d) : %s : %s\n", msg->section, msg->row, msg->col, type, msg->message);
+    char line[1024];
+    snprintf(line, sizeof(line), "%s (%d, %d) : %s : %s", msg->section, msg->row, msg->col, type, msg->message);
+
+    Log::write(msg->type == asMSGTYPE_ERROR ? Console::LEVEL_ERROR : msg->type == asMSGTYPE_WARNING ? Console::LEVEL_WARNING : Console::LEVEL_INFO, line);
+
+    target.type = msg->type;
+    target.line = msg->row;
+    target.column = msg->col;
+    target.section = msg->section;
+    target.tracelog.push_back(msg->message);
+}
+
+// Raylib frees what these return, so packed files are copied out of the mapping
+unsigned char *loadPackedFileData(const char *fileName, unsigned int *bytesRead)
+{
+    const char *data;
+    size_t size;
+
+    *bytesRead = 0;
+
+    if (Pack::find(fileName, &data, &size))
+    {
+        unsigned char *copy = (unsigned char *)RL_MALLOC(size);
+        memcpy(copy, data, size);
+        *bytesRead = (unsigned int)size;
+
+        return copy;
+    }
+
+    FILE *file = fopen(fileName, "rb");
+    if (file == 0)
+        return 0;
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    unsigned char *contents = length > 0 ? (unsigned char *)RL_MALLOC(length) : 0;
+    if (contents)
+        *bytesRead = (unsigned int)fread(contents, 1, length, file);
+
+    fclose(file);
+
+    return contents;
+}
+
+char *loadPackedFileText(const char *fileName)
+{
+    unsigned int size;
+    unsigned char *data = loadPackedFileData(fileName, &size);
+
+    if (data == 0)
+        return 0;
+
+    char *text = (char *)RL_MALLOC(size + 1);
+    memcpy(text, data, size);
+    text[size] = '\0';
+
+    RL_FREE(data);
+
+    return text;
+}
+
+bool openPackedFile(const string &fileName, const char **data, size_t *size)
+{
+    return Pack::find(fileName, data, size);
+}
+
+bool mountPack(const string &path)
+{
+    // demo.vpak stands in for the demo directory
+    baseDir = path.substr(0, path.size() - 5);
+
+    if (!Pack::mount(path, baseDir))
+        return false;
+
+    SetLoadFileDataCallback(loadPackedFileData);
+    SetLoadFileTextCallback(loadPackedFileText);
+    SetScriptFileOpenCallback(openPackedFile);
+
+    return true;
+}
+
+string readScript(const string &path)
+{
+    const char *data;
+    size_t size;
+
+    if (Pack::find(path, &data, &size))
+        return string(data, size);
+
+    ifstream t(path);
+    stringstream buffer;
+    buffer << t.rdbuf();
+
+    return buffer.str();
+}
+
+bool saveScript(TextEditor &editor)
+{
+    string path = baseDir + "/" + editorScript;
+
+    ofstream out(path);
+    editor.WriteText(out);
+    out.close();
+
+    if (out.fail())
+    {
+        Log::write(Console::LEVEL_ERROR, "Failed to save " + path + ".");
+        return false;
+    }
+
+    Pack::preferLooseFile(path);
+    editor.MarkSaved();
+
+    return true;
+}
+
+// Loads script into the editor, unless it is already open, and finds the
+// search pattern from the start of line
+void openScript(TextEditor &editor, const string &script, int line)
+{
+    if (script != editorScript)
+    {
+        editorScript = script;
+        editor.SetText(readScript(baseDir + "/" + editorScript));
+    }
 
-    errorMessage.type = msg->type;
-    errorMessage.line = msg->row;
-    errorMessage.column = msg->col;
-    errorMessage.section = msg->section;
-    errorMessage.tracelog.push_back(msg->message);
+    TextEditor::Coordinates lineStart(line, 0);
+    editor.SetSelection(lineStart, lineStart);
+    editor.SetCursorPosition(lineStart);
+    editor.Find(searchPattern, searchCaseSensitive);
 }
 
 void configureEngine(asIScriptEngine *engine)
@@ -155,9 +334,17 @@ void configureEngine(asIScriptEngine *engine)
     r = engine->RegisterObjectProperty("Vector2", "float x", asOFFSET(Api::Vector2, x)); assert(r >= 0);
     r = engine->RegisterObjectProperty("Vector2", "float y", asOFFSET(Api::Vector2, y)); assert(r >= 0);
 
-    r = engine->RegisterObjectType("Image", sizeof(Api::Image), asOBJ_VALUE | asOBJ_POD | asGetTypeTraits<Api::Image>()); assert(r >= 0);
+    Api::registerTypedArrays(engine);
+
+    r = engine->RegisterObjectType("Image", 0, asOBJ_REF); assert(r >= 0);
+    r = engine->RegisterObjectBehaviour("Image", asBEHAVE_ADDREF, "void f()", asMETHOD(Api::Image, addRef), asCALL_THISCALL); assert(r >= 0);
+    r = engine->RegisterObjectBehaviour("Image", asBEHAVE_RELEASE, "void f()", asMETHOD(Api::Image, release), asCALL_THISCALL); assert(r >= 0);
+    r = engine->RegisterObjectMethod("Image", "int get_width() const", asMETHOD(Api::Image, getWidth), asCALL_THISCALL); assert(r >= 0);
+    r = engine->RegisterObjectMethod("Image", "int get_height() const", asMETHOD(Api::Image, getHeight), asCALL_THISCALL); assert(r >= 0);
 
     r = engine->RegisterGlobalFunction("void log(string &in)", asFUNCTION(Api::log), asCALL_CDECL); assert(r >= 0);
+    r = engine->RegisterGlobalFunction("void logWarning(string &in)", asFUNCTION(Api::logWarning), asCALL_CDECL); assert(r >= 0);
+    r = engine->RegisterGlobalFunction("void logError(string &in)", asFUNCTION(Api::logError), asCALL_CDECL); assert(r >= 0);
     r = engine->RegisterGlobalFunction("string toString(int)", asFUNCTIONPR(Api::toString, (int), string), asCALL_CDECL); assert(r >= 0);
     r = engine->RegisterGlobalFunction("string toString(float)", asFUNCTIONPR(Api::toString, (float), string), asCALL_CDECL); assert(r >= 0);
     r = engine->RegisterGlobalFunction("string toString(bool)", asFUNCTIONPR(Api::toString, (bool), string), asCALL_CDECL); assert(r >= 0);
@@ -167,8 +354,9 @@ void configureEngine(asIScriptEngine *engine)
 
     r = engine->RegisterGlobalFunction("void print(string &in, int, int)", asFUNCTION(Api::Graphics::print), asCALL_CDECL); assert(r >= 0);
     r = engine->RegisterGlobalFunction("void rectangle(string &in, int, int, int, int)", asFUNCTION(Api::Graphics::rectangle), asCALL_CDECL); assert(r >= 0);
-    r = engine->RegisterGlobalFunction("Image newImage(string &in)", asFUNCTION(Api::Graphics::newImage), asCALL_CDECL); assert(r >= 0);
-    r = engine->RegisterGlobalFunction("void drawImage(Image, int, int)", asFUNCTION(Api::Graphics::drawImage), asCALL_CDECL); assert(r >= 0);
+    r = engine->RegisterGlobalFunction("Image@ newImage(string &in)", asFUNCTION(Api::Graphics::newImage), asCALL_CDECL); assert(r >= 0);
+    r = engine->RegisterGlobalFunction("void drawImage(Image@, int, int)", asFUNCTION(Api::Graphics::drawImage), asCALL_CDECL); assert(r >= 0);
+    r = engine->RegisterGlobalFunction("void setTextureBudget(int, int frames = 120)", asFUNCTION(Api::Graphics::setTextureBudget), asCALL_CDECL); assert(r >= 0);
     r = engine->RegisterGlobalFunction("void point(int, int)", asFUNCTION(Api::Graphics::point), asCALL_CDECL); assert(r >= 0);
 
     r = engine->SetDefaultNamespace("vd::math"); assert(r >= 0);
@@ -253,32 +441,41 @@ void configureEngine(asIScriptEngine *engine)
 
     r = engine->SetDefaultNamespace("vd::timer"); assert(r >= 0);
     r = engine->RegisterGlobalFunction("int getFPS()", asFUNCTION(Api::Timer::getFPS), asCALL_CDECL); assert(r >= 0);
+
+    Api::registerEcs(engine);
+    Api::registerSpatial(engine);
+    Api::registerPhysics(engine);
+    Api::registerNet(engine);
+    Api::registerRollback(engine);
 }
 
-int compileScript(asIScriptEngine *engine, string script)
+int compileScript(Build &build, const string &script)
 {
     int r;
 
-    CScriptBuilder builder;
+    CScriptBuilder &builder = build.builder;
 
-    r = builder.StartNewModule(engine, 0);
+    r = builder.StartNewModule(build.engine, 0);
     if (r < 0)
     {
-        errorHandler("Failed to start new module.");
+        build.failure = "Failed to start new module.";
         return r;
     }
 
-    r = builder.AddSectionFromFile(script.c_str());
+    if (Pack::isMounted())
+        builder.SetIncludeCallback(Pack::includeCallback, 0);
+
+    r = Pack::addSection(builder, script);
     if (r < 0)
     {
-        errorHandler("Failed to add script file.");
+        build.failure = "Failed to add script file.";
         return r;
     }
 
     r = builder.BuildModule();
     if (r < 0)
     {
-        errorHandler("Failed to build the module.");
+        build.failure = "Failed to build the module.";
         return r;
     }
 
@@ -323,27 +520,44 @@ int callFunction(asIScriptContext *ctx, asIScriptFunction *function)
     return 0;
 }
 
-void reload()
+// Creates an engine and compiles the script into it. Nothing global is
+// touched, so this runs on the build thread while the old game keeps going.
+bool buildScript(Build &build, const string &script)
 {
-    int r;
-
-    engine = asCreateScriptEngine();
-    if (engine == 0)
+    build.engine = asCreateScriptEngine();
+    if (build.engine == 0)
     {
-        errorHandler("Failed to create script engine.");
-        return;
+        build.failure = "Failed to create script engine.";
+        return false;
     }
 
-    engine->SetMessageCallback(asFUNCTION(messageCallback), 0, asCALL_CDECL);
+    build.engine->SetMessageCallback(asFUNCTION(messageCallback), &build.error, asCALL_CDECL);
 
-    configureEngine(engine);
+    configureEngine(build.engine);
 
-    r = compileScript(engine, baseDir + "/main.as");
-    if (r < 0)
+    return compileScript(build, script) >= 0;
+}
+
+// Makes a finished build the running game and calls its init
+void initScript(Build &build)
+{
+    int r;
+
+    engine = build.engine;
+    ctx = 0;
+    errorMessage = build.error;
+
+    if (!build.failure.empty())
     {
+        errorHandler(build.failure);
         return;
     }
 
+    engine->SetMessageCallback(asFUNCTION(messageCallback), &errorMessage, asCALL_CDECL);
+
+    Api::Ecs::loadComponents(engine->GetModule(0), build.builder);
+    Api::Rollback::loadGlobals(engine->GetModule(0), build.builder);
+
     ctx = engine->CreateContext();
     if (ctx == 0)
     {
@@ -394,23 +608,534 @@ void reload()
     error = false;
 }
 
-int main()
+asIScriptFunction **entryPoints[] = { &initFunc, &updateFunc, &drawFunc, &filesdroppedFunc, &focusFunc, &resizeFunc, &keypressedFunc, &textinputFunc };
+const int entryPointCount = sizeof(entryPoints) / sizeof(entryPoints[0]);
+
+// Replaces the running game with a finished build. The old game is only shut
+// down once the new init has succeeded, otherwise it is put back and false is
+// returned with the errors left in build.
+bool startScript(Build &build)
+{
+    bool replacing = !error && engine != 0;
+
+    if (!replacing)
+    {
+        initScript(build);
+        return !error;
+    }
+
+    asIScriptEngine *oldEngine = engine;
+    asIScriptContext *oldCtx = ctx;
+    asIScriptFunction *oldEntryPoints[entryPointCount];
+    Error oldErrorMessage = errorMessage;
+
+    for (int i = 0; i < entryPointCount; i++)
+        oldEntryPoints[i] = *entryPoints[i];
+
+    Api::Ecs::State *oldEntities = Api::Ecs::setAside();
+    Api::Rollback::State *oldGlobals = Api::Rollback::setAside();
+
+    initScript(build);
+
+    if (!error)
+    {
+        oldCtx->Release();
+        oldEngine->ShutDownAndRelease();
+        Api::Ecs::discard(oldEntities);
+        Api::Rollback::discard(oldGlobals);
+        return true;
+    }
+
+    // errorHandler has already released the new engine
+    build.error = errorMessage;
+    build.failure = errorMessage.message;
+
+    engine = oldEngine;
+    ctx = oldCtx;
+    error = false;
+    errorMessage = oldErrorMessage;
+
+    for (int i = 0; i < entryPointCount; i++)
+        *entryPoints[i] = oldEntryPoints[i];
+
+    Api::Ecs::putBack(oldEntities);
+    Api::Rollback::putBack(oldGlobals);
+
+    return false;
+}
+
+void reload()
+{
+    Build build;
+
+    buildScript(build, baseDir + "/" + mainScript);
+    startScript(build);
+}
+
+Build *pendingBuild = 0;
+thread buildThread;
+atomic<bool> buildDone(false);
+bool buildFailed = false;
+Error buildError;
+
+void runBuild(Build *build, string script)
+{
+    buildScript(*build, script);
+
+    // Frees the context AngelScript keeps for this thread
+    asThreadCleanup();
+
+    buildDone = true;
+}
+
+// Compiles on the build thread, finishBuild swaps the result in
+void startBuild()
+{
+    if (pendingBuild)
+        return;
+
+    pendingBuild = new Build();
+    buildDone = false;
+    buildThread = thread(runBuild, pendingBuild, baseDir + "/" + mainScript);
+}
+
+bool isBuilding()
+{
+    return pendingBuild != 0;
+}
+
+// Called between frames. A build that fails to compile or whose init fails
+// is dropped and the game that was running keeps going, its errors are kept
+// for the editor instead.
+bool finishBuild()
+{
+    if (pendingBuild == 0 || !buildDone)
+        return false;
+
+    buildThread.join();
+
+    Build *build = pendingBuild;
+    pendingBuild = 0;
+
+    buildFailed = !build->failure.empty();
+
+    if (buildFailed)
+    {
+        if (build->engine)
+            build->engine->ShutDownAndRelease();
+    }
+    else
+        buildFailed = !startScript(*build);
+
+    if (buildFailed)
+    {
+        buildError = build->error;
+        buildError.message = build->failure;
+    }
+
+    delete build;
+
+    return true;
+}
+
+void runUpdate(float dt)
+{
+    if (error)
+        return;
+
+    int r = ctx->Prepare(updateFunc);
+    if (r < 0)
+    {
+        errorHandler("Failed to prepare the context.");
+        return;
+    }
+
+    ctx->SetArgFloat(0, dt);
+
+    Api::Net::poll();
+    callFunction(ctx, updateFunc);
+    Api::Net::flush();
+}
+
+void runDraw()
+{
+    Api::Graphics::updateTextures();
+
+    if (error)
+        return;
+
+    int r = ctx->Prepare(drawFunc);
+    if (r < 0)
+    {
+        errorHandler("Failed to prepare the context.\n");
+        return;
+    }
+
+    callFunction(ctx, drawFunc);
+}
+
+// Stretches the part of the target rendered this frame over the window,
+// the target is upside down so the viewport sits at its bottom
+void presentTarget(RenderTexture &target)
+{
+    float width = (float)Resolution::width();
+    float height = (float)Resolution::height();
+    float viewportWidth = (float)Resolution::viewportWidth();
+    float viewportHeight = (float)Resolution::viewportHeight();
+
+    float scale = MIN((float)GetScreenWidth()/width, (float)GetScreenHeight()/height);
+
+    DrawTexturePro(target.texture, (Rectangle){ 0.0f, (float)target.texture.height - viewportHeight, viewportWidth, -viewportHeight },
+                   (Rectangle){ (GetScreenWidth() - (width*scale))*0.5f, (GetScreenHeight() - (height*scale))*0.5f,
+                   width*scale, height*scale }, (Vector2){ 0, 0 }, 0.0f, WHITE);
+}
+
+struct BenchOptions
+{
+    string dir = "bench";
+    string scene;
+    string out;
+    string baseline;
+    int frames = 600;
+    int warmup = 60;
+    double threshold = 0.10;
+};
+
+int runBenchmark(const BenchOptions &options, RenderTexture &target)
+{
+    vector<string> scenes;
+
+    if (!options.scene.empty())
+    {
+        scenes.push_back(options.scene);
+    }
+    else
+    {
+        FilePathList files = LoadDirectoryFilesEx(options.dir.c_str(), ".as", false);
+
+        for (unsigned int i = 0; i < files.count; i++)
+            scenes.push_back(GetFileNameWithoutExt(files.paths[i]));
+
+        UnloadDirectoryFiles(files);
+
+        sort(scenes.begin(), scenes.end());
+    }
+
+    if (scenes.empty())
+    {
+        printf("No benchmark scenes found in %s.\n", options.dir.c_str());
+        return 1;
+    }
+
+    // Every scene sees the same seed and a fixed timestep so runs are comparable.
+    const float dt = 1.0f / REFRESH_RATE;
+
+    vector<Bench::Scene> results;
+
+    baseDir = options.dir;
+
+    for (auto &name : scenes)
+    {
+        Bench::Scene scene;
+        scene.name = name;
+        scene.failed = false;
+
+        printf("Running %s...\n", name.c_str());
+
+        mainScript = name + ".as";
+        errorMessage = Error();
+        SetRandomSeed(1234);
+
+        reload();
+
+        for (int i = 0; i < options.warmup + options.frames && !error && !WindowShouldClose(); i++)
+        {
+            double start = GetTime();
+
+            runUpdate(dt);
+
+            double updated = GetTime();
+
+            BeginDrawing();
+            ClearBackground(BLACK);
+            BeginTextureMode(target);
+            ClearBackground(BLACK);
+            Resolution::begin();
+
+            runDraw();
+
+            Resolution::end();
+            EndTextureMode();
+
+            double drawn = GetTime();
+
+            presentTarget(target);
+            EndDrawing();
+
+            double presented = GetTime();
+
+            if (i < options.warmup)
+                continue;
+
+            scene.frame.push_back((presented - start) * 1000.0);
+            scene.update.push_back((updated - start) * 1000.0);
+            scene.draw.push_back((drawn - updated) * 1000.0);
+            scene.present.push_back((presented - drawn) * 1000.0);
+        }
+
+        if (error || (int)scene.frame.size() < options.frames)
+        {
+            printf("Scene %s failed: %s\n", name.c_str(), errorMessage.message.c_str());
+            scene.failed = true;
+        }
+
+        if (!error)
+        {
+            ctx->Release();
+            engine->ShutDownAndRelease();
+        }
+
+        ctx = 0;
+        engine = 0;
+
+        results.push_back(scene);
+    }
+
+    Bench::writeJson(options.out, results, options.frames, options.warmup);
+
+    if (!options.baseline.empty())
+    {
+        int regressions = Bench::compare(results, options.baseline, options.threshold);
+
+        if (regressions < 0)
+            return 1;
+
+        if (regressions > 0)
+        {
+            printf("%d regression(s) against %s.\n", regressions, options.baseline.c_str());
+            return 1;
+        }
+    }
+
+    for (auto &scene : results)
+    {
+        if (scene.failed)
+            return 1;
+    }
+
+    return 0;
+}
+
+// Seconds to colorize the whole of text from scratch, best of several runs
+double timeColorizer(const TextEditor::LanguageDefinition &language, const string &text, int runs)
+{
+    TextEditor editor;
+    editor.SetLanguageDefinition(language);
+
+    double best = 0.0;
+
+    for (int i = 0; i < runs; i++)
+    {
+        editor.SetText(text);
+
+        auto start = chrono::steady_clock::now();
+        editor.ColorizeAll();
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        if (i == 0 || elapsed < best)
+            best = elapsed;
+    }
+
+    return best;
+}
+
+int runColorizerBenchmark(const string &path, int runs)
+{
+    string text = readScript(path);
+
+    if (text.empty())
+    {
+        printf("Failed to read %s.\n", path.c_str());
+        return 1;
+    }
+
+    int lines = (int)count(text.begin(), text.end(), '\n') + 1;
+
+    // Same language with the tokenizer cleared falls back to the regular expressions
+    TextEditor::LanguageDefinition regex = TextEditor::LanguageDefinition::AngelScript();
+    regex.mTokenize = nullptr;
+
+    double regexTime = timeColorizer(regex, text, runs);
+    double tokenizerTime = timeColorizer(TextEditor::LanguageDefinition::AngelScript(), text, runs);
+
+    printf("Colorized %d lines of %s, best of %d runs.\n", lines, path.c_str(), runs);
+    printf("%-10s %12.0f lines/s\n", "regex", lines / MAX(regexTime, 1e-9));
+    printf("%-10s %12.0f lines/s\n", "tokenizer", lines / MAX(tokenizerTime, 1e-9));
+    printf("Speedup: %.1fx\n", regexTime / MAX(tokenizerTime, 1e-9));
+
+    return 0;
+}
+
+void printUsage(const char *program)
+{
+    printf("Usage: %s [options] [game directory | pack.vpak]\n", program);
+    printf("  --bench [dir]               Run the benchmark scenes in dir (default bench)\n");
+    printf("  --scene <name>              Only benchmark the named scene\n");
+    printf("  --frames <n>                Frames measured per scene\n");
+    printf("  --warmup <n>                Frames run before measuring\n");
+    printf("  --out <file>                Write benchmark results as json\n");
+    printf("  --baseline <file>           Compare benchmark results against a baseline\n");
+    printf("  --threshold <percent>       Allowed regression against the baseline\n");
+    printf("  --record <file>             Record input to a replay file\n");
+    printf("  --replay <file>             Play back a recorded replay\n");
+    printf("  --resolution <WxH>          Internal resolution of the game\n");
+    printf("  --dynamic-resolution <ms>   Scale the resolution to keep frames under a budget\n");
+    printf("  --fps <n>                   Frame rate cap, 0 for uncapped\n");
+    printf("  --background <policy>       run, throttle or pause while in the background\n");
+    printf("  --bench-colorizer <file>    Time the editor colorizer on a file\n");
+    printf("  --pack <dir> <file>         Build a pack from a directory\n");
+}
+
+int main(int argc, char **argv)
 {
     int r;
 
+    bool bench = false;
+    BenchOptions benchOptions;
+    string recordPath;
+    string replayPath;
+    int width = 800;
+    int height = 600;
+    double resolutionBudget = 0.0;
+    int fps = REFRESH_RATE;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+
+        if (strcmp(argv[i], "--bench") == 0)
+        {
+            bench = true;
+
+            if (hasValue && argv[i + 1][0] != '-')
+                benchOptions.dir = argv[++i];
+        }
+        else if (strcmp(argv[i], "--scene") == 0 && hasValue)
+            benchOptions.scene = argv[++i];
+        else if (strcmp(argv[i], "--frames") == 0 && hasValue)
+            benchOptions.frames = MAX(atoi(argv[++i]), 1);
+        else if (strcmp(argv[i], "--warmup") == 0 && hasValue)
+            benchOptions.warmup = MAX(atoi(argv[++i]), 0);
+        else if (strcmp(argv[i], "--out") == 0 && hasValue)
+            benchOptions.out = argv[++i];
+        else if (strcmp(argv[i], "--baseline") == 0 && hasValue)
+            benchOptions.baseline = argv[++i];
+        else if (strcmp(argv[i], "--threshold") == 0 && hasValue)
+            benchOptions.threshold = atof(argv[++i]) / 100.0;
+        else if (strcmp(argv[i], "--record") == 0 && hasValue)
+            recordPath = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && hasValue)
+            replayPath = argv[++i];
+        else if (strcmp(argv[i], "--resolution") == 0 && hasValue)
+        {
+            if (sscanf(argv[++i], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0)
+            {
+                printf("Invalid resolution %s, expected WIDTHxHEIGHT.\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--fps") == 0 && hasValue)
+            fps = MAX(atoi(argv[++i]), 0);
+        else if (strcmp(argv[i], "--background") == 0 && hasValue)
+        {
+            const char *policy = argv[++i];
+
+            if (strcmp(policy, "run") == 0)
+                background = BACKGROUND_RUN;
+            else if (strcmp(policy, "throttle") == 0)
+                background = BACKGROUND_THROTTLE;
+            else if (strcmp(policy, "pause") == 0)
+                background = BACKGROUND_PAUSE;
+            else
+            {
+                printf("Invalid background policy %s, expected run, throttle or pause.\n", policy);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--dynamic-resolution") == 0 && hasValue)
+            resolutionBudget = atof(argv[++i]);
+        else if (strcmp(argv[i], "--bench-colorizer") == 0 && hasValue)
+            return runColorizerBenchmark(argv[i + 1], 10);
+        else if (strcmp(argv[i], "--pack") == 0 && i + 2 < argc)
+        {
+            bool ok = Pack::build(argv[i + 1], argv[i + 2]);
+
+            return ok ? 0 : 1;
+        }
+        else if (strlen(argv[i]) > 5 && strcmp(argv[i] + strlen(argv[i]) - 5, ".vpak") == 0)
+        {
+            if (!mountPack(argv[i]))
+                return 1;
+        }
+        else if (argv[i][0] != '-')
+            baseDir = argv[i];
+        else
+        {
+            printf("Unknown option %s.\n", argv[i]);
+            printUsage(argv[0]);
+
+            return 1;
+        }
+    }
+
     SetTraceLogLevel(LOG_NONE);
     SetConfigFlags(FLAG_WINDOW_RESIZABLE);
     InitWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "Void by Vinny Horgan");
     SetWindowMinSize(WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2);
-    // SetTargetFPS(REFRESH_RATE);
     SetExitKey(KEY_NULL);
 
-    SetRandomSeed((unsigned) time(NULL));
+    Resolution::init(width, height);
+
+    RenderTexture target = LoadRenderTexture(width, height);
+    SetTextureFilter(target.texture, TEXTURE_FILTER_POINT);
+
+    if (bench)
+    {
+        int result = runBenchmark(benchOptions, target);
+
+        UnloadRenderTexture(target);
+        CloseWindow();
+
+        return result;
+    }
+
+    Resolution::setDynamic(resolutionBudget);
+
+    // Replays run as fast as they can
+    Pacer::start(replayPath.empty() ? fps : 0);
+
+    unsigned int seed = (unsigned) time(NULL);
+
+    if (!replayPath.empty() && !Input::startReplay(replayPath, seed))
+    {
+        UnloadRenderTexture(target);
+        CloseWindow();
+
+        return 1;
+    }
+
+    if (!recordPath.empty())
+        Input::startRecording(recordPath, seed);
+
+    Log::start("void.log");
+
+    SetRandomSeed(seed);
+
+    asPrepareMultithread();
 
     reload();
 
-    RenderTexture target = LoadRenderTexture(WIDTH, HEIGHT);
-    SetTextureFilter(target.texture, TEXTURE_FILTER_POINT);
+    double replayStart = GetTime();
 
     rlImGuiSetup(true);
 
@@ -422,149 +1147,223 @@ int main()
     auto lang = TextEditor::LanguageDefinition::AngelScript();
     editor.SetLanguageDefinition(lang);
 
-    ifstream t(baseDir + "/main.as");
-    stringstream buffer;
-    buffer << t.rdbuf();
+    editorScript = mainScript;
+    editor.SetText(readScript(baseDir + "/" + editorScript));
 
-    editor.SetText(buffer.str());
+    double lastTick = GetTime();
 
     while (!WindowShouldClose())
     {
-        float scale = MIN((float)GetScreenWidth()/WIDTH, (float)GetScreenHeight()/HEIGHT);
-
-        Vector2 mouse = GetMousePosition();
-        virtualMouse.x = (mouse.x - (GetScreenWidth() - (WIDTH*scale))*0.5f)/scale;
-        virtualMouse.y = (mouse.y - (GetScreenHeight() - (HEIGHT*scale))*0.5f)/scale;
-        virtualMouse = Vector2Clamp(virtualMouse, (Vector2){ 0, 0 }, (Vector2){ (float)WIDTH, (float)HEIGHT });
-
-        float dt = GetFrameTime();
+        bool rebuilt = finishBuild();
 
-        if (!error)
+        if (rebuilt)
         {
-            r = ctx->Prepare(updateFunc);
-            if (r < 0)
+            TextEditor::ErrorMarkers markers;
+
+            if (buildFailed && buildError.line > 0 && buildError.section.size() >= editorScript.size() &&
+                buildError.section.compare(buildError.section.size() - editorScript.size(), editorScript.size(), editorScript) == 0)
             {
-                errorHandler("Failed to prepare the context.");
+                markers[buildError.line] = buildError.tracelog.empty() ? buildError.message : buildError.tracelog.back();
             }
-            else
-            {
-                ctx->SetArgFloat(0, dt);
 
-                callFunction(ctx, updateFunc);
-            }
+            editor.SetErrorMarkers(markers);
         }
 
-        if (IsFileDropped())
+        // The window being minimized or hidden isn't part of the recording,
+        // but the frames it skips are never written so replays still match
+        bool minimized = IsWindowMinimized() || IsWindowHidden();
+        bool windowFocused = IsWindowFocused() && !minimized;
+        bool idle = !windowFocused || (mode == MODE_DEV && editorFocused);
+
+        // Replays run uncapped even in the background
+        int frameRate = Input::isReplaying() ? 0 : windowFocused ? fps : BACKGROUND_RATE;
+        Pacer::setFps(frameRate);
+
+        // Paced frames land either side of the throttle interval, so half a
+        // frame of slack keeps them from skipping every other tick. At the
+        // background rate itself this means every frame ticks.
+        float throttleInterval = 1.0f / BACKGROUND_RATE - (frameRate > 0 ? 0.5f / frameRate : 0.0f);
+
+        // Timed here rather than with GetFrameTime, minimized frames don't draw.
+        // lastTick is set from the same reading, so the time spent ticking
+        // counts towards the next interval instead of being lost.
+        double now = GetTime();
+        float tickTime = (float)(now - lastTick);
+
+        // Idle frames only tick at the background rate or not at all, but
+        // focus changes, resizes and a new build always get through
+        bool tick = Input::isReplaying() || !idle || background == BACKGROUND_RUN ||
+            (background == BACKGROUND_THROTTLE && tickTime >= throttleInterval) ||
+            IsWindowFocused() != focus || IsWindowResized() || rebuilt;
+
+        double updateTime = 0.0;
+
+        if (tick)
         {
-            FilePathList files = LoadDroppedFiles();
+            lastTick = now;
+
+            Vector2 mouse = Resolution::toVirtual(GetMousePosition(), GetScreenWidth(), GetScreenHeight());
 
-            if (filesdroppedFunc != 0)
+            Input::Frame input;
+
+            if (Input::isReplaying())
             {
-                r = ctx->Prepare(filesdroppedFunc);
-                if (r < 0)
+                if (!Input::readFrame(input))
                 {
-                    errorHandler("Failed to prepare the context.");
+                    double elapsed = GetTime() - replayStart;
+                    unsigned int frames = Input::current().frame + 1;
+
+                    printf("Replay finished: %u frames in %.3f s (%.1f fps)\n", frames, elapsed, frames / MAX(elapsed, 0.000001));
+
+                    if (Input::hasDiverged())
+                        printf("Replay diverged from the recording at frame %u.\n", Input::getDivergedFrame());
+
+                    break;
                 }
-                else
-                {
-                    CScriptArray *array = CScriptArray::Create(engine->GetTypeInfoByDecl("array<string>"), files.count);
+            }
+            else
+            {
+                Input::capture(input, mouse, MIN(tickTime, MAX_DT));
+                Input::writeFrame(input);
+            }
+
+            Input::setFrame(input);
+            Log::setFrame(input.frame);
+
+            virtualMouse = input.mouse;
 
-                    for (unsigned int i = 0; i < files.count; i++)
+            float dt = input.dt;
+
+            double updateStart = GetTime();
+
+            runUpdate(dt);
+
+            updateTime = GetTime() - updateStart;
+
+            if (!Input::isReplaying() && IsFileDropped())
+            {
+                FilePathList files = LoadDroppedFiles();
+
+                if (filesdroppedFunc != 0)
+                {
+                    r = ctx->Prepare(filesdroppedFunc);
+                    if (r < 0)
                     {
-                        string filename = files.paths[i];
-                        array->SetValue(i, &filename);
+                        errorHandler("Failed to prepare the context.");
                     }
+                    else
+                    {
+                        CScriptArray *array = CScriptArray::Create(engine->GetTypeInfoByDecl("array<string>"), files.count);
+
+                        for (unsigned int i = 0; i < files.count; i++)
+                        {
+                            string filename = files.paths[i];
+                            array->SetValue(i, &filename);
+                        }
 
-                    ctx->SetArgObject(0, array);
+                        ctx->SetArgObject(0, array);
 
-                    callFunction(ctx, filesdroppedFunc);
+                        callFunction(ctx, filesdroppedFunc);
 
-                    UnloadDroppedFiles(files);
+                        UnloadDroppedFiles(files);
+                    }
                 }
             }
-        }
 
-        if (focus != IsWindowFocused())
-        {
-            focus = IsWindowFocused();
-
-            if (focusFunc != 0)
+            if (focus != input.focus)
             {
-                r = ctx->Prepare(focusFunc);
-                if (r < 0)
-                {
-                    errorHandler("Failed to prepare the context.");
-                }
-                else
+                focus = input.focus;
+
+                if (focusFunc != 0)
                 {
-                    ctx->SetArgByte(0, focus);
+                    r = ctx->Prepare(focusFunc);
+                    if (r < 0)
+                    {
+                        errorHandler("Failed to prepare the context.");
+                    }
+                    else
+                    {
+                        ctx->SetArgByte(0, focus);
 
-                    callFunction(ctx, focusFunc);
+                        callFunction(ctx, focusFunc);
+                    }
                 }
             }
-        }
 
-        if (IsWindowResized())
-        {
-            if (resizeFunc != 0)
+            if (input.resized)
             {
-                r = ctx->Prepare(resizeFunc);
-                if (r < 0)
+                if (resizeFunc != 0)
                 {
-                    errorHandler("Failed to prepare the context.");
-                }
-                else
-                {
-                    ctx->SetArgDWord(0, GetScreenWidth());
-                    ctx->SetArgDWord(1, GetScreenHeight());
+                    r = ctx->Prepare(resizeFunc);
+                    if (r < 0)
+                    {
+                        errorHandler("Failed to prepare the context.");
+                    }
+                    else
+                    {
+                        ctx->SetArgDWord(0, input.width);
+                        ctx->SetArgDWord(1, input.height);
 
-                    callFunction(ctx, resizeFunc);
+                        callFunction(ctx, resizeFunc);
+                    }
                 }
             }
-        }
 
-        int key = GetKeyPressed();
+            int key = input.keyPressed;
 
-        if (key != KEY_NULL)
-        {
-            if (keypressedFunc != 0)
+            if (key != KEY_NULL)
             {
-                r = ctx->Prepare(keypressedFunc);
-                if (r < 0)
-                {
-                    errorHandler("Failed to prepare the context.");
-                }
-                else
+                if (keypressedFunc != 0)
                 {
-                    ctx->SetArgDWord(0, key);
+                    r = ctx->Prepare(keypressedFunc);
+                    if (r < 0)
+                    {
+                        errorHandler("Failed to prepare the context.");
+                    }
+                    else
+                    {
+                        ctx->SetArgDWord(0, key);
 
-                    callFunction(ctx, keypressedFunc);
+                        callFunction(ctx, keypressedFunc);
+                    }
                 }
             }
-        }
 
-        int charPressed = GetCharPressed();
+            int charPressed = input.charPressed;
 
-        if (charPressed != 0)
-        {
-            if (textinputFunc != 0)
+            if (charPressed != 0)
             {
-                r = ctx->Prepare(textinputFunc);
-                if (r < 0)
-                {
-                    errorHandler("Failed to prepare the context.");
-                }
-                else
+                if (textinputFunc != 0)
                 {
-                    string text = string(1, charPressed);
+                    r = ctx->Prepare(textinputFunc);
+                    if (r < 0)
+                    {
+                        errorHandler("Failed to prepare the context.");
+                    }
+                    else
+                    {
+                        string text = string(1, charPressed);
 
-                    ctx->SetArgObject(0, &text);
+                        ctx->SetArgObject(0, &text);
 
-                    callFunction(ctx, textinputFunc);
+                        callFunction(ctx, textinputFunc);
+                    }
                 }
             }
         }
+        else if (!error)
+            Api::Net::poll();
 
+        if (minimized)
+        {
+            Log::update();
+
+            // EndDrawing polls events, with nothing drawn it has to be done here
+            PollInputEvents();
+            Pacer::wait();
+
+            continue;
+        }
 
         if (mode == MODE_DEV && IsKeyPressed(KEY_ESCAPE))
         {
@@ -581,51 +1380,58 @@ int main()
 
         ClearBackground(BLACK);
 
-        BeginTextureMode(target);
+        // Without a tick the game hasn't changed, the last frame is shown again
+        if (tick || error)
+        {
+            double drawStart = GetTime();
 
-        ClearBackground(BLACK);
+            BeginTextureMode(target);
 
-        if (!error)
-        {
-            r = ctx->Prepare(drawFunc);
-            if (r < 0)
+            ClearBackground(BLACK);
+
+            Resolution::begin();
+
+            if (!error)
             {
-                errorHandler("Failed to prepare the context.\n");
+                runDraw();
             }
             else
-                callFunction(ctx, drawFunc);
-        }
-        else
-        {
-            ClearBackground(SKYBLUE);
-            DrawText(errorMessage.message.c_str(), 10, 10, 20, WHITE);
+            {
+                ClearBackground(SKYBLUE);
+                DrawText(errorMessage.message.c_str(), 10, 10, 20, WHITE);
 
-            const char *type = "ERR";
+                const char *type = "ERR";
 
-            if (errorMessage.type == asMSGTYPE_WARNING)
-                type = "WARN";
-            else if (errorMessage.type == asMSGTYPE_INFORMATION)
-                type = "INFO";
+                if (errorMessage.type == asMSGTYPE_WARNING)
+                    type = "WARN";
+                else if (errorMessage.type == asMSGTYPE_INFORMATION)
+                    type = "INFO";
 
-            DrawText(TextFormat("%s (%d, %d) : %s", errorMessage.section.c_str(), errorMessage.line, errorMessage.column, type), 10, 40, 20, WHITE);
+                DrawText(TextFormat("%s (%d, %d) : %s", errorMessage.section.c_str(), errorMessage.line, errorMessage.column, type), 10, 40, 20, WHITE);
 
-            int y = 0;
-            for (auto &i : errorMessage.tracelog)
-            {
-                DrawText(i.c_str(), 10, 70 + y, 20, WHITE);
-                y += 30;
+                int y = 0;
+                for (auto &i : errorMessage.tracelog)
+                {
+                    DrawText(i.c_str(), 10, 70 + y, 20, WHITE);
+                    y += 30;
+                }
             }
-        }
 
-        EndTextureMode();
+            Resolution::end();
+
+            EndTextureMode();
+
+            if (tick && !error)
+                Resolution::update((updateTime + GetTime() - drawStart) * 1000.0);
+        }
 
         if (mode == MODE_RUNTIME)
         {
-            DrawTexturePro(target.texture, (Rectangle){ 0.0f, 0.0f, (float)target.texture.width, (float)-target.texture.height },
-                        (Rectangle){ (GetScreenWidth() - ((float)WIDTH*scale))*0.5f, (GetScreenHeight() - ((float)HEIGHT*scale))*0.5f,
-                        (float)WIDTH*scale, (float)HEIGHT*scale }, (Vector2){ 0, 0 }, 0.0f, WHITE);
+            presentTarget(target);
         }
 
+        Log::update();
+
         rlImGuiBegin();
 
         if (mode == MODE_DEV)
@@ -635,7 +1441,7 @@ int main()
             ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0, 0));
             ImGui::Begin("Viewport", nullptr, ImGuiWindowFlags_None);
 
-            rlImGuiImageRect(&target.texture, target.texture.width, target.texture.height, (Rectangle){ 0.0f, 0.0f, (float)target.texture.width, (float)-target.texture.height});
+            rlImGuiImageRect(&target.texture, Resolution::width(), Resolution::height(), (Rectangle){ 0.0f, 0.0f, (float)Resolution::viewportWidth(), (float)-Resolution::viewportHeight() });
             ImGui::End();
             ImGui::PopStyleVar();
 
@@ -647,41 +1453,211 @@ int main()
                 {
                     if (ImGui::MenuItem("Clear"))
                     {
-                        consoleHistory.clear();
+                        Console::clear();
                     }
 
+                    ImGui::Separator();
+                    ImGui::MenuItem("Info", nullptr, &consoleLevels[Console::LEVEL_INFO]);
+                    ImGui::MenuItem("Warnings", nullptr, &consoleLevels[Console::LEVEL_WARNING]);
+                    ImGui::MenuItem("Errors", nullptr, &consoleLevels[Console::LEVEL_ERROR]);
+
                     ImGui::EndMenu();
                 }
 
                 ImGui::EndMenuBar();
             }
 
-            for (auto& line : consoleHistory)
+            consoleFilter.Draw("Filter", 180);
+
+            ImGui::BeginChild("Lines", ImVec2(0, 0), false, ImGuiWindowFlags_HorizontalScrollbar);
+
+            // Only indices are gathered for a filtered view, the text stays in the console's arena
+            bool filtered = consoleFilter.IsActive() || !consoleLevels[Console::LEVEL_INFO] || !consoleLevels[Console::LEVEL_WARNING] || !consoleLevels[Console::LEVEL_ERROR];
+            int lineCount = Console::count();
+
+            if (filtered)
             {
-                ImGui::TextUnformatted(line.c_str());
+                consoleVisible.clear();
+
+                for (int i = 0; i < lineCount; i++)
+                {
+                    Console::Line line = Console::line(i);
+
+                    if (consoleLevels[line.level] && consoleFilter.PassFilter(line.text, line.text + line.length))
+                        consoleVisible.push_back(i);
+                }
+
+                lineCount = (int)consoleVisible.size();
+            }
+
+            ImGuiListClipper lineClipper;
+            lineClipper.Begin(lineCount);
+
+            while (lineClipper.Step())
+            {
+                for (int i = lineClipper.DisplayStart; i < lineClipper.DisplayEnd; i++)
+                {
+                    Console::Line line = Console::line(filtered ? consoleVisible[i] : i);
+
+                    if (line.level == Console::LEVEL_WARNING)
+                        ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 0.8f, 0.3f, 1.0f));
+                    else if (line.level == Console::LEVEL_ERROR)
+                        ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(1.0f, 0.4f, 0.4f, 1.0f));
+
+                    ImGui::TextUnformatted(line.text, line.text + line.length);
+
+                    if (line.level != Console::LEVEL_INFO)
+                        ImGui::PopStyleColor();
+                }
+            }
+
+            // Follow new output unless scrolled up
+            if (ImGui::GetScrollY() >= ImGui::GetScrollMaxY())
+                ImGui::SetScrollHereY(1.0f);
+
+            ImGui::EndChild();
+            ImGui::End();
+
+            ImGui::Begin("Stats");
+
+            Api::TextureStats textures = Api::Graphics::getTextureStats();
+            ImGui::Text("Textures: %d (%.2f MB)", textures.count, textures.bytes / (1024.0 * 1024.0));
+
+            if (textures.budget > 0)
+                ImGui::Text("Budget: %.2f MB, %d evicted, %d loading", textures.budget / (1024.0 * 1024.0), textures.evicted, textures.pending);
+
+            Pacer::Stats pacing = Pacer::getStats();
+
+            if (Pacer::getFps() > 0)
+                ImGui::Text("Frame: %.2f ms (target %.2f ms), jitter %.3f ms avg, %.3f ms max", pacing.mean, pacing.target, pacing.jitter, pacing.maxJitter);
+            else
+                ImGui::Text("Frame: %.2f ms (uncapped), jitter %.3f ms avg, %.3f ms max", pacing.mean, pacing.jitter, pacing.maxJitter);
+
+            ImGui::Text("Resolution: %dx%d of %dx%d (%.0f%%)%s", Resolution::viewportWidth(), Resolution::viewportHeight(),
+                Resolution::width(), Resolution::height(), Resolution::scale() * 100.0f, Resolution::isDynamic() ? ", dynamic" : "");
+
+            ImGui::End();
+
+            ImGui::Begin("Search");
+
+            if (ImGui::InputText("Find", findText, sizeof(findText), ImGuiInputTextFlags_EnterReturnsTrue))
+                editor.FindNext(findText, findCaseSensitive);
+            else if (ImGui::IsItemEdited() && findText[0] != '\0')
+                editor.Find(findText, findCaseSensitive);
+
+            ImGui::InputText("Replace", replaceText, sizeof(replaceText));
+            ImGui::Checkbox("Match case", &findCaseSensitive);
+
+            if (ImGui::Button("Find next"))
+                editor.FindNext(findText, findCaseSensitive);
+
+            ImGui::SameLine();
+
+            if (ImGui::Button("Replace all"))
+                editor.ReplaceAll(findText, replaceText, findCaseSensitive);
+
+            ImGui::SameLine();
+
+            if (ImGui::Button("Find in files") && findText[0] != '\0')
+            {
+                searchResults.clear();
+                searchPattern = findText;
+                searchCaseSensitive = findCaseSensitive;
+                Search::start(baseDir, searchPattern, searchCaseSensitive);
+            }
+
+            Search::collect(searchResults);
+
+            ImGui::Text("%s%d matches in %d files", Search::isRunning() ? "Searching... " : "", (int)searchResults.size(), Search::filesSearched());
+
+            ImGui::BeginChild("Results");
+
+            ImGuiListClipper resultClipper;
+            resultClipper.Begin((int)searchResults.size());
+
+            while (resultClipper.Step())
+            {
+                for (int i = resultClipper.DisplayStart; i < resultClipper.DisplayEnd; i++)
+                {
+                    auto &match = searchResults[i];
+
+                    ImGui::PushID(i);
+
+                    if (ImGui::Selectable(TextFormat("%s:%d: %s", match.path.c_str(), match.line + 1, match.text.c_str())))
+                    {
+                        // Switching files would throw away unsaved edits, ask first
+                        if (match.path != editorScript && editor.IsModified())
+                        {
+                            pendingScript = match.path;
+                            pendingLine = match.line;
+                        }
+                        else
+                            openScript(editor, match.path, match.line);
+                    }
+
+                    ImGui::PopID();
+                }
+            }
+
+            ImGui::EndChild();
+
+            if (!pendingScript.empty())
+                ImGui::OpenPopup("Unsaved changes");
+
+            if (ImGui::BeginPopupModal("Unsaved changes", nullptr, ImGuiWindowFlags_AlwaysAutoResize))
+            {
+                ImGui::Text("%s has unsaved changes.", editorScript.c_str());
+
+                bool close = false;
+
+                if (ImGui::Button("Save"))
+                {
+                    if (saveScript(editor))
+                        openScript(editor, pendingScript, pendingLine);
+
+                    close = true;
+                }
+
+                ImGui::SameLine();
+
+                if (ImGui::Button("Discard"))
+                {
+                    openScript(editor, pendingScript, pendingLine);
+                    close = true;
+                }
+
+                ImGui::SameLine();
+
+                if (ImGui::Button("Cancel"))
+                    close = true;
+
+                if (close)
+                {
+                    pendingScript.clear();
+                    ImGui::CloseCurrentPopup();
+                }
+
+                ImGui::EndPopup();
             }
 
             ImGui::End();
 
             auto cpos = editor.GetCursorPosition();
             ImGui::Begin("Text Editor", nullptr, ImGuiWindowFlags_HorizontalScrollbar | ImGuiWindowFlags_MenuBar);
+            editorFocused = ImGui::IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows);
             ImGui::SetWindowSize(ImVec2(800, 600), ImGuiCond_FirstUseEver);
             if (ImGui::BeginMenuBar())
             {
                 if (ImGui::BeginMenu("File"))
                 {
-                    if (ImGui::MenuItem("Run"))
+                    if (ImGui::MenuItem("Run", nullptr, nullptr, !isBuilding()))
                     {
-                        reload();
+                        startBuild();
                     }
 
                     if (ImGui::MenuItem("Save"))
                     {
-                        string textToSave = editor.GetText();
-
-                        ofstream out(baseDir + "/main.as");
-                        out << textToSave;
-                        out.close();
+                        saveScript(editor);
                     }
 
                     if (ImGui::MenuItem("Quit", "Alt-F4"))
@@ -744,10 +1720,15 @@ int main()
                 ImGui::EndMenuBar();
             }
 
+            if (isBuilding())
+                ImGui::TextUnformatted("Building...");
+            else if (buildFailed)
+                ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Build failed: %s", buildError.message.c_str());
+
             ImGui::Text("%6d/%-6d %6d lines  | %s | %s | %s | %s", cpos.mLine + 1, cpos.mColumn + 1, editor.GetTotalLines(),
                 editor.IsOverwrite() ? "Ovr" : "Ins",
                 editor.CanUndo() ? "*" : " ",
-                editor.GetLanguageDefinition().mName.c_str(), baseDir.c_str());
+                editor.GetLanguageDefinition().mName.c_str(), (baseDir + "/" + editorScript).c_str());
 
             editor.Render("TextEditor");
             ImGui::End();
@@ -756,6 +1737,19 @@ int main()
         rlImGuiEnd();
 
         EndDrawing();
+
+        Pacer::wait();
+    }
+
+    if (pendingBuild)
+    {
+        buildThread.join();
+
+        if (pendingBuild->engine)
+            pendingBuild->engine->ShutDownAndRelease();
+
+        delete pendingBuild;
+        pendingBuild = 0;
     }
 
     if (!error)
@@ -764,11 +1758,19 @@ int main()
         engine->ShutDownAndRelease();
     }
 
+    asUnprepareMultithread();
+
+    int exitCode = Input::isReplaying() && Input::hasDiverged() ? 1 : 0;
+
+    Input::stop();
+    Search::stop();
+    Log::stop();
+
     rlImGuiShutdown();
 
     UnloadRenderTexture(target);
 
     CloseWindow();
 
-    return 0;
+    return exitCode;
 }
@@ -0,0 +1,617 @@
+#define ENET_IMPLEMENTATION
+#include "enet.h"
+
+#include "net.h"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+static const size_t noMessage = (size_t)-1;
+static const size_t maxMessageLength = 0xffff;
+static const int defaultClientPeers = 8;
+
+static vector<Api::Net::Host *> hosts;
+static bool initialized = false;
+
+static void setException(const char *message)
+{
+    asIScriptContext *ctx = asGetActiveContext();
+
+    if (ctx)
+        ctx->SetException(message);
+}
+
+namespace Api
+{
+    namespace Net
+    {
+        Writer::Writer()
+            : messageStart(noMessage), refCount(1)
+        {
+        }
+
+        void Writer::addRef()
+        {
+            asAtomicInc(refCount);
+        }
+
+        void Writer::release()
+        {
+            if (asAtomicDec(refCount) == 0)
+                delete this;
+        }
+
+        // Values are written in host byte order, every supported target is little endian.
+        void Writer::write(const void *bytes, size_t size)
+        {
+            size_t offset = data.size();
+            data.resize(offset + size);
+            memcpy(data.data() + offset, bytes, size);
+        }
+
+        void Writer::writeInt8(int8_t value) { write(&value, sizeof(value)); }
+        void Writer::writeInt16(int16_t value) { write(&value, sizeof(value)); }
+        void Writer::writeInt32(int32_t value) { write(&value, sizeof(value)); }
+        void Writer::writeUInt8(uint8_t value) { write(&value, sizeof(value)); }
+        void Writer::writeUInt16(uint16_t value) { write(&value, sizeof(value)); }
+        void Writer::writeUInt32(uint32_t value) { write(&value, sizeof(value)); }
+        void Writer::writeFloat(float value) { write(&value, sizeof(value)); }
+        void Writer::writeDouble(double value) { write(&value, sizeof(value)); }
+
+        void Writer::writeBool(bool value)
+        {
+            writeUInt8(value ? 1 : 0);
+        }
+
+        void Writer::writeString(const string &value)
+        {
+            size_t length = value.size();
+
+            while (length >= 0x80)
+            {
+                writeUInt8((uint8_t)((length & 0x7f) | 0x80));
+                length >>= 7;
+            }
+
+            writeUInt8((uint8_t)length);
+            write(value.data(), value.size());
+        }
+
+        asUINT Writer::length() const
+        {
+            return (asUINT)data.size();
+        }
+
+        void Writer::begin()
+        {
+            end();
+
+            messageStart = data.size();
+            data.resize(messageStart + 2);
+        }
+
+        bool Writer::end()
+        {
+            if (messageStart == noMessage)
+                return true;
+
+            size_t length = data.size() - messageStart - 2;
+            bool fits = length <= maxMessageLength;
+
+            if (fits)
+            {
+                uint16_t prefix = (uint16_t)length;
+                memcpy(data.data() + messageStart, &prefix, sizeof(prefix));
+            }
+            else
+                data.resize(messageStart);
+
+            messageStart = noMessage;
+            return fits;
+        }
+
+        Reader::Reader()
+            : current(0), position(0), end(0), refCount(1)
+        {
+        }
+
+        void Reader::addRef()
+        {
+            asAtomicInc(refCount);
+        }
+
+        void Reader::release()
+        {
+            if (asAtomicDec(refCount) == 0)
+                delete this;
+        }
+
+        bool Reader::next()
+        {
+            if (current >= entries.size())
+                return false;
+
+            position = entries[current].offset;
+            end = position + entries[current].length;
+            current++;
+
+            return true;
+        }
+
+        void Reader::rewind()
+        {
+            current = 0;
+            position = 0;
+            end = 0;
+        }
+
+        int Reader::getKind() const
+        {
+            return current > 0 ? entries[current - 1].kind : -1;
+        }
+
+        int Reader::getPeer() const
+        {
+            return current > 0 ? entries[current - 1].peer : -1;
+        }
+
+        int Reader::getChannel() const
+        {
+            return current > 0 ? entries[current - 1].channel : -1;
+        }
+
+        asUINT Reader::remaining() const
+        {
+            return end - position;
+        }
+
+        asUINT Reader::count() const
+        {
+            return (asUINT)entries.size();
+        }
+
+        bool Reader::read(void *bytes, size_t size)
+        {
+            if (end - position < size)
+            {
+                setException("Read past the end of the message");
+                memset(bytes, 0, size);
+                return false;
+            }
+
+            memcpy(bytes, data.data() + position, size);
+            position += (asUINT)size;
+
+            return true;
+        }
+
+        int8_t Reader::readInt8() { int8_t value; read(&value, sizeof(value)); return value; }
+        int16_t Reader::readInt16() { int16_t value; read(&value, sizeof(value)); return value; }
+        int32_t Reader::readInt32() { int32_t value; read(&value, sizeof(value)); return value; }
+        uint8_t Reader::readUInt8() { uint8_t value; read(&value, sizeof(value)); return value; }
+        uint16_t Reader::readUInt16() { uint16_t value; read(&value, sizeof(value)); return value; }
+        uint32_t Reader::readUInt32() { uint32_t value; read(&value, sizeof(value)); return value; }
+        float Reader::readFloat() { float value; read(&value, sizeof(value)); return value; }
+        double Reader::readDouble() { double value; read(&value, sizeof(value)); return value; }
+
+        bool Reader::readBool()
+        {
+            return readUInt8() != 0;
+        }
+
+        string Reader::readString()
+        {
+            size_t length = 0;
+
+            for (int shift = 0; shift < 35; shift += 7)
+            {
+                uint8_t c;
+
+                if (!read(&c, 1))
+                    return string();
+
+                length |= (size_t)(c & 0x7f) << shift;
+
+                if ((c & 0x80) == 0)
+                    break;
+            }
+
+            if (length > end - position)
+            {
+                setException("Read past the end of the message");
+                return string();
+            }
+
+            string value((const char *)data.data() + position, length);
+            position += (asUINT)length;
+
+            return value;
+        }
+
+        void Reader::clear()
+        {
+            data.clear();
+            entries.clear();
+            rewind();
+        }
+
+        void Reader::add(int kind, int peer, int channel, const uint8_t *bytes, asUINT length)
+        {
+            Entry entry = { kind, peer, channel, (asUINT)data.size(), length };
+
+            if (length > 0)
+                data.insert(data.end(), bytes, bytes + length);
+
+            entries.push_back(entry);
+        }
+
+        Host::Host()
+            : host(0), channelCount(0), inbox(new Reader()), refCount(1)
+        {
+            hosts.push_back(this);
+        }
+
+        Host::~Host()
+        {
+            hosts.erase(std::remove(hosts.begin(), hosts.end(), this), hosts.end());
+
+            if (host)
+            {
+                // Let the peers know, instead of leaving them to time out
+                for (size_t i = 0; i < host->peerCount; i++)
+                {
+                    if (host->peers[i].state == ENET_PEER_STATE_CONNECTED)
+                        enet_peer_disconnect_now(&host->peers[i], 0);
+                }
+
+                enet_host_destroy(host);
+            }
+
+            for (Writer *writer : peerFrames)
+            {
+                if (writer)
+                    writer->release();
+            }
+
+            for (Writer *writer : broadcastFrames)
+            {
+                if (writer)
+                    writer->release();
+            }
+
+            inbox->release();
+        }
+
+        Host *Host::create()
+        {
+            if (!initialized)
+            {
+                if (enet_initialize() != 0)
+                {
+                    setException("Failed to initialize networking");
+                    return 0;
+                }
+
+                atexit(enet_deinitialize);
+                initialized = true;
+            }
+
+            return new Host();
+        }
+
+        void Host::addRef()
+        {
+            asAtomicInc(refCount);
+        }
+
+        void Host::release()
+        {
+            if (asAtomicDec(refCount) == 0)
+                delete this;
+        }
+
+        bool Host::open(const void *address, int maxPeers, int channels)
+        {
+            if (host)
+            {
+                setException("The host is already open");
+                return false;
+            }
+
+            channels = max(1, min(channels, (int)ENET_PROTOCOL_MAXIMUM_CHANNEL_COUNT));
+            host = enet_host_create((const ENetAddress *)address, maxPeers, channels, 0, 0);
+
+            if (host == 0)
+                return false;
+
+            channelCount = channels;
+            peerFrames.assign((size_t)maxPeers * channels * 2, 0);
+            broadcastFrames.assign((size_t)channels * 2, 0);
+
+            return true;
+        }
+
+        bool Host::listen(int port, int maxPeers, int channels)
+        {
+            ENetAddress address;
+            memset(&address, 0, sizeof(address));
+            address.host = ENET_HOST_ANY;
+            address.port = (enet_uint16)port;
+
+            return open(&address, maxPeers, channels);
+        }
+
+        int Host::connect(const string &name, int port, int channels)
+        {
+            if (host == 0 && !open(0, defaultClientPeers, channels))
+                return -1;
+
+            ENetAddress address;
+            memset(&address, 0, sizeof(address));
+
+            if (enet_address_set_host(&address, name.c_str()) != 0)
+            {
+                setException("Failed to resolve the address");
+                return -1;
+            }
+
+            address.port = (enet_uint16)port;
+
+            ENetPeer *peer = enet_host_connect(host, &address, channelCount, 0);
+
+            return peer ? (int)(peer - host->peers) : -1;
+        }
+
+        void Host::disconnect(int peer)
+        {
+            if (host == 0 || peer < 0 || peer >= (int)host->peerCount)
+                return;
+
+            enet_peer_disconnect(&host->peers[peer], 0);
+        }
+
+        asUINT Host::peerCount() const
+        {
+            return host ? (asUINT)host->connectedPeers : 0;
+        }
+
+        Writer *Host::frame(vector<Writer *> &frames, size_t index)
+        {
+            if (frames[index] == 0)
+                frames[index] = new Writer();
+
+            Writer *writer = frames[index];
+            writer->begin();
+            writer->addRef();
+
+            return writer;
+        }
+
+        Writer *Host::message(int peer, int channel, bool reliable)
+        {
+            if (host == 0 || peer < 0 || peer >= (int)host->peerCount || channel < 0 || channel >= channelCount)
+            {
+                setException("Invalid peer or channel");
+                return 0;
+            }
+
+            return frame(peerFrames, ((size_t)peer * channelCount + channel) * 2 + (reliable ? 1 : 0));
+        }
+
+        Writer *Host::broadcast(int channel, bool reliable)
+        {
+            if (host == 0 || channel < 0 || channel >= channelCount)
+            {
+                setException("Invalid channel");
+                return 0;
+            }
+
+            return frame(broadcastFrames, (size_t)channel * 2 + (reliable ? 1 : 0));
+        }
+
+        Reader *Host::receive()
+        {
+            inbox->rewind();
+            inbox->addRef();
+
+            return inbox;
+        }
+
+        void Host::dropFrames(int peer)
+        {
+            for (int i = 0; i < channelCount * 2; i++)
+            {
+                Writer *writer = peerFrames[(size_t)peer * channelCount * 2 + i];
+
+                if (writer)
+                {
+                    writer->data.clear();
+                    writer->messageStart = noMessage;
+                }
+            }
+        }
+
+        // Adds to the inbox, it is only emptied by flush once an update has
+        // had the chance to read it
+        void Host::service()
+        {
+            if (host == 0)
+                return;
+
+            ENetEvent event;
+
+            while (enet_host_service(host, &event, 0) > 0)
+            {
+                int peer = (int)(event.peer - host->peers);
+
+                switch (event.type)
+                {
+                    case ENET_EVENT_TYPE_CONNECT:
+                        inbox->add(Connect, peer, 0, 0, 0);
+                        break;
+
+                    case ENET_EVENT_TYPE_DISCONNECT:
+                    case ENET_EVENT_TYPE_DISCONNECT_TIMEOUT:
+                        dropFrames(peer);
+                        inbox->add(Disconnect, peer, 0, 0, 0);
+                        break;
+
+                    case ENET_EVENT_TYPE_RECEIVE:
+                    {
+                        // Split the frame back into the messages it was built from
+                        const uint8_t *bytes = event.packet->data;
+                        size_t size = event.packet->dataLength;
+                        size_t offset = 0;
+
+                        while (offset + 2 <= size)
+                        {
+                            uint16_t length;
+                            memcpy(&length, bytes + offset, sizeof(length));
+                            offset += 2;
+
+                            if (offset + length > size)
+                                break;
+
+                            inbox->add(Message, peer, event.channelID, bytes + offset, length);
+                            offset += length;
+                        }
+
+                        enet_packet_destroy(event.packet);
+                        break;
+                    }
+
+                    default:
+                        break;
+                }
+            }
+        }
+
+        void Host::flush()
+        {
+            if (host == 0)
+                return;
+
+            for (size_t i = 0; i < peerFrames.size(); i++)
+            {
+                Writer *writer = peerFrames[i];
+
+                if (writer == 0 || writer->data.empty())
+                    continue;
+
+                if (!writer->end())
+                    setException("Network message longer than 65535 bytes");
+
+                ENetPeer *peer = &host->peers[i / (channelCount * 2)];
+                int channel = (int)(i / 2) % channelCount;
+
+                if (!writer->data.empty() && peer->state == ENET_PEER_STATE_CONNECTED)
+                {
+                    ENetPacket *packet = enet_packet_create(writer->data.data(), writer->data.size(), (i & 1) ? ENET_PACKET_FLAG_RELIABLE : 0);
+                    enet_peer_send(peer, (enet_uint8)channel, packet);
+                }
+
+                writer->data.clear();
+            }
+
+            for (size_t i = 0; i < broadcastFrames.size(); i++)
+            {
+                Writer *writer = broadcastFrames[i];
+
+                if (writer == 0 || writer->data.empty())
+                    continue;
+
+                if (!writer->end())
+                    setException("Network message longer than 65535 bytes");
+
+                if (!writer->data.empty())
+                {
+                    ENetPacket *packet = enet_packet_create(writer->data.data(), writer->data.size(), (i & 1) ? ENET_PACKET_FLAG_RELIABLE : 0);
+                    enet_host_broadcast(host, (enet_uint8)(i / 2), packet);
+                }
+
+                writer->data.clear();
+            }
+
+            enet_host_flush(host);
+
+            inbox->clear();
+        }
+
+        void poll()
+        {
+            for (size_t i = 0; i < hosts.size(); i++)
+                hosts[i]->service();
+        }
+
+        void flush()
+        {
+            for (size_t i = 0; i < hosts.size(); i++)
+                hosts[i]->flush();
+        }
+    }
+
+    void registerNet(asIScriptEngine *engine)
+    {
+        int r;
+
+        r = engine->SetDefaultNamespace("vd::net"); assert(r >= 0);
+
+        r = engine->RegisterEnum("EventKind"); assert(r >= 0);
+        r = engine->RegisterEnumValue("EventKind", "Connect", Net::Connect); assert(r >= 0);
+        r = engine->RegisterEnumValue("EventKind", "Disconnect", Net::Disconnect); assert(r >= 0);
+        r = engine->RegisterEnumValue("EventKind", "Message", Net::Message); assert(r >= 0);
+
+        r = engine->RegisterObjectType("Writer", 0, asOBJ_REF); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("Writer", asBEHAVE_ADDREF, "void f()", asMETHOD(Net::Writer, addRef), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("Writer", asBEHAVE_RELEASE, "void f()", asMETHOD(Net::Writer, release), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Writer", "void writeInt8(int8)", asMETHOD(Net::Writer, writeInt8), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Writer", "void writeInt16(int16)", asMETHOD(Net::Writer, writeInt16), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Writer", "void writeInt32(int)", asMETHOD(Net::Writer, writeInt32), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Writer", "void writeUInt8(uint8)", asMETHOD(Net::Writer, writeUInt8), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Writer", "void writeUInt16(uint16)", asMETHOD(Net::Writer, writeUInt16), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Writer", "void writeUInt32(uint)", asMETHOD(Net::Writer, writeUInt32), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Writer", "void writeFloat(float)", asMETHOD(Net::Writer, writeFloat), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Writer", "void writeDouble(double)", asMETHOD(Net::Writer, writeDouble), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Writer", "void writeBool(bool)", asMETHOD(Net::Writer, writeBool), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Writer", "void writeString(const string &in)", asMETHOD(Net::Writer, writeString), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Writer", "uint length() const", asMETHOD(Net::Writer, length), asCALL_THISCALL); assert(r >= 0);
+
+        r = engine->RegisterObjectType("Reader", 0, asOBJ_REF); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("Reader", asBEHAVE_ADDREF, "void f()", asMETHOD(Net::Reader, addRef), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("Reader", asBEHAVE_RELEASE, "void f()", asMETHOD(Net::Reader, release), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Reader", "bool next()", asMETHOD(Net::Reader, next), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Reader", "EventKind get_kind() const", asMETHOD(Net::Reader, getKind), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Reader", "int get_peer() const", asMETHOD(Net::Reader, getPeer), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Reader", "int get_channel() const", asMETHOD(Net::Reader, getChannel), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Reader", "uint remaining() const", asMETHOD(Net::Reader, remaining), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Reader", "uint count() const", asMETHOD(Net::Reader, count), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Reader", "int8 readInt8()", asMETHOD(Net::Reader, readInt8), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Reader", "int16 readInt16()", asMETHOD(Net::Reader, readInt16), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Reader", "int readInt32()", asMETHOD(Net::Reader, readInt32), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Reader", "uint8 readUInt8()", asMETHOD(Net::Reader, readUInt8), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Reader", "uint16 readUInt16()", asMETHOD(Net::Reader, readUInt16), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Reader", "uint readUInt32()", asMETHOD(Net::Reader, readUInt32), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Reader", "float readFloat()", asMETHOD(Net::Reader, readFloat), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Reader", "double readDouble()", asMETHOD(Net::Reader, readDouble), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Reader", "bool readBool()", asMETHOD(Net::Reader, readBool), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Reader", "string readString()", asMETHOD(Net::Reader, readString), asCALL_THISCALL); assert(r >= 0);
+
+        r = engine->RegisterObjectType("Host", 0, asOBJ_REF); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("Host", asBEHAVE_FACTORY, "Host@ f()", asFUNCTION(Net::Host::create), asCALL_CDECL); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("Host", asBEHAVE_ADDREF, "void f()", asMETHOD(Net::Host, addRef), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("Host", asBEHAVE_RELEASE, "void f()", asMETHOD(Net::Host, release), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Host", "bool listen(int, int maxPeers = 32, int channels = 2)", asMETHOD(Net::Host, listen), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Host", "int connect(const string &in, int, int channels = 2)", asMETHOD(Net::Host, connect), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Host", "void disconnect(int)", asMETHOD(Net::Host, disconnect), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Host", "uint peerCount() const", asMETHOD(Net::Host, peerCount), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Host", "Writer@ message(int, int channel = 0, bool reliable = true)", asMETHOD(Net::Host, message), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Host", "Writer@ broadcast(int channel = 0, bool reliable = true)", asMETHOD(Net::Host, broadcast), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Host", "Reader@ receive()", asMETHOD(Net::Host, receive), asCALL_THISCALL); assert(r >= 0);
+    }
+}
@@ -0,0 +1,163 @@
+#ifndef NET_H
+#define NET_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "angelscript.h"
+
+using namespace std;
+
+// ENet pulls in the platform socket headers, which clash with raylib on
+// Windows, so only net.cpp includes it.
+struct _ENetHost;
+
+namespace Api
+{
+    namespace Net
+    {
+        enum EventKind
+        {
+            Connect,
+            Disconnect,
+            Message
+        };
+
+        // Appends values straight into an outgoing frame. Each message in a
+        // frame is prefixed with its 16 bit length, patched in when it ends.
+        class Writer
+        {
+        public:
+            Writer();
+
+            void addRef();
+            void release();
+
+            void writeInt8(int8_t value);
+            void writeInt16(int16_t value);
+            void writeInt32(int32_t value);
+            void writeUInt8(uint8_t value);
+            void writeUInt16(uint16_t value);
+            void writeUInt32(uint32_t value);
+            void writeFloat(float value);
+            void writeDouble(double value);
+            void writeBool(bool value);
+            void writeString(const string &value);
+            asUINT length() const;
+
+            void begin();
+            bool end();
+            void write(const void *bytes, size_t size);
+
+            vector<uint8_t> data;
+            size_t messageStart;
+
+        private:
+            int refCount;
+        };
+
+        // All events a host received during one frame, read in order with next().
+        class Reader
+        {
+        public:
+            struct Entry
+            {
+                int kind;
+                int peer;
+                int channel;
+                asUINT offset;
+                asUINT length;
+            };
+
+            Reader();
+
+            void addRef();
+            void release();
+
+            bool next();
+            void rewind();
+            int getKind() const;
+            int getPeer() const;
+            int getChannel() const;
+            asUINT remaining() const;
+            asUINT count() const;
+
+            int8_t readInt8();
+            int16_t readInt16();
+            int32_t readInt32();
+            uint8_t readUInt8();
+            uint16_t readUInt16();
+            uint32_t readUInt32();
+            float readFloat();
+            double readDouble();
+            bool readBool();
+            string readString();
+
+            void clear();
+            void add(int kind, int peer, int channel, const uint8_t *bytes, asUINT length);
+
+        private:
+            bool read(void *bytes, size_t size);
+
+            vector<uint8_t> data;
+            vector<Entry> entries;
+            size_t current;
+            asUINT position;
+            asUINT end;
+
+            int refCount;
+        };
+
+        class Host
+        {
+        public:
+            Host();
+            ~Host();
+
+            static Host *create();
+
+            void addRef();
+            void release();
+
+            bool listen(int port, int maxPeers, int channels);
+            int connect(const string &address, int port, int channels);
+            void disconnect(int peer);
+            asUINT peerCount() const;
+
+            Writer *message(int peer, int channel, bool reliable);
+            Writer *broadcast(int channel, bool reliable);
+            Reader *receive();
+
+            void service();
+            void flush();
+
+        private:
+            bool open(const void *address, int maxPeers, int channels);
+            Writer *frame(vector<Writer *> &frames, size_t index);
+            void dropFrames(int peer);
+
+            _ENetHost *host;
+            int channelCount;
+
+            // Outgoing frames, one per peer, channel and reliability
+            vector<Writer *> peerFrames;
+            vector<Writer *> broadcastFrames;
+
+            Reader *inbox;
+
+            int refCount;
+        };
+
+        // Called from the main loop around update: poll services every host
+        // without blocking, flush sends the frames built during the update
+        // and empties the inboxes. Frames that don't update still poll, so
+        // connections stay alive and events wait for the next update.
+        void poll();
+        void flush();
+    }
+
+    void registerNet(asIScriptEngine *engine);
+}
+
+#endif
@@ -0,0 +1,148 @@
+#include "pacer.h"
+
+#include <cmath>
+#include <chrono>
+#include <thread>
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+// Frames the reported stats are taken over
+static const int sampleCount = 120;
+
+// Sleeps are never shorter than this, anything less is spun
+static const double sleepStep = 1.0;
+
+static int fps = 0;
+static double period = 0.0;
+static Clock::time_point deadline;
+static Clock::time_point lastFrame;
+static bool started = false;
+
+// How quickly the sleep estimate follows changes in the scheduler
+static const double sleepWeight = 0.05;
+
+// Running estimate of how long a sleepStep sleep really takes, kept as a
+// mean and variance so a noisy scheduler gets a wider spin margin
+static double sleepMean = sleepStep;
+static double sleepVariance = 0.0;
+
+static double samples[sampleCount];
+static int sampleIndex = 0;
+static int sampled = 0;
+
+static double milliseconds(Clock::duration duration)
+{
+    return chrono::duration<double, milli>(duration).count();
+}
+
+static void sleepUntil(Clock::time_point target)
+{
+    for (;;)
+    {
+        double remaining = milliseconds(target - Clock::now());
+        double estimate = sleepMean + sqrt(sleepVariance);
+
+        if (remaining <= estimate)
+            break;
+
+        Clock::time_point before = Clock::now();
+        this_thread::sleep_for(chrono::duration<double, milli>(sleepStep));
+        double slept = milliseconds(Clock::now() - before);
+
+        double delta = slept - sleepMean;
+        sleepMean += sleepWeight * delta;
+        sleepVariance = (1.0 - sleepWeight) * (sleepVariance + sleepWeight * delta * delta);
+    }
+
+    while (Clock::now() < target)
+        ;
+}
+
+namespace Pacer
+{
+    void start(int value)
+    {
+        setFps(value);
+        started = false;
+        sampled = 0;
+    }
+
+    void setFps(int value)
+    {
+        fps = value > 0 ? value : 0;
+        period = fps > 0 ? 1000.0 / fps : 0.0;
+    }
+
+    int getFps()
+    {
+        return fps;
+    }
+
+    void wait()
+    {
+        Clock::time_point now = Clock::now();
+
+        if (!started)
+        {
+            started = true;
+            deadline = now;
+            lastFrame = now;
+
+            return;
+        }
+
+        if (period > 0.0)
+        {
+            deadline += chrono::duration_cast<Clock::duration>(chrono::duration<double, milli>(period));
+
+            // Far behind, after a hitch or a breakpoint, start again from now
+            // instead of rushing through frames to catch up
+            if (now > deadline + chrono::duration_cast<Clock::duration>(chrono::duration<double, milli>(period)))
+                deadline = now;
+            else
+                sleepUntil(deadline);
+
+            now = Clock::now();
+        }
+
+        samples[sampleIndex] = milliseconds(now - lastFrame);
+        sampleIndex = (sampleIndex + 1) % sampleCount;
+
+        if (sampled < sampleCount)
+            sampled++;
+
+        lastFrame = now;
+    }
+
+    Stats getStats()
+    {
+        Stats stats = { period, 0.0, 0.0, 0.0 };
+
+        if (sampled == 0)
+            return stats;
+
+        for (int i = 0; i < sampled; i++)
+            stats.mean += samples[i];
+
+        stats.mean /= sampled;
+
+        // With no cap the distance is measured from the mean frame time instead
+        double target = period > 0.0 ? period : stats.mean;
+
+        for (int i = 0; i < sampled; i++)
+        {
+            double distance = fabs(samples[i] - target);
+
+            stats.jitter += distance;
+
+            if (distance > stats.maxJitter)
+                stats.maxJitter = distance;
+        }
+
+        stats.jitter /= sampled;
+
+        return stats;
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef PACER_H
+#define PACER_H
+
+// Caps the main loop to a target frame rate. Most of the time left in a
+// frame is slept away and the last part, which the OS scheduler can't be
+// trusted with, is spun on a high resolution clock.
+namespace Pacer
+{
+    struct Stats
+    {
+        double target;
+        double mean;
+        double jitter;
+        double maxJitter;
+    };
+
+    // fps of 0 leaves the loop uncapped
+    void start(int fps);
+
+    // Changes the rate without restarting, the next frame is already paced by it
+    void setFps(int fps);
+    int getFps();
+
+    // Called once at the end of every frame, returns once the frame is due
+    void wait();
+
+    // Frame times and their distance from the target in ms over recent frames
+    Stats getStats();
+}
+
+#endif
@@ -0,0 +1,470 @@
+#include "pack.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <dirent.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+using namespace std;
+
+static const char magic[4] = { 'V', 'P', 'A', 'K' };
+static const uint32_t formatVersion = 1;
+static const uint32_t alignment = 16;
+
+struct Header
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t alignment;
+};
+
+struct Entry
+{
+    uint32_t pathOffset;
+    uint32_t pathLength;
+    uint64_t offset;
+    uint64_t size;
+};
+
+static const char *base = 0;
+static size_t baseSize = 0;
+static const Entry *entries = 0;
+static uint32_t entryCount = 0;
+static const char *paths = 0;
+static string root;
+
+// Normalized paths relative to root. Scripts are looked up from the build
+// thread while the editor adds to this, hence the lock
+static vector<string> looseFiles;
+static mutex looseFilesMutex;
+
+#if defined(_WIN32)
+static HANDLE fileHandle = INVALID_HANDLE_VALUE;
+static HANDLE mappingHandle = 0;
+#endif
+
+// Turns backslashes into slashes and drops empty, "." and ".." segments
+static string normalize(const string &path)
+{
+    vector<string> segments;
+    size_t start = 0;
+
+    while (start <= path.size())
+    {
+        size_t end = path.find_first_of("/\\", start);
+
+        if (end == string::npos)
+            end = path.size();
+
+        string segment = path.substr(start, end - start);
+
+        if (segment == "..")
+        {
+            if (!segments.empty() && segments.back() != "..")
+                segments.pop_back();
+            else
+                segments.push_back(segment);
+        }
+        else if (!segment.empty() && segment != ".")
+            segments.push_back(segment);
+
+        start = end + 1;
+    }
+
+    string result;
+
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+        if (i > 0)
+            result += '/';
+
+        result += segments[i];
+    }
+
+    return result;
+}
+
+static const Entry *lookup(const string &path)
+{
+    size_t lo = 0;
+    size_t hi = entryCount;
+
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        const Entry &entry = entries[mid];
+
+        size_t length = min((size_t)entry.pathLength, path.size());
+        int c = memcmp(paths + entry.pathOffset, path.data(), length);
+
+        if (c == 0)
+        {
+            if (entry.pathLength == path.size())
+                return &entry;
+
+            c = entry.pathLength < path.size() ? -1 : 1;
+        }
+
+        if (c < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return 0;
+}
+
+static bool mapFile(const string &path)
+{
+#if defined(_WIN32)
+    fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, 0);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(fileHandle, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(fileHandle);
+        fileHandle = INVALID_HANDLE_VALUE;
+        return false;
+    }
+
+    mappingHandle = CreateFileMappingA(fileHandle, 0, PAGE_READONLY, 0, 0, 0);
+    if (mappingHandle == 0)
+    {
+        CloseHandle(fileHandle);
+        fileHandle = INVALID_HANDLE_VALUE;
+        return false;
+    }
+
+    base = (const char *)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    baseSize = (size_t)size.QuadPart;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void *view = mmap(0, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    base = view == MAP_FAILED ? 0 : (const char *)view;
+    baseSize = (size_t)info.st_size;
+#endif
+
+    if (base == 0)
+    {
+        Pack::unmount();
+        return false;
+    }
+
+    return true;
+}
+
+static void listFiles(const string &dir, const string &prefix, vector<string> &files)
+{
+#if defined(_WIN32)
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA((dir + "/*").c_str(), &data);
+
+    if (find == INVALID_HANDLE_VALUE)
+        return;
+
+    do
+    {
+        string name = data.cFileName;
+
+        if (name == "." || name == "..")
+            continue;
+
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            listFiles(dir + "/" + name, prefix + name + "/", files);
+        else
+            files.push_back(prefix + name);
+    }
+    while (FindNextFileA(find, &data));
+
+    FindClose(find);
+#else
+    DIR *d = opendir(dir.c_str());
+
+    if (d == 0)
+        return;
+
+    while (struct dirent *item = readdir(d))
+    {
+        string name = item->d_name;
+
+        if (name == "." || name == "..")
+            continue;
+
+        struct stat info;
+        if (stat((dir + "/" + name).c_str(), &info) != 0)
+            continue;
+
+        if (S_ISDIR(info.st_mode))
+            listFiles(dir + "/" + name, prefix + name + "/", files);
+        else
+            files.push_back(prefix + name);
+    }
+
+    closedir(d);
+#endif
+}
+
+static bool readFile(const string &path, vector<char> &contents)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+
+    if (file == 0)
+        return false;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    contents.resize(size > 0 ? (size_t)size : 0);
+    bool ok = contents.empty() || fread(contents.data(), 1, contents.size(), file) == contents.size();
+
+    fclose(file);
+
+    return ok;
+}
+
+// The path of a file inside the pack, with the root it was mounted at removed
+static string relativeName(const string &path)
+{
+    string name = normalize(path);
+
+    if (!root.empty() && name.size() > root.size() && name.compare(0, root.size(), root) == 0 && name[root.size()] == '/')
+        name.erase(0, root.size() + 1);
+
+    return name;
+}
+
+namespace Pack
+{
+    bool mount(const string &path, const string &rootDir)
+    {
+        unmount();
+
+        if (!mapFile(path))
+        {
+            printf("Failed to open pack %s.\n", path.c_str());
+            return false;
+        }
+
+        const Header *header = (const Header *)base;
+
+        if (baseSize < sizeof(Header) || memcmp(header->magic, magic, sizeof(magic)) != 0 || header->version != formatVersion ||
+            sizeof(Header) + (uint64_t)header->count * sizeof(Entry) > baseSize)
+        {
+            printf("%s is not a valid pack.\n", path.c_str());
+            unmount();
+            return false;
+        }
+
+        entries = (const Entry *)(base + sizeof(Header));
+        entryCount = header->count;
+        paths = (const char *)(entries + entryCount);
+        root = normalize(rootDir);
+
+        for (uint32_t i = 0; i < entryCount; i++)
+        {
+            if (entries[i].offset + entries[i].size > baseSize || paths + entries[i].pathOffset + entries[i].pathLength > base + baseSize)
+            {
+                printf("%s is truncated.\n", path.c_str());
+                unmount();
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void unmount()
+    {
+#if defined(_WIN32)
+        if (base)
+            UnmapViewOfFile(base);
+
+        if (mappingHandle)
+            CloseHandle(mappingHandle);
+
+        if (fileHandle != INVALID_HANDLE_VALUE)
+            CloseHandle(fileHandle);
+
+        mappingHandle = 0;
+        fileHandle = INVALID_HANDLE_VALUE;
+#else
+        if (base)
+            munmap((void *)base, baseSize);
+#endif
+
+        base = 0;
+        baseSize = 0;
+        entries = 0;
+        entryCount = 0;
+        paths = 0;
+    }
+
+    bool isMounted()
+    {
+        return base != 0;
+    }
+
+    bool find(const string &path, const char **data, size_t *size)
+    {
+        if (base == 0)
+            return false;
+
+        string name = relativeName(path);
+
+        {
+            lock_guard<mutex> lock(looseFilesMutex);
+
+            if (std::find(looseFiles.begin(), looseFiles.end(), name) != looseFiles.end())
+                return false;
+        }
+
+        const Entry *entry = lookup(name);
+
+        if (entry == 0)
+            return false;
+
+        *data = base + entry->offset;
+        *size = (size_t)entry->size;
+
+        return true;
+    }
+
+    void preferLooseFile(const string &path)
+    {
+        string name = relativeName(path);
+
+        lock_guard<mutex> lock(looseFilesMutex);
+
+        if (std::find(looseFiles.begin(), looseFiles.end(), name) == looseFiles.end())
+            looseFiles.push_back(name);
+    }
+
+    int addSection(CScriptBuilder &builder, const string &path)
+    {
+        const char *data;
+        size_t size;
+
+        if (find(path, &data, &size))
+            return builder.AddSectionFromMemory(path.c_str(), data, (unsigned int)size);
+
+        return builder.AddSectionFromFile(path.c_str());
+    }
+
+    // Same resolution as the builder's default: includes are relative to the including file
+    int includeCallback(const char *include, const char *from, CScriptBuilder *builder, void *userParam)
+    {
+        string path = include;
+
+        if (path.find_first_of("/\\") != 0 && path.find(':') == string::npos)
+        {
+            string dir = from;
+            size_t slash = dir.find_last_of("/\\");
+
+            dir.resize(slash == string::npos ? 0 : slash + 1);
+            path = dir + path;
+        }
+
+        return addSection(*builder, path);
+    }
+
+    bool build(const string &dir, const string &out)
+    {
+        vector<string> files;
+        listFiles(dir, "", files);
+        sort(files.begin(), files.end());
+
+        vector<Entry> index(files.size());
+        string names;
+
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            index[i].pathOffset = (uint32_t)names.size();
+            index[i].pathLength = (uint32_t)files[i].size();
+            names += files[i];
+        }
+
+        uint64_t offset = sizeof(Header) + index.size() * sizeof(Entry) + names.size();
+
+        FILE *file = fopen(out.c_str(), "wb");
+
+        if (file == 0)
+        {
+            printf("Failed to open %s for writing.\n", out.c_str());
+            return false;
+        }
+
+        // The index is written last, once every offset and size is known
+        fseek(file, (long)offset, SEEK_SET);
+
+        vector<char> contents;
+        static const char padding[alignment] = {};
+
+        for (size_t i = 0; i < files.size(); i++)
+        {
+            if (!readFile(dir + "/" + files[i], contents))
+            {
+                printf("Failed to read %s.\n", files[i].c_str());
+                fclose(file);
+                return false;
+            }
+
+            uint64_t pad = (alignment - offset % alignment) % alignment;
+            fwrite(padding, 1, (size_t)pad, file);
+            offset += pad;
+
+            index[i].offset = offset;
+            index[i].size = contents.size();
+
+            fwrite(contents.data(), 1, contents.size(), file);
+            offset += contents.size();
+        }
+
+        Header header;
+        memcpy(header.magic, magic, sizeof(magic));
+        header.version = formatVersion;
+        header.count = (uint32_t)index.size();
+        header.alignment = alignment;
+
+        fseek(file, 0, SEEK_SET);
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(index.data(), sizeof(Entry), index.size(), file);
+        fwrite(names.data(), 1, names.size(), file);
+
+        bool ok = ferror(file) == 0;
+        fclose(file);
+
+        printf("Packed %d files from %s into %s.\n", (int)files.size(), dir.c_str(), out.c_str());
+
+        return ok;
+    }
+}
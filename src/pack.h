@@ -0,0 +1,36 @@
+#ifndef PACK_H
+#define PACK_H
+
+#include <string>
+#include <cstddef>
+
+#include "scriptbuilder.h"
+
+using namespace std;
+
+// .vpak archives: a header, an index of entries sorted by path, the paths,
+// then every file's contents aligned to 16 bytes. A mounted pack is mapped
+// into memory once and lookups are a binary search over the index.
+namespace Pack
+{
+    bool mount(const string &path, const string &root);
+    void unmount();
+    bool isMounted();
+
+    // Paths are resolved relative to the root given to mount, so both
+    // "demo/main.as" and "main.as" find the same entry
+    bool find(const string &path, const char **data, size_t *size);
+
+    // Makes find skip the packed copy of path so it is read from disk, for
+    // files saved from the editor while a pack is mounted
+    void preferLooseFile(const string &path);
+
+    // Adds a script section from the pack, or from disk if it isn't packed
+    int addSection(CScriptBuilder &builder, const string &path);
+    int includeCallback(const char *include, const char *from, CScriptBuilder *builder, void *userParam);
+
+    // Packs every file below dir into out
+    bool build(const string &dir, const string &out);
+}
+
+#endif
@@ -0,0 +1,528 @@
+#include "physics.h"
+
+#include <cassert>
+#include <vector>
+
+using namespace std;
+
+static void setException(const char *message)
+{
+    asIScriptContext *ctx = asGetActiveContext();
+
+    if (ctx)
+        ctx->SetException(message);
+}
+
+// Bodies, fixtures and joints live in slot vectors, the id being the slot.
+// Freed slots are reused so the vectors stay as small as the live set.
+template <typename T>
+static int allocateSlot(vector<T *> &slots, vector<int> &freeSlots, T *item)
+{
+    if (!freeSlots.empty())
+    {
+        int slot = freeSlots.back();
+        freeSlots.pop_back();
+        slots[slot] = item;
+        return slot;
+    }
+
+    slots.push_back(item);
+    return (int)slots.size() - 1;
+}
+
+template <typename T>
+static void freeSlot(vector<T *> &slots, vector<int> &freeSlots, int slot)
+{
+    slots[slot] = 0;
+    freeSlots.push_back(slot);
+}
+
+// b2PolygonShape::Set asserts when the hull collapses, so polygons
+// without three points spanning some area are rejected up front.
+static bool hasArea(const b2Vec2 *vertices, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        for (int j = i + 1; j < count; j++)
+        {
+            for (int k = j + 1; k < count; k++)
+            {
+                if (b2Abs(b2Cross(vertices[j] - vertices[i], vertices[k] - vertices[i])) > b2_linearSlop * b2_linearSlop)
+                    return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+namespace Api
+{
+    namespace Physics
+    {
+        World::World(float gravityX, float gravityY, float pixelsPerMeter)
+            : world(b2Vec2(gravityX / pixelsPerMeter, gravityY / pixelsPerMeter)),
+              scale(pixelsPerMeter), inverseScale(1.0f / pixelsPerMeter), refCount(1)
+        {
+            world.SetContactListener(this);
+            world.SetDestructionListener(this);
+        }
+
+        World *World::create(float gravityX, float gravityY, float pixelsPerMeter)
+        {
+            if (!(pixelsPerMeter > 0.0f))
+            {
+                setException("Pixels per meter must be greater than zero");
+                return 0;
+            }
+
+            return new World(gravityX, gravityY, pixelsPerMeter);
+        }
+
+        void World::addRef()
+        {
+            asAtomicInc(refCount);
+        }
+
+        void World::release()
+        {
+            if (asAtomicDec(refCount) == 0)
+                delete this;
+        }
+
+        b2Body *World::getBody(int body)
+        {
+            if (body < 0 || body >= (int)bodies.size() || bodies[body] == 0)
+            {
+                setException("Invalid body");
+                return 0;
+            }
+
+            return bodies[body];
+        }
+
+        b2Fixture *World::getFixture(int fixture)
+        {
+            if (fixture < 0 || fixture >= (int)fixtures.size() || fixtures[fixture] == 0)
+            {
+                setException("Invalid fixture");
+                return 0;
+            }
+
+            return fixtures[fixture];
+        }
+
+        bool World::unlocked()
+        {
+            if (world.IsLocked())
+            {
+                setException("The physics world can't be modified during a step");
+                return false;
+            }
+
+            return true;
+        }
+
+        void World::setGravity(float x, float y)
+        {
+            world.SetGravity(b2Vec2(x * inverseScale, y * inverseScale));
+        }
+
+        float World::getPixelsPerMeter() const
+        {
+            return scale;
+        }
+
+        void World::step(float dt, int velocityIterations, int positionIterations)
+        {
+            world.Step(dt, velocityIterations, positionIterations);
+        }
+
+        int World::createBody(int type, float x, float y, float angle)
+        {
+            if (!unlocked())
+                return -1;
+
+            b2BodyDef def;
+            def.type = (b2BodyType)type;
+            def.position.Set(x * inverseScale, y * inverseScale);
+            def.angle = angle;
+
+            b2Body *body = world.CreateBody(&def);
+            int id = allocateSlot(bodies, freeBodies, body);
+            body->GetUserData().pointer = (uintptr_t)id;
+
+            return id;
+        }
+
+        void World::destroyBody(int body)
+        {
+            b2Body *b = getBody(body);
+
+            if (b == 0 || !unlocked())
+                return;
+
+            // The fixtures and joints attached to the body are
+            // released through the SayGoodbye callbacks.
+            world.DestroyBody(b);
+            freeSlot(bodies, freeBodies, body);
+        }
+
+        asUINT World::bodyCount() const
+        {
+            return (asUINT)world.GetBodyCount();
+        }
+
+        int World::addFixture(int body, const b2Shape &shape, float density, float friction, float restitution)
+        {
+            b2Body *b = getBody(body);
+
+            if (b == 0 || !unlocked())
+                return -1;
+
+            b2FixtureDef def;
+            def.shape = &shape;
+            def.density = density;
+            def.friction = friction;
+            def.restitution = restitution;
+
+            b2Fixture *fixture = b->CreateFixture(&def);
+            int id = allocateSlot(fixtures, freeFixtures, fixture);
+            fixture->GetUserData().pointer = (uintptr_t)id;
+
+            return id;
+        }
+
+        int World::addBox(int body, float halfWidth, float halfHeight, float density, float friction, float restitution)
+        {
+            b2PolygonShape shape;
+            shape.SetAsBox(halfWidth * inverseScale, halfHeight * inverseScale);
+
+            return addFixture(body, shape, density, friction, restitution);
+        }
+
+        int World::addCircle(int body, float radius, float density, float friction, float restitution)
+        {
+            b2CircleShape shape;
+            shape.m_radius = radius * inverseScale;
+
+            return addFixture(body, shape, density, friction, restitution);
+        }
+
+        int World::addPolygon(int body, const Vec2Array *points, float density, float friction, float restitution)
+        {
+            if (points == 0)
+            {
+                setException("Null pointer access");
+                return -1;
+            }
+
+            int count = (int)points->length();
+
+            if (count < 3 || count > b2_maxPolygonVertices)
+            {
+                setException("A polygon needs between 3 and 8 points");
+                return -1;
+            }
+
+            b2Vec2 vertices[b2_maxPolygonVertices];
+
+            for (int i = 0; i < count; i++)
+                vertices[i].Set(points->data[i * 2] * inverseScale, points->data[i * 2 + 1] * inverseScale);
+
+            if (!hasArea(vertices, count))
+            {
+                setException("The polygon points are degenerate");
+                return -1;
+            }
+
+            b2PolygonShape shape;
+            shape.Set(vertices, count);
+
+            return addFixture(body, shape, density, friction, restitution);
+        }
+
+        void World::setSensor(int fixture, bool sensor)
+        {
+            b2Fixture *f = getFixture(fixture);
+
+            if (f)
+                f->SetSensor(sensor);
+        }
+
+        void World::destroyFixture(int fixture)
+        {
+            b2Fixture *f = getFixture(fixture);
+
+            if (f == 0 || !unlocked())
+                return;
+
+            f->GetBody()->DestroyFixture(f);
+            freeSlot(fixtures, freeFixtures, fixture);
+        }
+
+        int World::addJoint(const b2JointDef &def)
+        {
+            b2Joint *joint = world.CreateJoint(&def);
+            int id = allocateSlot(joints, freeJoints, joint);
+            joint->GetUserData().pointer = (uintptr_t)id;
+
+            return id;
+        }
+
+        int World::createRevoluteJoint(int a, int b, float x, float y)
+        {
+            b2Body *bodyA = getBody(a);
+            b2Body *bodyB = bodyA ? getBody(b) : 0;
+
+            if (bodyB == 0 || !unlocked())
+                return -1;
+
+            b2RevoluteJointDef def;
+            def.Initialize(bodyA, bodyB, b2Vec2(x * inverseScale, y * inverseScale));
+
+            return addJoint(def);
+        }
+
+        int World::createWeldJoint(int a, int b, float x, float y)
+        {
+            b2Body *bodyA = getBody(a);
+            b2Body *bodyB = bodyA ? getBody(b) : 0;
+
+            if (bodyB == 0 || !unlocked())
+                return -1;
+
+            b2WeldJointDef def;
+            def.Initialize(bodyA, bodyB, b2Vec2(x * inverseScale, y * inverseScale));
+
+            return addJoint(def);
+        }
+
+        int World::createDistanceJoint(int a, int b, float ax, float ay, float bx, float by)
+        {
+            b2Body *bodyA = getBody(a);
+            b2Body *bodyB = bodyA ? getBody(b) : 0;
+
+            if (bodyB == 0 || !unlocked())
+                return -1;
+
+            b2DistanceJointDef def;
+            def.Initialize(bodyA, bodyB, b2Vec2(ax * inverseScale, ay * inverseScale), b2Vec2(bx * inverseScale, by * inverseScale));
+
+            return addJoint(def);
+        }
+
+        void World::destroyJoint(int joint)
+        {
+            if (joint < 0 || joint >= (int)joints.size() || joints[joint] == 0)
+            {
+                setException("Invalid joint");
+                return;
+            }
+
+            if (!unlocked())
+                return;
+
+            world.DestroyJoint(joints[joint]);
+            freeSlot(joints, freeJoints, joint);
+        }
+
+        void World::setTransform(int body, float x, float y, float angle)
+        {
+            b2Body *b = getBody(body);
+
+            if (b && unlocked())
+                b->SetTransform(b2Vec2(x * inverseScale, y * inverseScale), angle);
+        }
+
+        Vector2 World::getPosition(int body)
+        {
+            Vector2 position = { 0.0f, 0.0f };
+            b2Body *b = getBody(body);
+
+            if (b)
+            {
+                position.x = b->GetPosition().x * scale;
+                position.y = b->GetPosition().y * scale;
+            }
+
+            return position;
+        }
+
+        float World::getAngle(int body)
+        {
+            b2Body *b = getBody(body);
+
+            return b ? b->GetAngle() : 0.0f;
+        }
+
+        void World::setLinearVelocity(int body, float x, float y)
+        {
+            b2Body *b = getBody(body);
+
+            if (b)
+                b->SetLinearVelocity(b2Vec2(x * inverseScale, y * inverseScale));
+        }
+
+        Vector2 World::getLinearVelocity(int body)
+        {
+            Vector2 velocity = { 0.0f, 0.0f };
+            b2Body *b = getBody(body);
+
+            if (b)
+            {
+                velocity.x = b->GetLinearVelocity().x * scale;
+                velocity.y = b->GetLinearVelocity().y * scale;
+            }
+
+            return velocity;
+        }
+
+        void World::setAngularVelocity(int body, float velocity)
+        {
+            b2Body *b = getBody(body);
+
+            if (b)
+                b->SetAngularVelocity(velocity);
+        }
+
+        void World::applyForce(int body, float x, float y)
+        {
+            b2Body *b = getBody(body);
+
+            if (b)
+                b->ApplyForceToCenter(b2Vec2(x * inverseScale, y * inverseScale), true);
+        }
+
+        void World::applyImpulse(int body, float x, float y)
+        {
+            b2Body *b = getBody(body);
+
+            if (b)
+                b->ApplyLinearImpulseToCenter(b2Vec2(x * inverseScale, y * inverseScale), true);
+        }
+
+        void World::exportTransforms(Int32Array *ids, Vec2Array *positions, Float32Array *angles)
+        {
+            if (ids == 0 || positions == 0 || angles == 0)
+            {
+                setException("Null pointer access");
+                return;
+            }
+
+            size_t count = (size_t)world.GetBodyCount();
+
+            if (!ids->checkResize(count) || !angles->checkResize(count))
+                return;
+
+            ids->data.resize(count);
+            positions->data.resize(count * 2);
+            angles->data.resize(count);
+
+            int32_t *id = ids->data.data();
+            float *position = positions->data.data();
+            float *angle = angles->data.data();
+
+            for (b2Body *b = world.GetBodyList(); b; b = b->GetNext())
+            {
+                const b2Transform &transform = b->GetTransform();
+
+                *id++ = (int32_t)b->GetUserData().pointer;
+                *position++ = transform.p.x * scale;
+                *position++ = transform.p.y * scale;
+                *angle++ = transform.q.GetAngle();
+            }
+        }
+
+        void World::contacts(Int32Array *began, Int32Array *ended)
+        {
+            if (began == 0 || ended == 0)
+            {
+                setException("Null pointer access");
+                return;
+            }
+
+            if (!began->checkResize(beganPairs.size()) || !ended->checkResize(endedPairs.size()))
+                return;
+
+            began->data.swap(beganPairs);
+            ended->data.swap(endedPairs);
+            beganPairs.clear();
+            endedPairs.clear();
+        }
+
+        void World::recordContact(b2Contact *contact, vector<int32_t> &pairs)
+        {
+            pairs.push_back((int32_t)contact->GetFixtureA()->GetBody()->GetUserData().pointer);
+            pairs.push_back((int32_t)contact->GetFixtureB()->GetBody()->GetUserData().pointer);
+        }
+
+        void World::BeginContact(b2Contact *contact)
+        {
+            recordContact(contact, beganPairs);
+        }
+
+        void World::EndContact(b2Contact *contact)
+        {
+            recordContact(contact, endedPairs);
+        }
+
+        void World::SayGoodbye(b2Joint *joint)
+        {
+            freeSlot(joints, freeJoints, (int)joint->GetUserData().pointer);
+        }
+
+        void World::SayGoodbye(b2Fixture *fixture)
+        {
+            freeSlot(fixtures, freeFixtures, (int)fixture->GetUserData().pointer);
+        }
+    }
+
+    void registerPhysics(asIScriptEngine *engine)
+    {
+        int r;
+
+        r = engine->SetDefaultNamespace("vd::physics"); assert(r >= 0);
+
+        r = engine->RegisterEnum("BodyType"); assert(r >= 0);
+        r = engine->RegisterEnumValue("BodyType", "Static", Physics::Static); assert(r >= 0);
+        r = engine->RegisterEnumValue("BodyType", "Kinematic", Physics::Kinematic); assert(r >= 0);
+        r = engine->RegisterEnumValue("BodyType", "Dynamic", Physics::Dynamic); assert(r >= 0);
+
+        r = engine->RegisterObjectType("World", 0, asOBJ_REF); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("World", asBEHAVE_FACTORY, "World@ f(float gravityX = 0, float gravityY = 320, float pixelsPerMeter = 32)", asFUNCTION(Physics::World::create), asCALL_CDECL); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("World", asBEHAVE_ADDREF, "void f()", asMETHOD(Physics::World, addRef), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("World", asBEHAVE_RELEASE, "void f()", asMETHOD(Physics::World, release), asCALL_THISCALL); assert(r >= 0);
+
+        r = engine->RegisterObjectMethod("World", "void setGravity(float, float)", asMETHOD(Physics::World, setGravity), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("World", "float get_pixelsPerMeter() const", asMETHOD(Physics::World, getPixelsPerMeter), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("World", "void step(float, int velocityIterations = 8, int positionIterations = 3)", asMETHOD(Physics::World, step), asCALL_THISCALL); assert(r >= 0);
+
+        r = engine->RegisterObjectMethod("World", "int createBody(BodyType, float, float, float angle = 0)", asMETHOD(Physics::World, createBody), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("World", "void destroyBody(int)", asMETHOD(Physics::World, destroyBody), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("World", "uint bodyCount() const", asMETHOD(Physics::World, bodyCount), asCALL_THISCALL); assert(r >= 0);
+
+        r = engine->RegisterObjectMethod("World", "int addBox(int, float, float, float density = 1, float friction = 0.3, float restitution = 0)", asMETHOD(Physics::World, addBox), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("World", "int addCircle(int, float, float density = 1, float friction = 0.3, float restitution = 0)", asMETHOD(Physics::World, addCircle), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("World", "int addPolygon(int, const vec2array@, float density = 1, float friction = 0.3, float restitution = 0)", asMETHOD(Physics::World, addPolygon), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("World", "void setSensor(int, bool)", asMETHOD(Physics::World, setSensor), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("World", "void destroyFixture(int)", asMETHOD(Physics::World, destroyFixture), asCALL_THISCALL); assert(r >= 0);
+
+        r = engine->RegisterObjectMethod("World", "int createRevoluteJoint(int, int, float, float)", asMETHOD(Physics::World, createRevoluteJoint), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("World", "int createWeldJoint(int, int, float, float)", asMETHOD(Physics::World, createWeldJoint), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("World", "int createDistanceJoint(int, int, float, float, float, float)", asMETHOD(Physics::World, createDistanceJoint), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("World", "void destroyJoint(int)", asMETHOD(Physics::World, destroyJoint), asCALL_THISCALL); assert(r >= 0);
+
+        r = engine->RegisterObjectMethod("World", "void setTransform(int, float, float, float)", asMETHOD(Physics::World, setTransform), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("World", "Vector2 getPosition(int)", asMETHOD(Physics::World, getPosition), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("World", "float getAngle(int)", asMETHOD(Physics::World, getAngle), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("World", "void setLinearVelocity(int, float, float)", asMETHOD(Physics::World, setLinearVelocity), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("World", "Vector2 getLinearVelocity(int)", asMETHOD(Physics::World, getLinearVelocity), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("World", "void setAngularVelocity(int, float)", asMETHOD(Physics::World, setAngularVelocity), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("World", "void applyForce(int, float, float)", asMETHOD(Physics::World, applyForce), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("World", "void applyImpulse(int, float, float)", asMETHOD(Physics::World, applyImpulse), asCALL_THISCALL); assert(r >= 0);
+
+        r = engine->RegisterObjectMethod("World", "void exportTransforms(int32array@, vec2array@, float32array@)", asMETHOD(Physics::World, exportTransforms), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("World", "void contacts(int32array@, int32array@)", asMETHOD(Physics::World, contacts), asCALL_THISCALL); assert(r >= 0);
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef PHYSICS_H
+#define PHYSICS_H
+
+#include <vector>
+#include <cstdint>
+
+#include "box2d/box2d.h"
+
+#include "angelscript.h"
+#include "api.h"
+#include "typedarray.h"
+
+using namespace std;
+
+namespace Api
+{
+    namespace Physics
+    {
+        enum BodyType
+        {
+            Static = b2_staticBody,
+            Kinematic = b2_kinematicBody,
+            Dynamic = b2_dynamicBody
+        };
+
+        // A b2World whose bodies, fixtures and joints are handed to the script as
+        // integer ids. Everything the script sees is in pixels, converted with
+        // pixelsPerMeter so Box2D still works with sizes it is tuned for.
+        class World : public b2ContactListener, public b2DestructionListener
+        {
+        public:
+            World(float gravityX, float gravityY, float pixelsPerMeter);
+
+            static World *create(float gravityX, float gravityY, float pixelsPerMeter);
+
+            void addRef();
+            void release();
+
+            void setGravity(float x, float y);
+            float getPixelsPerMeter() const;
+            void step(float dt, int velocityIterations, int positionIterations);
+
+            int createBody(int type, float x, float y, float angle);
+            void destroyBody(int body);
+            asUINT bodyCount() const;
+
+            int addBox(int body, float halfWidth, float halfHeight, float density, float friction, float restitution);
+            int addCircle(int body, float radius, float density, float friction, float restitution);
+            int addPolygon(int body, const Vec2Array *points, float density, float friction, float restitution);
+            void setSensor(int fixture, bool sensor);
+            void destroyFixture(int fixture);
+
+            int createRevoluteJoint(int a, int b, float x, float y);
+            int createWeldJoint(int a, int b, float x, float y);
+            int createDistanceJoint(int a, int b, float ax, float ay, float bx, float by);
+            void destroyJoint(int joint);
+
+            void setTransform(int body, float x, float y, float angle);
+            Vector2 getPosition(int body);
+            float getAngle(int body);
+            void setLinearVelocity(int body, float x, float y);
+            Vector2 getLinearVelocity(int body);
+            void setAngularVelocity(int body, float velocity);
+            void applyForce(int body, float x, float y);
+            void applyImpulse(int body, float x, float y);
+
+            // Writes the id, position and angle of every body, one element per body
+            void exportTransforms(Int32Array *ids, Vec2Array *positions, Float32Array *angles);
+
+            // Moves the contacts that began and ended since the last call into
+            // the arrays, as consecutive pairs of body ids
+            void contacts(Int32Array *began, Int32Array *ended);
+
+            void BeginContact(b2Contact *contact);
+            void EndContact(b2Contact *contact);
+            void SayGoodbye(b2Joint *joint);
+            void SayGoodbye(b2Fixture *fixture);
+
+        private:
+            b2Body *getBody(int body);
+            b2Fixture *getFixture(int fixture);
+            bool unlocked();
+            int addFixture(int body, const b2Shape &shape, float density, float friction, float restitution);
+            int addJoint(const b2JointDef &def);
+            void recordContact(b2Contact *contact, vector<int32_t> &pairs);
+
+            b2World world;
+            float scale;
+            float inverseScale;
+
+            vector<b2Body *> bodies;
+            vector<int> freeBodies;
+            vector<b2Fixture *> fixtures;
+            vector<int> freeFixtures;
+            vector<b2Joint *> joints;
+            vector<int> freeJoints;
+
+            vector<int32_t> beganPairs;
+            vector<int32_t> endedPairs;
+
+            int refCount;
+        };
+    }
+
+    void registerPhysics(asIScriptEngine *engine);
+}
+
+#endif
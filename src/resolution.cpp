@@ -0,0 +1,125 @@
+#include "resolution.h"
+
+#include <cmath>
+
+#include "raylib.h"
+#include "raymath.h"
+#include "rlgl.h"
+
+// Frames averaged before the scale is reconsidered
+static const int sampleCount = 30;
+
+static const float minScale = 0.5f;
+static const float scaleDown = 0.1f;
+static const float scaleUp = 0.05f;
+
+// Only grow again once there is this much headroom, so the scale doesn't
+// bounce between two steps
+static const double growThreshold = 0.75;
+
+static int logicalWidth = 800;
+static int logicalHeight = 600;
+static float currentScale = 1.0f;
+
+static double budget = 0.0;
+static double samples[sampleCount];
+static int sampleIndex = 0;
+static int sampled = 0;
+
+namespace Resolution
+{
+    void init(int width, int height)
+    {
+        logicalWidth = width;
+        logicalHeight = height;
+        currentScale = 1.0f;
+        sampled = 0;
+    }
+
+    void setDynamic(double value)
+    {
+        budget = value > 0.0 ? value : 0.0;
+        currentScale = 1.0f;
+        sampled = 0;
+    }
+
+    bool isDynamic()
+    {
+        return budget > 0.0;
+    }
+
+    int width()
+    {
+        return logicalWidth;
+    }
+
+    int height()
+    {
+        return logicalHeight;
+    }
+
+    float scale()
+    {
+        return currentScale;
+    }
+
+    int viewportWidth()
+    {
+        return (int)(logicalWidth * currentScale + 0.5f);
+    }
+
+    int viewportHeight()
+    {
+        return (int)(logicalHeight * currentScale + 0.5f);
+    }
+
+    void begin()
+    {
+        rlPushMatrix();
+        rlScalef((float)viewportWidth() / logicalWidth, (float)viewportHeight() / logicalHeight, 1.0f);
+    }
+
+    void end()
+    {
+        rlPopMatrix();
+    }
+
+    void update(double frameTime)
+    {
+        if (budget <= 0.0)
+            return;
+
+        samples[sampleIndex] = frameTime;
+        sampleIndex = (sampleIndex + 1) % sampleCount;
+
+        if (++sampled < sampleCount)
+            return;
+
+        double average = 0.0;
+
+        for (int i = 0; i < sampleCount; i++)
+            average += samples[i];
+
+        average /= sampleCount;
+
+        if (average > budget && currentScale > minScale)
+            currentScale = fmaxf(currentScale - scaleDown, minScale);
+        else if (average < budget * growThreshold && currentScale < 1.0f)
+            currentScale = fminf(currentScale + scaleUp, 1.0f);
+        else
+            return;
+
+        // Start a fresh window so the next decision only sees the new scale
+        sampled = 0;
+    }
+
+    Vector2 toVirtual(Vector2 position, int screenWidth, int screenHeight)
+    {
+        float scale = fminf((float)screenWidth / logicalWidth, (float)screenHeight / logicalHeight);
+
+        position.x = (position.x - (screenWidth - logicalWidth * scale) * 0.5f) / scale;
+        position.y = (position.y - (screenHeight - logicalHeight * scale) * 0.5f) / scale;
+
+        return Vector2Clamp(position, (Vector2){ 0, 0 }, (Vector2){ (float)logicalWidth, (float)logicalHeight });
+    }
+}
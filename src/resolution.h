@@ -0,0 +1,37 @@
+#ifndef RESOLUTION_H
+#define RESOLUTION_H
+
+#include "raylib.h"
+
+// Internal resolution of the game render target. Scripts always draw and
+// read the mouse in the logical width and height, in dynamic mode the part
+// of the target actually rendered to shrinks or grows to keep the frame
+// work under a budget and is stretched back out when presented.
+namespace Resolution
+{
+    void init(int width, int height);
+
+    // budget is the update and draw time to aim for in ms, 0 turns it off
+    void setDynamic(double budget);
+    bool isDynamic();
+
+    int width();
+    int height();
+    float scale();
+
+    // Size in pixels of the part of the target in use this frame
+    int viewportWidth();
+    int viewportHeight();
+
+    // Wrap the game's drawing inside BeginTextureMode
+    void begin();
+    void end();
+
+    // Feeds in the work time of a frame, may change the scale for the next one
+    void update(double frameTime);
+
+    // Maps a window position to the logical resolution, letterboxed to fit
+    Vector2 toVirtual(Vector2 position, int screenWidth, int screenHeight);
+}
+
+#endif
@@ -0,0 +1,1035 @@
+#include "rollback.h"
+
+#include <cassert>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#include "scriptarray.h"
+#include "scriptdictionary.h"
+#include "typedarray.h"
+#include "log.h"
+
+using namespace std;
+
+enum Kind
+{
+    ScriptObject,
+    Array,
+    Floats,
+    Ints,
+    Vec2s,
+    Dictionary,
+    Opaque
+};
+
+// Handles are stored as 0 for null, 1 for a value the snapshot doesn't track
+// and the index of the object plus 2 otherwise.
+static const asUINT nullHandle = 0;
+static const asUINT untracked = 1;
+static const asUINT firstObject = 2;
+
+struct Global
+{
+    void *address;
+    int typeId;
+    asUINT size;
+};
+
+struct Property
+{
+    int typeId;
+    asUINT size;
+};
+
+static asIScriptEngine *engine = 0;
+static asIScriptFunction *updateFunction = 0;
+static vector<Global> globals;
+static unsigned generation = 0;
+static unsigned lastGeneration = 0;
+static bool inResimulation = false;
+
+static int stringTypeId = 0;
+static asITypeInfo *snapshotType = 0;
+static asITypeInfo *floatsType = 0;
+static asITypeInfo *intsType = 0;
+static asITypeInfo *vec2sType = 0;
+
+// Shared by every save and restore so they don't allocate once warmed up
+static unordered_map<void *, asUINT> indexOf;
+static unordered_map<asITypeInfo *, vector<Property> > layouts;
+static vector<uint8_t> scratch;
+static vector<string> savedKeys;
+static vector<string> staleKeys;
+
+// Types already warned about, so each is only reported once per build
+static unordered_set<asITypeInfo *> warned;
+
+struct Api::Rollback::State
+{
+    asIScriptEngine *engine;
+    asIScriptFunction *updateFunction;
+    vector<Global> globals;
+    unsigned generation;
+    int stringTypeId;
+    asITypeInfo *snapshotType;
+    asITypeInfo *floatsType;
+    asITypeInfo *intsType;
+    asITypeInfo *vec2sType;
+    unordered_map<asITypeInfo *, vector<Property> > layouts;
+    unordered_set<asITypeInfo *> warned;
+};
+
+static void swapState(Api::Rollback::State &state)
+{
+    swap(engine, state.engine);
+    swap(updateFunction, state.updateFunction);
+    globals.swap(state.globals);
+    swap(generation, state.generation);
+    swap(stringTypeId, state.stringTypeId);
+    swap(snapshotType, state.snapshotType);
+    swap(floatsType, state.floatsType);
+    swap(intsType, state.intsType);
+    swap(vec2sType, state.vec2sType);
+    layouts.swap(state.layouts);
+    warned.swap(state.warned);
+}
+
+static void setException(const char *message)
+{
+    asIScriptContext *ctx = asGetActiveContext();
+
+    if (ctx)
+        ctx->SetException(message);
+}
+
+// Snapshots only hold the identity of objects they don't know the layout
+// of, restoring leaves their contents as they are at that point
+static void warnNotSaved(asITypeInfo *type)
+{
+    if (!warned.insert(type).second)
+        return;
+
+    Log::write(Console::LEVEL_WARNING, string("Rollback: the contents of ") + type->GetName() +
+        " aren't saved in snapshots, restoring one leaves them unchanged. Mark the global [norollback] if that is intended.");
+}
+
+static bool isNoRollback(const vector<string> &metadata)
+{
+    for (const string &entry : metadata)
+    {
+        size_t begin = entry.find_first_not_of(" \t");
+        size_t end = entry.find_last_not_of(" \t");
+
+        if (begin != string::npos && entry.compare(begin, end - begin + 1, "norollback") == 0)
+            return true;
+    }
+
+    return false;
+}
+
+static const vector<Property> &layoutOf(asITypeInfo *type)
+{
+    unordered_map<asITypeInfo *, vector<Property> >::iterator it = layouts.find(type);
+
+    if (it != layouts.end())
+        return it->second;
+
+    vector<Property> &layout = layouts[type];
+
+    for (asUINT i = 0; i < type->GetPropertyCount(); i++)
+    {
+        Property property;
+        type->GetProperty(i, 0, &property.typeId);
+        property.size = (property.typeId & asTYPEID_MASK_OBJECT) ? 0 : engine->GetSizeOfPrimitiveType(property.typeId);
+        layout.push_back(property);
+    }
+
+    return layout;
+}
+
+// Goes through the type's own engine, snapshots can outlive the build that
+// is current, for example when the collector frees them at shutdown
+static void addRefObject(void *pointer, asITypeInfo *type)
+{
+    if (type->GetFlags() & asOBJ_SCRIPT_OBJECT)
+        ((asIScriptObject *)pointer)->AddRef();
+    else
+        type->GetEngine()->AddRefScriptObject(pointer, type);
+}
+
+static void releaseObject(void *pointer, asITypeInfo *type)
+{
+    if (type->GetFlags() & asOBJ_SCRIPT_OBJECT)
+        ((asIScriptObject *)pointer)->Release();
+    else
+        type->GetEngine()->ReleaseScriptObject(pointer, type);
+}
+
+class StateWriter
+{
+public:
+    StateWriter(vector<uint8_t> &data, vector<Api::Rollback::Snapshot::Object> &objects)
+        : data(data), objects(objects)
+    {
+    }
+
+    void bytes(const void *source, size_t size)
+    {
+        size_t offset = data.size();
+        data.resize(offset + size);
+        memcpy(data.data() + offset, source, size);
+    }
+
+    void varint(asUINT value)
+    {
+        while (value >= 0x80)
+        {
+            data.push_back((uint8_t)((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+
+        data.push_back((uint8_t)value);
+    }
+
+    void reference(void *pointer, asITypeInfo *type)
+    {
+        if (pointer == 0)
+        {
+            varint(nullHandle);
+            return;
+        }
+
+        if (type == snapshotType)
+        {
+            varint(untracked);
+            return;
+        }
+
+        pair<unordered_map<void *, asUINT>::iterator, bool> found = indexOf.insert(make_pair(pointer, (asUINT)objects.size()));
+
+        if (found.second)
+        {
+            Api::Rollback::Snapshot::Object object;
+            object.pointer = pointer;
+            object.type = type;
+
+            if (type->GetFlags() & asOBJ_SCRIPT_OBJECT)
+            {
+                object.type = ((asIScriptObject *)pointer)->GetObjectType();
+                object.kind = ScriptObject;
+            }
+            else if (type == floatsType)
+                object.kind = Floats;
+            else if (type == intsType)
+                object.kind = Ints;
+            else if (type == vec2sType)
+                object.kind = Vec2s;
+            else if ((type->GetFlags() & asOBJ_TEMPLATE) && strcmp(type->GetName(), "array") == 0)
+                object.kind = Array;
+            else if (strcmp(type->GetName(), "dictionary") == 0)
+                object.kind = Dictionary;
+            else
+            {
+                object.kind = Opaque;
+                warnNotSaved(type);
+            }
+
+            addRefObject(pointer, object.type);
+            objects.push_back(object);
+        }
+
+        varint(found.first->second + firstObject);
+    }
+
+    void value(void *address, int typeId, asUINT size)
+    {
+        if ((typeId & asTYPEID_MASK_OBJECT) == 0)
+        {
+            bytes(address, size);
+            return;
+        }
+
+        if (typeId & asTYPEID_OBJHANDLE)
+        {
+            reference(*(void **)address, engine->GetTypeInfoById(typeId));
+            return;
+        }
+
+        if (typeId == stringTypeId)
+        {
+            const string *s = (const string *)address;
+            varint((asUINT)s->size());
+            bytes(s->data(), s->size());
+            return;
+        }
+
+        asITypeInfo *type = engine->GetTypeInfoById(typeId);
+
+        if (type->GetFlags() & asOBJ_REF)
+            reference(address, type);
+        else if (type->GetFlags() & asOBJ_POD)
+            bytes(address, type->GetSize());
+        else
+            warnNotSaved(type); // No known layout, left out
+    }
+
+    void contents(const Api::Rollback::Snapshot::Object &object)
+    {
+        switch (object.kind)
+        {
+            case ScriptObject:
+            {
+                asIScriptObject *instance = (asIScriptObject *)object.pointer;
+                const vector<Property> &layout = layoutOf(object.type);
+
+                for (asUINT i = 0; i < layout.size(); i++)
+                    value(instance->GetAddressOfProperty(i), layout[i].typeId, layout[i].size);
+
+                break;
+            }
+
+            case Array:
+            {
+                CScriptArray *array = (CScriptArray *)object.pointer;
+                int typeId = array->GetElementTypeId();
+                asUINT count = array->GetSize();
+
+                varint(count);
+
+                if ((typeId & asTYPEID_MASK_OBJECT) == 0)
+                    bytes(array->GetBuffer(), (size_t)count * engine->GetSizeOfPrimitiveType(typeId));
+                else if (typeId & asTYPEID_OBJHANDLE)
+                {
+                    void **slots = (void **)array->GetBuffer();
+                    asITypeInfo *type = engine->GetTypeInfoById(typeId);
+
+                    for (asUINT i = 0; i < count; i++)
+                        reference(slots[i], type);
+                }
+                else
+                {
+                    for (asUINT i = 0; i < count; i++)
+                        value(array->At(i), typeId, 0);
+                }
+
+                break;
+            }
+
+            case Floats:
+            {
+                const vector<float> &values = ((Api::Float32Array *)object.pointer)->data;
+                varint((asUINT)values.size());
+                bytes(values.data(), values.size() * sizeof(float));
+                break;
+            }
+
+            case Ints:
+            {
+                const vector<int32_t> &values = ((Api::Int32Array *)object.pointer)->data;
+                varint((asUINT)values.size());
+                bytes(values.data(), values.size() * sizeof(int32_t));
+                break;
+            }
+
+            case Vec2s:
+            {
+                const vector<float> &values = ((Api::Vec2Array *)object.pointer)->data;
+                varint((asUINT)values.size());
+                bytes(values.data(), values.size() * sizeof(float));
+                break;
+            }
+
+            case Dictionary:
+            {
+                CScriptDictionary *dictionary = (CScriptDictionary *)object.pointer;
+
+                varint(dictionary->GetSize());
+
+                for (CScriptDictionary::CIterator it = dictionary->begin(); it != dictionary->end(); it++)
+                {
+                    const string &key = it.GetKey();
+                    int typeId = it.GetTypeId();
+                    const void *address = it.GetAddressOfValue();
+
+                    varint((asUINT)key.size());
+                    bytes(key.data(), key.size());
+                    varint((asUINT)typeId);
+
+                    if ((typeId & asTYPEID_MASK_OBJECT) == 0)
+                        bytes(address, engine->GetSizeOfPrimitiveType(typeId));
+                    else if (typeId & asTYPEID_OBJHANDLE)
+                        reference(*(void **)address, engine->GetTypeInfoById(typeId));
+                    else if (typeId == stringTypeId)
+                        value((void *)address, typeId, 0);
+                    else
+                        warnNotSaved(engine->GetTypeInfoById(typeId)); // Objects held by value keep the current value
+                }
+
+                break;
+            }
+
+            default:
+                // Opaque objects only keep their identity
+                break;
+        }
+    }
+
+private:
+    vector<uint8_t> &data;
+    vector<Api::Rollback::Snapshot::Object> &objects;
+};
+
+class StateReader
+{
+public:
+    StateReader(const uint8_t *data, const vector<Api::Rollback::Snapshot::Object> &objects)
+        : position(data), objects(objects)
+    {
+    }
+
+    void bytes(void *destination, size_t size)
+    {
+        memcpy(destination, position, size);
+        position += size;
+    }
+
+    asUINT varint()
+    {
+        asUINT value = 0;
+
+        for (int shift = 0;; shift += 7)
+        {
+            uint8_t c = *position++;
+            value |= (asUINT)(c & 0x7f) << shift;
+
+            if ((c & 0x80) == 0)
+                break;
+        }
+
+        return value;
+    }
+
+    // Points a handle back at the object it held when the snapshot was saved
+    void handle(void **slot, asITypeInfo *declared)
+    {
+        asUINT index = varint();
+
+        if (index == untracked)
+            return;
+
+        void *pointer = index == nullHandle ? 0 : objects[index - firstObject].pointer;
+
+        if (*slot == pointer)
+            return;
+
+        if (pointer)
+            addRefObject(pointer, objects[index - firstObject].type);
+
+        void *old = *slot;
+        *slot = pointer;
+
+        if (old)
+            releaseObject(old, declared);
+    }
+
+    void value(void *address, int typeId, asUINT size)
+    {
+        if ((typeId & asTYPEID_MASK_OBJECT) == 0)
+        {
+            bytes(address, size);
+            return;
+        }
+
+        if (typeId & asTYPEID_OBJHANDLE)
+        {
+            handle((void **)address, engine->GetTypeInfoById(typeId));
+            return;
+        }
+
+        if (typeId == stringTypeId)
+        {
+            asUINT length = varint();
+            ((string *)address)->assign((const char *)position, length);
+            position += length;
+            return;
+        }
+
+        asITypeInfo *type = engine->GetTypeInfoById(typeId);
+
+        // Objects held by value can't be reseated, their contents are restored
+        // from the object table instead
+        if (type->GetFlags() & asOBJ_REF)
+            varint();
+        else if (type->GetFlags() & asOBJ_POD)
+            bytes(address, type->GetSize());
+    }
+
+    void contents(const Api::Rollback::Snapshot::Object &object)
+    {
+        switch (object.kind)
+        {
+            case ScriptObject:
+            {
+                asIScriptObject *instance = (asIScriptObject *)object.pointer;
+                const vector<Property> &layout = layoutOf(object.type);
+
+                for (asUINT i = 0; i < layout.size(); i++)
+                    value(instance->GetAddressOfProperty(i), layout[i].typeId, layout[i].size);
+
+                break;
+            }
+
+            case Array:
+            {
+                CScriptArray *array = (CScriptArray *)object.pointer;
+                int typeId = array->GetElementTypeId();
+                asUINT count = varint();
+
+                array->Resize(count);
+
+                if ((typeId & asTYPEID_MASK_OBJECT) == 0)
+                    bytes(array->GetBuffer(), (size_t)count * engine->GetSizeOfPrimitiveType(typeId));
+                else if (typeId & asTYPEID_OBJHANDLE)
+                {
+                    void **slots = (void **)array->GetBuffer();
+                    asITypeInfo *type = engine->GetTypeInfoById(typeId);
+
+                    for (asUINT i = 0; i < count; i++)
+                        handle(&slots[i], type);
+                }
+                else if (engine->GetTypeInfoById(typeId)->GetFlags() & asOBJ_REF)
+                {
+                    // Elements are owned by the array, so they can be swapped
+                    // for the saved objects like handles
+                    void **slots = (void **)array->GetBuffer();
+                    asITypeInfo *type = engine->GetTypeInfoById(typeId);
+
+                    for (asUINT i = 0; i < count; i++)
+                        handle(&slots[i], type);
+                }
+                else
+                {
+                    for (asUINT i = 0; i < count; i++)
+                        value(array->At(i), typeId, 0);
+                }
+
+                break;
+            }
+
+            case Floats:
+            {
+                vector<float> &values = ((Api::Float32Array *)object.pointer)->data;
+                values.resize(varint());
+                bytes(values.data(), values.size() * sizeof(float));
+                break;
+            }
+
+            case Ints:
+            {
+                vector<int32_t> &values = ((Api::Int32Array *)object.pointer)->data;
+                values.resize(varint());
+                bytes(values.data(), values.size() * sizeof(int32_t));
+                break;
+            }
+
+            case Vec2s:
+            {
+                vector<float> &values = ((Api::Vec2Array *)object.pointer)->data;
+                values.resize(varint());
+                bytes(values.data(), values.size() * sizeof(float));
+                break;
+            }
+
+            case Dictionary:
+                dictionary((CScriptDictionary *)object.pointer);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+private:
+    // Sets every saved key back to its value and deletes the keys added since
+    void dictionary(CScriptDictionary *dictionary)
+    {
+        asUINT count = varint();
+        bool kept = false;
+
+        savedKeys.resize(count);
+
+        for (asUINT i = 0; i < count; i++)
+        {
+            string &key = savedKeys[i];
+            asUINT length = varint();
+            key.assign((const char *)position, length);
+            position += length;
+
+            int typeId = (int)varint();
+
+            if ((typeId & asTYPEID_MASK_OBJECT) == 0)
+            {
+                asINT64 primitive = 0;
+                bytes(&primitive, engine->GetSizeOfPrimitiveType(typeId));
+                dictionary->Set(key, &primitive, typeId);
+            }
+            else if (typeId & asTYPEID_OBJHANDLE)
+            {
+                asUINT index = varint();
+
+                if (index == untracked)
+                {
+                    kept = true;
+                    continue;
+                }
+
+                void *pointer = index == nullHandle ? 0 : objects[index - firstObject].pointer;
+                CScriptDictionary::CIterator current = dictionary->find(key);
+
+                if (current == dictionary->end() || current.GetTypeId() != typeId || *(void **)current.GetAddressOfValue() != pointer)
+                    dictionary->Set(key, &pointer, typeId);
+            }
+            else if (typeId == stringTypeId)
+            {
+                string text;
+                value(&text, typeId, 0);
+                dictionary->Set(key, &text, typeId);
+            }
+            else
+                kept = true;
+        }
+
+        if (dictionary->GetSize() == count && !kept)
+            return;
+
+        sort(savedKeys.begin(), savedKeys.end());
+        staleKeys.clear();
+
+        for (CScriptDictionary::CIterator it = dictionary->begin(); it != dictionary->end(); it++)
+        {
+            if (!binary_search(savedKeys.begin(), savedKeys.end(), it.GetKey()))
+                staleKeys.push_back(it.GetKey());
+        }
+
+        for (const string &key : staleKeys)
+            dictionary->Delete(key);
+    }
+
+    const uint8_t *position;
+    const vector<Api::Rollback::Snapshot::Object> &objects;
+};
+
+static void appendVarint(vector<uint8_t> &data, asUINT value)
+{
+    while (value >= 0x80)
+    {
+        data.push_back((uint8_t)((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+
+    data.push_back((uint8_t)value);
+}
+
+static asUINT readVarint(const uint8_t *&position)
+{
+    asUINT value = 0;
+
+    for (int shift = 0;; shift += 7)
+    {
+        uint8_t c = *position++;
+        value |= (asUINT)(c & 0x7f) << shift;
+
+        if ((c & 0x80) == 0)
+            break;
+    }
+
+    return value;
+}
+
+// A delta is the full length followed by runs of (unchanged bytes, changed
+// bytes, the changed bytes themselves) against the base.
+static void encodeDelta(const vector<uint8_t> &base, const vector<uint8_t> &full, vector<uint8_t> &out)
+{
+    out.clear();
+    appendVarint(out, (asUINT)full.size());
+
+    size_t shared = base.size() < full.size() ? base.size() : full.size();
+    size_t i = 0;
+
+    while (i < full.size())
+    {
+        size_t same = i;
+
+        while (same < shared && base[same] == full[same])
+            same++;
+
+        size_t changed = same;
+
+        while (changed < full.size() && (changed >= shared || base[changed] != full[changed]))
+            changed++;
+
+        appendVarint(out, (asUINT)(same - i));
+        appendVarint(out, (asUINT)(changed - same));
+        out.insert(out.end(), full.begin() + same, full.begin() + changed);
+
+        i = changed;
+    }
+}
+
+static void decodeDelta(const vector<uint8_t> &base, const vector<uint8_t> &delta, vector<uint8_t> &out)
+{
+    const uint8_t *position = delta.data();
+    const uint8_t *end = position + delta.size();
+
+    out.resize(readVarint(position));
+
+    size_t i = 0;
+
+    while (position < end)
+    {
+        asUINT same = readVarint(position);
+        asUINT changed = readVarint(position);
+
+        memcpy(out.data() + i, base.data() + i, same);
+        i += same;
+
+        memcpy(out.data() + i, position, changed);
+        position += changed;
+        i += changed;
+    }
+}
+
+namespace Api
+{
+    namespace Rollback
+    {
+        Snapshot::Snapshot()
+            : version(0), base(0), baseVersion(0), generation(0), refCount(1), gcFlag(false)
+        {
+        }
+
+        Snapshot::~Snapshot()
+        {
+            releaseObjects(objects);
+            releaseObjects(previous);
+
+            if (base)
+                base->release();
+        }
+
+        Snapshot *Snapshot::create()
+        {
+            Snapshot *snapshot = new Snapshot();
+
+            asIScriptContext *ctx = asGetActiveContext();
+            if (ctx)
+            {
+                asIScriptEngine *owner = ctx->GetEngine();
+                owner->NotifyGarbageCollectorOfNewObject(snapshot, owner->GetTypeInfoByDecl("vd::rollback::Snapshot"));
+            }
+
+            return snapshot;
+        }
+
+        void Snapshot::addRef()
+        {
+            gcFlag = false;
+            asAtomicInc(refCount);
+        }
+
+        void Snapshot::release()
+        {
+            gcFlag = false;
+            if (asAtomicDec(refCount) == 0)
+                delete this;
+        }
+
+        int Snapshot::getRefCount()
+        {
+            return refCount;
+        }
+
+        void Snapshot::setGCFlag()
+        {
+            gcFlag = true;
+        }
+
+        bool Snapshot::getGCFlag()
+        {
+            return gcFlag;
+        }
+
+        void Snapshot::enumReferences(asIScriptEngine *engine)
+        {
+            for (size_t i = 0; i < objects.size(); i++)
+                engine->GCEnumCallback(objects[i].pointer);
+
+            for (size_t i = 0; i < previous.size(); i++)
+                engine->GCEnumCallback(previous[i].pointer);
+
+            if (base)
+                engine->GCEnumCallback(base);
+        }
+
+        // Called by the collector to break a cycle, the snapshot can't be
+        // restored afterwards
+        void Snapshot::releaseAllReferences(asIScriptEngine *engine)
+        {
+            releaseObjects(objects);
+            releaseObjects(previous);
+
+            if (base)
+            {
+                base->release();
+                base = 0;
+            }
+
+            data.clear();
+            version = 0;
+        }
+
+        void Snapshot::releaseObjects(vector<Object> &list)
+        {
+            for (size_t i = 0; i < list.size(); i++)
+                releaseObject(list[i].pointer, list[i].type);
+
+            list.clear();
+        }
+
+        void Snapshot::save()
+        {
+            if (engine == 0)
+                return;
+
+            // The previous objects are only let go once the new ones are
+            // referenced, so objects in both aren't destroyed in between
+            previous.swap(objects);
+            objects.clear();
+            data.clear();
+            indexOf.clear();
+
+            StateWriter writer(data, objects);
+
+            for (size_t i = 0; i < globals.size(); i++)
+                writer.value(globals[i].address, globals[i].typeId, globals[i].size);
+
+            // Objects found while writing are appended to the table, so this
+            // walks everything reachable breadth first
+            for (size_t i = 0; i < objects.size(); i++)
+                writer.contents(objects[i]);
+
+            releaseObjects(previous);
+
+            if (base)
+            {
+                base->release();
+                base = 0;
+            }
+
+            version++;
+            generation = ::generation;
+        }
+
+        void Snapshot::saveDelta(Snapshot *other)
+        {
+            if (other == 0 || other == this || other->base || other->generation != ::generation)
+            {
+                setException("The base of a delta must be another full snapshot");
+                return;
+            }
+
+            save();
+            encodeDelta(other->data, data, scratch);
+            data.swap(scratch);
+
+            other->addRef();
+            base = other;
+            baseVersion = other->version;
+        }
+
+        void Snapshot::restore()
+        {
+            if (engine == 0 || version == 0)
+                return;
+
+            if (generation != ::generation)
+            {
+                setException("The snapshot was saved before the script was rebuilt");
+                return;
+            }
+
+            const vector<uint8_t> *bytes = &data;
+
+            if (base)
+            {
+                if (base->version != baseVersion)
+                {
+                    setException("The base snapshot has been saved over since the delta was taken");
+                    return;
+                }
+
+                decodeDelta(base->data, data, scratch);
+                bytes = &scratch;
+            }
+
+            StateReader reader(bytes->data(), objects);
+
+            for (size_t i = 0; i < globals.size(); i++)
+                reader.value(globals[i].address, globals[i].typeId, globals[i].size);
+
+            for (size_t i = 0; i < objects.size(); i++)
+                reader.contents(objects[i]);
+        }
+
+        asUINT Snapshot::size() const
+        {
+            return (asUINT)data.size();
+        }
+
+        asUINT Snapshot::objectCount() const
+        {
+            return (asUINT)objects.size();
+        }
+
+        bool Snapshot::isDelta() const
+        {
+            return base != 0;
+        }
+
+        void loadGlobals(asIScriptModule *module, CScriptBuilder &builder)
+        {
+            engine = module->GetEngine();
+            updateFunction = module->GetFunctionByDecl("void update(float)");
+            globals.clear();
+            layouts.clear();
+            warned.clear();
+            // Never reused, so snapshots of a build that was set aside and
+            // dropped can't match a later one
+            generation = ++lastGeneration;
+
+            stringTypeId = engine->GetTypeIdByDecl("string");
+            floatsType = engine->GetTypeInfoByDecl("vd::float32array");
+            intsType = engine->GetTypeInfoByDecl("vd::int32array");
+            vec2sType = engine->GetTypeInfoByDecl("vd::vec2array");
+            snapshotType = engine->GetTypeInfoByDecl("vd::rollback::Snapshot");
+
+            for (asUINT i = 0; i < module->GetGlobalVarCount(); i++)
+            {
+                Global global;
+                bool isConst;
+
+                module->GetGlobalVar(i, 0, 0, &global.typeId, &isConst);
+
+                if (isConst || isNoRollback(builder.GetMetadataForVar(i)))
+                    continue;
+
+                global.address = module->GetAddressOfGlobalVar(i);
+                global.size = (global.typeId & asTYPEID_MASK_OBJECT) ? 0 : engine->GetSizeOfPrimitiveType(global.typeId);
+                globals.push_back(global);
+            }
+        }
+
+        State *setAside()
+        {
+            State *state = new State();
+            state->engine = 0;
+            state->updateFunction = 0;
+            state->generation = 0;
+            state->stringTypeId = 0;
+            state->snapshotType = 0;
+            state->floatsType = 0;
+            state->intsType = 0;
+            state->vec2sType = 0;
+            swapState(*state);
+            return state;
+        }
+
+        void putBack(State *state)
+        {
+            swapState(*state);
+            delete state;
+        }
+
+        void discard(State *state)
+        {
+            delete state;
+        }
+
+        void resimulate(int frames, float dt)
+        {
+            asIScriptContext *ctx = asGetActiveContext();
+
+            if (ctx == 0 || updateFunction == 0)
+                return;
+
+            if (inResimulation)
+            {
+                setException("Can't resimulate from inside a resimulated update");
+                return;
+            }
+
+            inResimulation = true;
+
+            for (int i = 0; i < frames; i++)
+            {
+                int r = ctx->PushState();
+                if (r < 0)
+                    break;
+
+                ctx->Prepare(updateFunction);
+                ctx->SetArgFloat(0, dt);
+                r = ctx->Execute();
+
+                string message;
+                if (r == asEXECUTION_EXCEPTION)
+                    message = ctx->GetExceptionString();
+
+                ctx->PopState();
+
+                if (r != asEXECUTION_FINISHED)
+                {
+                    setException(message.empty() ? "The resimulated update didn't finish" : message.c_str());
+                    break;
+                }
+            }
+
+            inResimulation = false;
+        }
+
+        bool resimulating()
+        {
+            return inResimulation;
+        }
+    }
+
+    void registerRollback(asIScriptEngine *engine)
+    {
+        int r;
+
+        r = engine->SetDefaultNamespace("vd::rollback"); assert(r >= 0);
+
+        r = engine->RegisterObjectType("Snapshot", 0, asOBJ_REF | asOBJ_GC); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("Snapshot", asBEHAVE_FACTORY, "Snapshot@ f()", asFUNCTION(Rollback::Snapshot::create), asCALL_CDECL); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("Snapshot", asBEHAVE_ADDREF, "void f()", asMETHOD(Rollback::Snapshot, addRef), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("Snapshot", asBEHAVE_RELEASE, "void f()", asMETHOD(Rollback::Snapshot, release), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("Snapshot", asBEHAVE_GETREFCOUNT, "int f()", asMETHOD(Rollback::Snapshot, getRefCount), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("Snapshot", asBEHAVE_SETGCFLAG, "void f()", asMETHOD(Rollback::Snapshot, setGCFlag), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("Snapshot", asBEHAVE_GETGCFLAG, "bool f()", asMETHOD(Rollback::Snapshot, getGCFlag), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("Snapshot", asBEHAVE_ENUMREFS, "void f(int&in)", asMETHOD(Rollback::Snapshot, enumReferences), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("Snapshot", asBEHAVE_RELEASEREFS, "void f(int&in)", asMETHOD(Rollback::Snapshot, releaseAllReferences), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Snapshot", "void save()", asMETHOD(Rollback::Snapshot, save), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Snapshot", "void saveDelta(Snapshot@)", asMETHOD(Rollback::Snapshot, saveDelta), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Snapshot", "void restore()", asMETHOD(Rollback::Snapshot, restore), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Snapshot", "uint size() const", asMETHOD(Rollback::Snapshot, size), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Snapshot", "uint objectCount() const", asMETHOD(Rollback::Snapshot, objectCount), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("Snapshot", "bool get_isDelta() const", asMETHOD(Rollback::Snapshot, isDelta), asCALL_THISCALL); assert(r >= 0);
+
+        r = engine->RegisterGlobalFunction("void resimulate(int, float)", asFUNCTION(Rollback::resimulate), asCALL_CDECL); assert(r >= 0);
+        r = engine->RegisterGlobalFunction("bool resimulating()", asFUNCTION(Rollback::resimulating), asCALL_CDECL); assert(r >= 0);
+    }
+}
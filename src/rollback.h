@@ -0,0 +1,91 @@
+#ifndef ROLLBACK_H
+#define ROLLBACK_H
+
+#include <vector>
+#include <cstdint>
+
+#include "angelscript.h"
+#include "scriptbuilder.h"
+
+using namespace std;
+
+namespace Api
+{
+    namespace Rollback
+    {
+        // The state of every global variable of the module, and of every
+        // script object reachable from them, packed into one byte buffer.
+        // Objects are recorded by identity and kept alive by the snapshot, so
+        // restoring writes the saved values back into the same objects and
+        // reseats handles to them instead of creating new ones.
+        class Snapshot
+        {
+        public:
+            struct Object
+            {
+                void *pointer;
+                asITypeInfo *type;
+                int kind;
+            };
+
+            Snapshot();
+            ~Snapshot();
+
+            static Snapshot *create();
+
+            void addRef();
+            void release();
+
+            // The objects a snapshot keeps alive can hold the snapshot in
+            // turn, so it takes part in garbage collection
+            int getRefCount();
+            void setGCFlag();
+            bool getGCFlag();
+            void enumReferences(asIScriptEngine *engine);
+            void releaseAllReferences(asIScriptEngine *engine);
+
+            void save();
+            // Stores only the bytes that differ from base, which must be a full snapshot
+            void saveDelta(Snapshot *base);
+            void restore();
+
+            asUINT size() const;
+            asUINT objectCount() const;
+            bool isDelta() const;
+
+            vector<uint8_t> data;
+            vector<Object> objects;
+            unsigned version;
+
+        private:
+            void releaseObjects(vector<Object> &list);
+
+            vector<Object> previous;
+            Snapshot *base;
+            unsigned baseVersion;
+            unsigned generation;
+
+            int refCount;
+            bool gcFlag;
+        };
+
+        // Finds the globals to snapshot after a build. Globals marked with
+        // [norollback] metadata, such as input history, are left out.
+        void loadGlobals(asIScriptModule *module, CScriptBuilder &builder);
+
+        // Moves the globals of the running game out of the way while a new
+        // build starts, so they can be put back if it fails
+        struct State;
+        State *setAside();
+        void putBack(State *state);
+        void discard(State *state);
+
+        // Runs the module's update function again for each predicted frame
+        void resimulate(int frames, float dt);
+        bool resimulating();
+    }
+
+    void registerRollback(asIScriptEngine *engine);
+}
+
+#endif
@@ -0,0 +1,168 @@
+#include "search.h"
+
+#include <cstdio>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "raylib.h"
+#include "TextEditor.h"
+
+using namespace std;
+
+static const int maxMatches = 10000;
+static const size_t maxLineLength = 200;
+
+static thread worker;
+static mutex resultsMutex;
+static vector<Search::Match> found;
+static atomic<bool> cancelled(false);
+static atomic<bool> running(false);
+static atomic<int> searched(0);
+
+static bool readFile(const string &path, string &contents)
+{
+    FILE *file = fopen(path.c_str(), "rb");
+
+    if (file == 0)
+        return false;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    contents.resize(size > 0 ? (size_t)size : 0);
+    bool ok = contents.empty() || fread(&contents[0], 1, contents.size(), file) == contents.size();
+
+    fclose(file);
+
+    return ok;
+}
+
+static void searchFiles(string dir, vector<string> files, string pattern, bool caseSensitive)
+{
+    string contents;
+    vector<Search::Match> batch;
+    int matches = 0;
+
+    for (auto &name : files)
+    {
+        if (cancelled || matches >= maxMatches)
+            break;
+
+        if (!readFile(dir + "/" + name, contents))
+            continue;
+
+        // Skip images, sounds and other binary files
+        if (contents.find('\0') != string::npos)
+        {
+            searched++;
+            continue;
+        }
+
+        size_t lineStart = 0;
+        int line = 0;
+        size_t offset = 0;
+
+        while (matches < maxMatches && (offset = TextEditor::FindInText(contents.data(), contents.size(), pattern, offset, caseSensitive)) != string::npos)
+        {
+            // Lines are counted from the previous match on
+            for (size_t newline; (newline = contents.find('\n', lineStart)) != string::npos && newline < offset; lineStart = newline + 1)
+                line++;
+
+            size_t lineEnd = contents.find('\n', offset);
+            if (lineEnd == string::npos)
+                lineEnd = contents.size();
+
+            Search::Match match;
+            match.path = name;
+            match.line = line;
+            match.column = (int)(offset - lineStart);
+            match.text = contents.substr(lineStart, min(lineEnd - lineStart, maxLineLength));
+
+            while (!match.text.empty() && (match.text.back() == '\r' || match.text.back() == '\n'))
+                match.text.pop_back();
+
+            batch.push_back(match);
+            matches++;
+            offset += pattern.size();
+        }
+
+        searched++;
+
+        if (!batch.empty())
+        {
+            lock_guard<mutex> lock(resultsMutex);
+            found.insert(found.end(), batch.begin(), batch.end());
+            batch.clear();
+        }
+    }
+
+    running = false;
+}
+
+namespace Search
+{
+    void start(const string &dir, const string &pattern, bool caseSensitive)
+    {
+        stop();
+
+        if (pattern.empty())
+            return;
+
+        vector<string> files;
+        FilePathList list = LoadDirectoryFilesEx(dir.c_str(), NULL, true);
+
+        for (unsigned int i = 0; i < list.count; i++)
+        {
+            string path = list.paths[i];
+
+            if (path.compare(0, dir.size(), dir) == 0 && path.size() > dir.size() && (path[dir.size()] == '/' || path[dir.size()] == '\\'))
+                path.erase(0, dir.size() + 1);
+
+            files.push_back(path);
+        }
+
+        UnloadDirectoryFiles(list);
+
+        {
+            lock_guard<mutex> lock(resultsMutex);
+            found.clear();
+        }
+
+        cancelled = false;
+        running = true;
+        searched = 0;
+
+        worker = thread(searchFiles, dir, files, pattern, caseSensitive);
+    }
+
+    void stop()
+    {
+        cancelled = true;
+
+        if (worker.joinable())
+            worker.join();
+
+        running = false;
+    }
+
+    bool isRunning()
+    {
+        return running;
+    }
+
+    void collect(vector<Match> &matches)
+    {
+        lock_guard<mutex> lock(resultsMutex);
+
+        matches.insert(matches.end(), found.begin(), found.end());
+        found.clear();
+    }
+
+    int filesSearched()
+    {
+        return searched;
+    }
+}
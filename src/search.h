@@ -0,0 +1,31 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Find in files for the dev UI. Files are read and scanned on a worker
+// thread, matches are picked up by the UI with collect as they are found.
+namespace Search
+{
+    struct Match
+    {
+        string path;
+        int line;
+        int column;
+        string text;
+    };
+
+    // Searches every file below dir, stopping any search still running
+    void start(const string &dir, const string &pattern, bool caseSensitive);
+    void stop();
+    bool isRunning();
+
+    // Moves the matches found since the last call to the end of matches
+    void collect(vector<Match> &matches);
+    int filesSearched();
+}
+
+#endif
@@ -0,0 +1,684 @@
+#include "spatial.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+static const asUINT minBuckets = 64;
+
+static void setException(const char *message)
+{
+    asIScriptContext *ctx = asGetActiveContext();
+
+    if (ctx)
+        ctx->SetException(message);
+}
+
+static void writeArray(const vector<int32_t> &values, CScriptArray *out)
+{
+    out->Resize((asUINT)values.size());
+
+    if (!values.empty())
+        memcpy(out->GetBuffer(), values.data(), values.size() * sizeof(int32_t));
+}
+
+// Slab test that, unlike b2AABB::RayCast, also hits when the ray starts inside the box.
+static bool rayHitsBox(const b2AABB &box, const b2Vec2 &from, const b2Vec2 &delta, float &fraction)
+{
+    float tmin = 0.0f;
+    float tmax = 1.0f;
+
+    for (int axis = 0; axis < 2; axis++)
+    {
+        float origin = axis == 0 ? from.x : from.y;
+        float d = axis == 0 ? delta.x : delta.y;
+        float lower = axis == 0 ? box.lowerBound.x : box.lowerBound.y;
+        float upper = axis == 0 ? box.upperBound.x : box.upperBound.y;
+
+        if (d == 0.0f)
+        {
+            if (origin < lower || origin > upper)
+                return false;
+
+            continue;
+        }
+
+        float t1 = (lower - origin) / d;
+        float t2 = (upper - origin) / d;
+
+        if (t1 > t2)
+            swap(t1, t2);
+
+        tmin = max(tmin, t1);
+        tmax = min(tmax, t2);
+
+        if (tmin > tmax)
+            return false;
+    }
+
+    fraction = tmin;
+    return true;
+}
+
+namespace Api
+{
+    namespace Spatial
+    {
+        HashGrid::HashGrid(float cellSize)
+            : cellSize(cellSize), inverseCellSize(1.0f / cellSize), bucketMask(0), sequential(true), refCount(1)
+        {
+            resizeTable(minBuckets);
+        }
+
+        HashGrid *HashGrid::create(float cellSize)
+        {
+            if (!(cellSize > 0.0f))
+            {
+                setException("Cell size must be greater than zero");
+                return 0;
+            }
+
+            return new HashGrid(cellSize);
+        }
+
+        void HashGrid::addRef()
+        {
+            asAtomicInc(refCount);
+        }
+
+        void HashGrid::release()
+        {
+            if (asAtomicDec(refCount) == 0)
+                delete this;
+        }
+
+        int HashGrid::findSlot(int id) const
+        {
+            if (sequential)
+                return id >= 0 && id < (int)ids.size() ? id : -1;
+
+            unordered_map<int, int>::const_iterator it = slotOfId.find(id);
+            return it == slotOfId.end() ? -1 : it->second;
+        }
+
+        int HashGrid::cellOf(float value) const
+        {
+            return (int)floorf(value * inverseCellSize);
+        }
+
+        asUINT HashGrid::bucketOf(int cx, int cy) const
+        {
+            return ((asUINT)cx * 73856093u ^ (asUINT)cy * 19349663u) & bucketMask;
+        }
+
+        void HashGrid::addToBucket(int slot)
+        {
+            vector<int32_t> &bucket = buckets[bucketOf(cellX[slot], cellY[slot])];
+            bucketIndex[slot] = (int32_t)bucket.size();
+            bucket.push_back(slot);
+        }
+
+        void HashGrid::removeFromBucket(int slot)
+        {
+            vector<int32_t> &bucket = buckets[bucketOf(cellX[slot], cellY[slot])];
+            int32_t moved = bucket.back();
+            bucket[bucketIndex[slot]] = moved;
+            bucketIndex[moved] = bucketIndex[slot];
+            bucket.pop_back();
+        }
+
+        void HashGrid::resizeTable(asUINT size)
+        {
+            for (vector<int32_t> &bucket : buckets)
+                bucket.clear();
+
+            buckets.resize(size);
+            bucketMask = size - 1;
+
+            for (size_t slot = 0; slot < ids.size(); slot++)
+                addToBucket((int)slot);
+        }
+
+        void HashGrid::mapIds()
+        {
+            if (!sequential)
+                return;
+
+            slotOfId.clear();
+            slotOfId.reserve(ids.size());
+
+            for (size_t slot = 0; slot < ids.size(); slot++)
+                slotOfId[ids[slot]] = (int)slot;
+
+            sequential = false;
+        }
+
+        void HashGrid::insert(int id, float x, float y)
+        {
+            if (findSlot(id) >= 0)
+            {
+                move(id, x, y);
+                return;
+            }
+
+            int slot = (int)ids.size();
+
+            if (sequential && id != slot)
+                mapIds();
+
+            if (!sequential)
+                slotOfId[id] = slot;
+
+            ids.push_back(id);
+            xs.push_back(x);
+            ys.push_back(y);
+            cellX.push_back(cellOf(x));
+            cellY.push_back(cellOf(y));
+            bucketIndex.push_back(0);
+
+            // Keep around two points per bucket at most
+            if (ids.size() > buckets.size() * 2)
+                resizeTable((asUINT)buckets.size() * 2);
+            else
+                addToBucket(slot);
+        }
+
+        void HashGrid::move(int id, float x, float y)
+        {
+            int slot = findSlot(id);
+
+            if (slot < 0)
+            {
+                insert(id, x, y);
+                return;
+            }
+
+            xs[slot] = x;
+            ys[slot] = y;
+
+            int cx = cellOf(x);
+            int cy = cellOf(y);
+
+            if (cx == cellX[slot] && cy == cellY[slot])
+                return;
+
+            removeFromBucket(slot);
+            cellX[slot] = cx;
+            cellY[slot] = cy;
+            addToBucket(slot);
+        }
+
+        void HashGrid::remove(int id)
+        {
+            int slot = findSlot(id);
+
+            if (slot < 0)
+                return;
+
+            int last = (int)ids.size() - 1;
+
+            if (sequential && slot != last)
+                mapIds();
+
+            removeFromBucket(slot);
+
+            if (slot != last)
+            {
+                // Move the last point into the hole and repoint its bucket entry
+                ids[slot] = ids[last];
+                xs[slot] = xs[last];
+                ys[slot] = ys[last];
+                cellX[slot] = cellX[last];
+                cellY[slot] = cellY[last];
+                bucketIndex[slot] = bucketIndex[last];
+
+                buckets[bucketOf(cellX[slot], cellY[slot])][bucketIndex[slot]] = slot;
+                slotOfId[ids[slot]] = slot;
+            }
+
+            if (!sequential)
+                slotOfId.erase(id);
+
+            ids.pop_back();
+            xs.pop_back();
+            ys.pop_back();
+            cellX.pop_back();
+            cellY.pop_back();
+            bucketIndex.pop_back();
+        }
+
+        bool HashGrid::contains(int id) const
+        {
+            return findSlot(id) >= 0;
+        }
+
+        void HashGrid::clear()
+        {
+            ids.clear();
+            xs.clear();
+            ys.clear();
+            cellX.clear();
+            cellY.clear();
+            bucketIndex.clear();
+
+            for (vector<int32_t> &bucket : buckets)
+                bucket.clear();
+
+            slotOfId.clear();
+            sequential = true;
+        }
+
+        asUINT HashGrid::count() const
+        {
+            return (asUINT)ids.size();
+        }
+
+        void HashGrid::rebuild(const Vec2Array *positions)
+        {
+            if (positions == 0)
+            {
+                setException("Null pointer access");
+                return;
+            }
+
+            size_t n = positions->data.size() / 2;
+            const float *p = positions->data.data();
+
+            ids.resize(n);
+            xs.resize(n);
+            ys.resize(n);
+            cellX.resize(n);
+            cellY.resize(n);
+            bucketIndex.resize(n);
+
+            for (size_t i = 0; i < n; i++)
+            {
+                ids[i] = (int32_t)i;
+                xs[i] = p[i * 2];
+                ys[i] = p[i * 2 + 1];
+                cellX[i] = cellOf(xs[i]);
+                cellY[i] = cellOf(ys[i]);
+            }
+
+            slotOfId.clear();
+            sequential = true;
+
+            asUINT size = minBuckets;
+
+            while (n > size * 2)
+                size *= 2;
+
+            resizeTable(size);
+        }
+
+        // Appends the ids of the points inside the rectangle, and also within
+        // radius of (x, y) when radiusSq isn't negative.
+        void HashGrid::collect(float left, float top, float right, float bottom, float x, float y, float radiusSq)
+        {
+            int x0 = cellOf(left), x1 = cellOf(right);
+            int y0 = cellOf(top), y1 = cellOf(bottom);
+
+            // A rectangle spanning more cells than there are points is cheaper to answer with a scan
+            double cells = ((double)x1 - x0 + 1) * ((double)y1 - y0 + 1);
+
+            if (cells > (double)ids.size())
+            {
+                for (size_t slot = 0; slot < ids.size(); slot++)
+                {
+                    float px = xs[slot], py = ys[slot];
+
+                    if (px < left || px > right || py < top || py > bottom)
+                        continue;
+
+                    if (radiusSq >= 0.0f && (px - x) * (px - x) + (py - y) * (py - y) > radiusSq)
+                        continue;
+
+                    results.push_back(ids[slot]);
+                }
+
+                return;
+            }
+
+            for (int cy = y0; cy <= y1; cy++)
+            {
+                for (int cx = x0; cx <= x1; cx++)
+                {
+                    for (int32_t slot : buckets[bucketOf(cx, cy)])
+                    {
+                        // Other cells can share the bucket, only take the ones of this cell
+                        if (cellX[slot] != cx || cellY[slot] != cy)
+                            continue;
+
+                        float px = xs[slot], py = ys[slot];
+
+                        if (px < left || px > right || py < top || py > bottom)
+                            continue;
+
+                        if (radiusSq >= 0.0f && (px - x) * (px - x) + (py - y) * (py - y) > radiusSq)
+                            continue;
+
+                        results.push_back(ids[slot]);
+                    }
+                }
+            }
+        }
+
+        void HashGrid::writeResults(CScriptArray *out)
+        {
+            writeArray(results, out);
+        }
+
+        void HashGrid::queryRect(float left, float top, float right, float bottom, CScriptArray *out)
+        {
+            if (out == 0)
+            {
+                setException("Null pointer access");
+                return;
+            }
+
+            results.clear();
+            collect(left, top, right, bottom, 0.0f, 0.0f, -1.0f);
+            writeResults(out);
+        }
+
+        void HashGrid::queryRadius(float x, float y, float radius, CScriptArray *out)
+        {
+            if (out == 0)
+            {
+                setException("Null pointer access");
+                return;
+            }
+
+            results.clear();
+            collect(x - radius, y - radius, x + radius, y + radius, x, y, radius * radius);
+            writeResults(out);
+        }
+
+        // Writes every pair of points closer than radius as two consecutive ids.
+        void HashGrid::pairs(float radius, CScriptArray *out)
+        {
+            if (out == 0)
+            {
+                setException("Null pointer access");
+                return;
+            }
+
+            results.clear();
+
+            float radiusSq = radius * radius;
+            int reach = (int)ceilf(radius * inverseCellSize);
+
+            for (size_t a = 0; a < ids.size(); a++)
+            {
+                float ax = xs[a], ay = ys[a];
+
+                for (int cy = cellY[a] - reach; cy <= cellY[a] + reach; cy++)
+                {
+                    for (int cx = cellX[a] - reach; cx <= cellX[a] + reach; cx++)
+                    {
+                        for (int32_t b : buckets[bucketOf(cx, cy)])
+                        {
+                            // Each pair is found from both ends, keep the one from the lower slot
+                            if (b <= (int32_t)a || cellX[b] != cx || cellY[b] != cy)
+                                continue;
+
+                            float dx = xs[b] - ax, dy = ys[b] - ay;
+
+                            if (dx * dx + dy * dy > radiusSq)
+                                continue;
+
+                            results.push_back(ids[a]);
+                            results.push_back(ids[b]);
+                        }
+                    }
+                }
+            }
+
+            writeResults(out);
+        }
+
+        AABBTree::AABBTree(float margin)
+            : scale(b2_aabbExtension / margin), proxyCount(0), refCount(1)
+        {
+        }
+
+        AABBTree *AABBTree::create(float margin)
+        {
+            if (!(margin > 0.0f))
+            {
+                setException("Margin must be greater than zero");
+                return 0;
+            }
+
+            return new AABBTree(margin);
+        }
+
+        void AABBTree::addRef()
+        {
+            asAtomicInc(refCount);
+        }
+
+        void AABBTree::release()
+        {
+            if (asAtomicDec(refCount) == 0)
+                delete this;
+        }
+
+        bool AABBTree::valid(int proxy) const
+        {
+            if (proxy < 0 || proxy >= (int)alive.size() || !alive[proxy])
+            {
+                setException("Invalid proxy");
+                return false;
+            }
+
+            return true;
+        }
+
+        // The tree works in units scaled so that its fixed b2_aabbExtension
+        // matches the margin the tree was created with.
+        b2AABB AABBTree::toTree(float left, float top, float right, float bottom) const
+        {
+            b2AABB box;
+            box.lowerBound.Set(min(left, right) * scale, min(top, bottom) * scale);
+            box.upperBound.Set(max(left, right) * scale, max(top, bottom) * scale);
+            return box;
+        }
+
+        int AABBTree::createProxy(float left, float top, float right, float bottom)
+        {
+            b2AABB box = toTree(left, top, right, bottom);
+            int proxy = tree.CreateProxy(box, 0);
+
+            if (proxy >= (int)boxes.size())
+            {
+                boxes.resize(proxy + 1);
+                alive.resize(proxy + 1, 0);
+            }
+
+            boxes[proxy] = box;
+            alive[proxy] = 1;
+            proxyCount++;
+
+            return proxy;
+        }
+
+        void AABBTree::moveProxy(int proxy, float left, float top, float right, float bottom, float dx, float dy)
+        {
+            if (!valid(proxy))
+                return;
+
+            b2AABB box = toTree(left, top, right, bottom);
+            boxes[proxy] = box;
+
+            // The displacement stretches the enlarged box in the direction of
+            // travel, so steadily moving boxes get reinserted less often.
+            tree.MoveProxy(proxy, box, b2Vec2(dx * scale, dy * scale));
+        }
+
+        void AABBTree::destroyProxy(int proxy)
+        {
+            if (!valid(proxy))
+                return;
+
+            tree.DestroyProxy(proxy);
+            alive[proxy] = 0;
+            proxyCount--;
+        }
+
+        asUINT AABBTree::count() const
+        {
+            return proxyCount;
+        }
+
+        int AABBTree::height() const
+        {
+            return tree.GetHeight();
+        }
+
+        bool AABBTree::QueryCallback(int proxy)
+        {
+            // The tree reports overlaps with the enlarged boxes, check the tight one
+            if (b2TestOverlap(boxes[proxy], queryBox))
+                results.push_back(proxy);
+
+            return true;
+        }
+
+        float AABBTree::RayCastCallback(const b2RayCastInput &input, int proxy)
+        {
+            float fraction;
+
+            if (rayHitsBox(boxes[proxy], input.p1, input.p2 - input.p1, fraction))
+                hits.push_back(make_pair(fraction, (int32_t)proxy));
+
+            // Keep going, every box along the ray is wanted
+            return input.maxFraction;
+        }
+
+        void AABBTree::query(float left, float top, float right, float bottom, CScriptArray *out)
+        {
+            if (out == 0)
+            {
+                setException("Null pointer access");
+                return;
+            }
+
+            results.clear();
+            queryBox = toTree(left, top, right, bottom);
+            tree.Query(this, queryBox);
+            writeArray(results, out);
+        }
+
+        // Runs one query per rectangle (left, top, right, bottom) in rects. The
+        // proxies found for rectangle i are out[offsets[i]] to out[offsets[i + 1] - 1].
+        void AABBTree::queryBatch(const Float32Array *rects, CScriptArray *out, CScriptArray *offsets)
+        {
+            if (rects == 0 || out == 0 || offsets == 0)
+            {
+                setException("Null pointer access");
+                return;
+            }
+
+            size_t n = rects->data.size() / 4;
+            const float *r = rects->data.data();
+
+            results.clear();
+            offsets->Resize((asUINT)n + 1);
+
+            int32_t *offset = (int32_t *)offsets->GetBuffer();
+
+            for (size_t i = 0; i < n; i++, r += 4)
+            {
+                offset[i] = (int32_t)results.size();
+                queryBox = toTree(r[0], r[1], r[2], r[3]);
+                tree.Query(this, queryBox);
+            }
+
+            offset[n] = (int32_t)results.size();
+            writeArray(results, out);
+        }
+
+        // Writes the proxies whose boxes the segment crosses, nearest first.
+        // A segment of zero length gives the boxes containing the point.
+        void AABBTree::raycast(float x0, float y0, float x1, float y1, CScriptArray *out)
+        {
+            if (out == 0)
+            {
+                setException("Null pointer access");
+                return;
+            }
+
+            hits.clear();
+
+            b2RayCastInput input;
+            input.p1.Set(x0 * scale, y0 * scale);
+            input.p2.Set(x1 * scale, y1 * scale);
+            input.maxFraction = 1.0f;
+
+            // Box2D asserts on a zero length ray, it is a point query instead
+            if ((input.p2 - input.p1).LengthSquared() <= 0.0f)
+            {
+                results.clear();
+                queryBox = toTree(x0, y0, x0, y0);
+                tree.Query(this, queryBox);
+                writeArray(results, out);
+                return;
+            }
+
+            tree.RayCast(this, input);
+
+            sort(hits.begin(), hits.end());
+
+            results.clear();
+
+            for (size_t i = 0; i < hits.size(); i++)
+                results.push_back(hits[i].second);
+
+            writeArray(results, out);
+        }
+    }
+
+    void registerSpatial(asIScriptEngine *engine)
+    {
+        int r;
+
+        r = engine->SetDefaultNamespace("vd::spatial"); assert(r >= 0);
+
+        r = engine->RegisterObjectType("HashGrid", 0, asOBJ_REF); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("HashGrid", asBEHAVE_FACTORY, "HashGrid@ f(float cellSize = 64)", asFUNCTION(Spatial::HashGrid::create), asCALL_CDECL); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("HashGrid", asBEHAVE_ADDREF, "void f()", asMETHOD(Spatial::HashGrid, addRef), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("HashGrid", asBEHAVE_RELEASE, "void f()", asMETHOD(Spatial::HashGrid, release), asCALL_THISCALL); assert(r >= 0);
+
+        r = engine->RegisterObjectMethod("HashGrid", "void insert(int, float, float)", asMETHOD(Spatial::HashGrid, insert), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("HashGrid", "void move(int, float, float)", asMETHOD(Spatial::HashGrid, move), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("HashGrid", "void remove(int)", asMETHOD(Spatial::HashGrid, remove), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("HashGrid", "bool contains(int) const", asMETHOD(Spatial::HashGrid, contains), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("HashGrid", "void clear()", asMETHOD(Spatial::HashGrid, clear), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("HashGrid", "uint count() const", asMETHOD(Spatial::HashGrid, count), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("HashGrid", "void rebuild(const vec2array@)", asMETHOD(Spatial::HashGrid, rebuild), asCALL_THISCALL); assert(r >= 0);
+
+        r = engine->RegisterObjectMethod("HashGrid", "void queryRect(float, float, float, float, array<int>@)", asMETHOD(Spatial::HashGrid, queryRect), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("HashGrid", "void queryRadius(float, float, float, array<int>@)", asMETHOD(Spatial::HashGrid, queryRadius), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("HashGrid", "void pairs(float, array<int>@)", asMETHOD(Spatial::HashGrid, pairs), asCALL_THISCALL); assert(r >= 0);
+
+        r = engine->RegisterObjectType("AABBTree", 0, asOBJ_REF); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("AABBTree", asBEHAVE_FACTORY, "AABBTree@ f(float margin = 4)", asFUNCTION(Spatial::AABBTree::create), asCALL_CDECL); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("AABBTree", asBEHAVE_ADDREF, "void f()", asMETHOD(Spatial::AABBTree, addRef), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("AABBTree", asBEHAVE_RELEASE, "void f()", asMETHOD(Spatial::AABBTree, release), asCALL_THISCALL); assert(r >= 0);
+
+        r = engine->RegisterObjectMethod("AABBTree", "int createProxy(float, float, float, float)", asMETHOD(Spatial::AABBTree, createProxy), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("AABBTree", "void moveProxy(int, float, float, float, float, float dx = 0, float dy = 0)", asMETHOD(Spatial::AABBTree, moveProxy), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("AABBTree", "void destroyProxy(int)", asMETHOD(Spatial::AABBTree, destroyProxy), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("AABBTree", "uint count() const", asMETHOD(Spatial::AABBTree, count), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("AABBTree", "int height() const", asMETHOD(Spatial::AABBTree, height), asCALL_THISCALL); assert(r >= 0);
+
+        r = engine->RegisterObjectMethod("AABBTree", "void query(float, float, float, float, array<int>@)", asMETHOD(Spatial::AABBTree, query), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("AABBTree", "void queryBatch(const float32array@, array<int>@, array<int>@)", asMETHOD(Spatial::AABBTree, queryBatch), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("AABBTree", "void raycast(float, float, float, float, array<int>@)", asMETHOD(Spatial::AABBTree, raycast), asCALL_THISCALL); assert(r >= 0);
+    }
+}
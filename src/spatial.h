@@ -0,0 +1,131 @@
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include "box2d/b2_dynamic_tree.h"
+
+#include "angelscript.h"
+#include "scriptarray.h"
+#include "typedarray.h"
+
+using namespace std;
+
+namespace Api
+{
+    namespace Spatial
+    {
+        // Points bucketed by the grid cell they fall in. Every cell hashes to
+        // one bucket of a power of two table, so queries only look at the
+        // buckets of the cells they overlap.
+        class HashGrid
+        {
+        public:
+            HashGrid(float cellSize);
+
+            static HashGrid *create(float cellSize);
+
+            void addRef();
+            void release();
+
+            void insert(int id, float x, float y);
+            void move(int id, float x, float y);
+            void remove(int id);
+            bool contains(int id) const;
+            void clear();
+            asUINT count() const;
+
+            // Replaces the contents with one point per element, ids being the element indices
+            void rebuild(const Vec2Array *positions);
+
+            void queryRect(float left, float top, float right, float bottom, CScriptArray *out);
+            void queryRadius(float x, float y, float radius, CScriptArray *out);
+            void pairs(float radius, CScriptArray *out);
+
+        private:
+            int findSlot(int id) const;
+            int cellOf(float value) const;
+            asUINT bucketOf(int cx, int cy) const;
+            void addToBucket(int slot);
+            void removeFromBucket(int slot);
+            void resizeTable(asUINT size);
+            void mapIds();
+            void collect(float left, float top, float right, float bottom, float x, float y, float radiusSq);
+            void writeResults(CScriptArray *out);
+
+            float cellSize;
+            float inverseCellSize;
+
+            // Points, packed
+            vector<int32_t> ids;
+            vector<float> xs;
+            vector<float> ys;
+            vector<int32_t> cellX;
+            vector<int32_t> cellY;
+            vector<int32_t> bucketIndex;
+
+            vector<vector<int32_t> > buckets;
+            asUINT bucketMask;
+
+            // While the ids are 0, 1, 2... in slot order the map is left empty
+            bool sequential;
+            unordered_map<int, int> slotOfId;
+
+            vector<int32_t> results;
+
+            int refCount;
+        };
+
+        // Boxes kept in Box2D's dynamic AABB tree. The tree stores each box
+        // enlarged by a margin, so moves that stay inside it cost nothing and
+        // the rest are a remove and reinsert in O(log n).
+        class AABBTree
+        {
+        public:
+            AABBTree(float margin);
+
+            static AABBTree *create(float margin);
+
+            void addRef();
+            void release();
+
+            int createProxy(float left, float top, float right, float bottom);
+            void moveProxy(int proxy, float left, float top, float right, float bottom, float dx, float dy);
+            void destroyProxy(int proxy);
+            asUINT count() const;
+            int height() const;
+
+            void query(float left, float top, float right, float bottom, CScriptArray *out);
+            void queryBatch(const Float32Array *rects, CScriptArray *out, CScriptArray *offsets);
+            void raycast(float x0, float y0, float x1, float y1, CScriptArray *out);
+
+            // Callbacks for b2DynamicTree::Query and RayCast
+            bool QueryCallback(int proxy);
+            float RayCastCallback(const b2RayCastInput &input, int proxy);
+
+        private:
+            bool valid(int proxy) const;
+            b2AABB toTree(float left, float top, float right, float bottom) const;
+
+            b2DynamicTree tree;
+            float scale;
+
+            // Tight boxes by proxy id, the tree only knows the enlarged ones
+            vector<b2AABB> boxes;
+            vector<uint8_t> alive;
+            asUINT proxyCount;
+
+            b2AABB queryBox;
+            vector<int32_t> results;
+            vector<pair<float, int32_t> > hits;
+
+            int refCount;
+        };
+    }
+
+    void registerSpatial(asIScriptEngine *engine);
+}
+
+#endif
@@ -0,0 +1,950 @@
+#include "typedarray.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "angelscript.h"
+
+using namespace std;
+
+static void setException(const char *message)
+{
+    asIScriptContext *ctx = asGetActiveContext();
+
+    if (ctx)
+        ctx->SetException(message);
+}
+
+static bool checkArgument(const void *other)
+{
+    if (other == 0)
+    {
+        setException("Null pointer access");
+        return false;
+    }
+
+    return true;
+}
+
+static bool checkLength(size_t a, size_t b)
+{
+    if (a != b)
+    {
+        setException("Array lengths do not match");
+        return false;
+    }
+
+    return true;
+}
+
+// Generic kernels, these are plain loops over contiguous memory.
+
+template <typename T>
+static void addKernel(T *dst, const T *src, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        dst[i] += src[i];
+}
+
+template <typename T>
+static void addScalarKernel(T *dst, T value, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        dst[i] += value;
+}
+
+template <typename T>
+static void mulKernel(T *dst, const T *src, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        dst[i] *= src[i];
+}
+
+template <typename T>
+static void scaleKernel(T *dst, T value, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        dst[i] *= value;
+}
+
+template <typename T>
+static void fmaKernel(T *dst, const T *src, T value, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        dst[i] += src[i] * value;
+}
+
+template <typename T>
+static void fmaArraysKernel(T *dst, const T *a, const T *b, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        dst[i] += a[i] * b[i];
+}
+
+template <typename T>
+static void clampKernel(T *dst, T lo, T hi, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        dst[i] = dst[i] < lo ? lo : (dst[i] > hi ? hi : dst[i]);
+}
+
+template <typename T>
+static void minKernel(T *dst, const T *src, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        dst[i] = src[i] < dst[i] ? src[i] : dst[i];
+}
+
+template <typename T>
+static void maxKernel(T *dst, const T *src, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        dst[i] = src[i] > dst[i] ? src[i] : dst[i];
+}
+
+template <typename T>
+static T sumKernel(const T *src, size_t n)
+{
+    T total = 0;
+
+    for (size_t i = 0; i < n; i++)
+        total += src[i];
+
+    return total;
+}
+
+template <typename T>
+static T dotKernel(const T *a, const T *b, size_t n)
+{
+    T total = 0;
+
+    for (size_t i = 0; i < n; i++)
+        total += a[i] * b[i];
+
+    return total;
+}
+
+// Repeating (x, y) pattern applied to interleaved vec2 data of n floats.
+
+static void addPairsKernel(float *dst, float x, float y, size_t n)
+{
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    __m128 v = _mm_setr_ps(x, y, x, y);
+
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), v));
+#endif
+
+    for (; i < n; i += 2)
+    {
+        dst[i] += x;
+        dst[i + 1] += y;
+    }
+}
+
+static void clampPairsKernel(float *dst, float lx, float ly, float hx, float hy, size_t n)
+{
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    __m128 lo = _mm_setr_ps(lx, ly, lx, ly);
+    __m128 hi = _mm_setr_ps(hx, hy, hx, hy);
+
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(dst + i, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(dst + i), lo), hi));
+#endif
+
+    for (; i < n; i += 2)
+    {
+        dst[i] = dst[i] < lx ? lx : (dst[i] > hx ? hx : dst[i]);
+        dst[i + 1] = dst[i + 1] < ly ? ly : (dst[i + 1] > hy ? hy : dst[i + 1]);
+    }
+}
+
+#if defined(__SSE2__)
+
+// SSE versions of the float kernels, four lanes at a time with a scalar tail.
+
+template <>
+void addKernel<float>(float *dst, const float *src, size_t n)
+{
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_loadu_ps(src + i)));
+
+    for (; i < n; i++)
+        dst[i] += src[i];
+}
+
+template <>
+void addScalarKernel<float>(float *dst, float value, size_t n)
+{
+    size_t i = 0;
+    __m128 v = _mm_set1_ps(value);
+
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), v));
+
+    for (; i < n; i++)
+        dst[i] += value;
+}
+
+template <>
+void mulKernel<float>(float *dst, const float *src, size_t n)
+{
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(dst + i), _mm_loadu_ps(src + i)));
+
+    for (; i < n; i++)
+        dst[i] *= src[i];
+}
+
+template <>
+void scaleKernel<float>(float *dst, float value, size_t n)
+{
+    size_t i = 0;
+    __m128 v = _mm_set1_ps(value);
+
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(dst + i), v));
+
+    for (; i < n; i++)
+        dst[i] *= value;
+}
+
+template <>
+void fmaKernel<float>(float *dst, const float *src, float value, size_t n)
+{
+    size_t i = 0;
+    __m128 v = _mm_set1_ps(value);
+
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), v)));
+
+    for (; i < n; i++)
+        dst[i] += src[i] * value;
+}
+
+template <>
+void fmaArraysKernel<float>(float *dst, const float *a, const float *b, size_t n)
+{
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i))));
+
+    for (; i < n; i++)
+        dst[i] += a[i] * b[i];
+}
+
+template <>
+void clampKernel<float>(float *dst, float lo, float hi, size_t n)
+{
+    size_t i = 0;
+    __m128 vlo = _mm_set1_ps(lo);
+    __m128 vhi = _mm_set1_ps(hi);
+
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(dst + i, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(dst + i), vlo), vhi));
+
+    for (; i < n; i++)
+        dst[i] = dst[i] < lo ? lo : (dst[i] > hi ? hi : dst[i]);
+}
+
+template <>
+void minKernel<float>(float *dst, const float *src, size_t n)
+{
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(dst + i, _mm_min_ps(_mm_loadu_ps(dst + i), _mm_loadu_ps(src + i)));
+
+    for (; i < n; i++)
+        dst[i] = src[i] < dst[i] ? src[i] : dst[i];
+}
+
+template <>
+void maxKernel<float>(float *dst, const float *src, size_t n)
+{
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(dst + i, _mm_max_ps(_mm_loadu_ps(dst + i), _mm_loadu_ps(src + i)));
+
+    for (; i < n; i++)
+        dst[i] = src[i] > dst[i] ? src[i] : dst[i];
+}
+
+static float horizontalSum(__m128 v)
+{
+    float lanes[4];
+    _mm_storeu_ps(lanes, v);
+
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+template <>
+float sumKernel<float>(const float *src, size_t n)
+{
+    size_t i = 0;
+    __m128 acc = _mm_setzero_ps();
+
+    for (; i + 4 <= n; i += 4)
+        acc = _mm_add_ps(acc, _mm_loadu_ps(src + i));
+
+    float total = horizontalSum(acc);
+
+    for (; i < n; i++)
+        total += src[i];
+
+    return total;
+}
+
+template <>
+float dotKernel<float>(const float *a, const float *b, size_t n)
+{
+    size_t i = 0;
+    __m128 acc = _mm_setzero_ps();
+
+    for (; i + 4 <= n; i += 4)
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+
+    float total = horizontalSum(acc);
+
+    for (; i < n; i++)
+        total += a[i] * b[i];
+
+    return total;
+}
+
+template <>
+void addKernel<int32_t>(int32_t *dst, const int32_t *src, size_t n)
+{
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_add_epi32(a, b));
+    }
+
+    for (; i < n; i++)
+        dst[i] += src[i];
+}
+
+#endif
+
+namespace Api
+{
+    template <typename T>
+    NumericArray<T>::NumericArray() : fixedLength(false), refCount(1)
+    {
+    }
+
+    template <typename T>
+    NumericArray<T>::NumericArray(asUINT length, T value) : data(length, value), fixedLength(false), refCount(1)
+    {
+    }
+
+    template <typename T>
+    NumericArray<T> *NumericArray<T>::create()
+    {
+        return new NumericArray<T>();
+    }
+
+    template <typename T>
+    NumericArray<T> *NumericArray<T>::create(asUINT length)
+    {
+        return new NumericArray<T>(length, 0);
+    }
+
+    template <typename T>
+    NumericArray<T> *NumericArray<T>::create(asUINT length, T value)
+    {
+        return new NumericArray<T>(length, value);
+    }
+
+    template <typename T>
+    NumericArray<T> *NumericArray<T>::createFromList(void *list)
+    {
+        asUINT length = *(asUINT *)list;
+        NumericArray<T> *array = new NumericArray<T>(length, 0);
+
+        if (length > 0)
+            memcpy(&array->data[0], (asUINT *)list + 1, length * sizeof(T));
+
+        return array;
+    }
+
+    template <typename T>
+    void NumericArray<T>::addRef()
+    {
+        asAtomicInc(refCount);
+    }
+
+    template <typename T>
+    void NumericArray<T>::release()
+    {
+        if (asAtomicDec(refCount) == 0)
+            delete this;
+    }
+
+    template <typename T>
+    asUINT NumericArray<T>::length() const
+    {
+        return (asUINT)data.size();
+    }
+
+    template <typename T>
+    void NumericArray<T>::resize(asUINT length)
+    {
+        if (checkResize(length))
+            data.resize(length, 0);
+    }
+
+    template <typename T>
+    void NumericArray<T>::reserve(asUINT length)
+    {
+        data.reserve(length);
+    }
+
+    template <typename T>
+    void NumericArray<T>::insertLast(T value)
+    {
+        if (checkResize(data.size() + 1))
+            data.push_back(value);
+    }
+
+    template <typename T>
+    void NumericArray<T>::clear()
+    {
+        if (checkResize(0))
+            data.clear();
+    }
+
+    template <typename T>
+    T &NumericArray<T>::at(asUINT index)
+    {
+        static T dummy;
+
+        if (index >= data.size())
+        {
+            setException("Index out of bounds");
+            return dummy;
+        }
+
+        return data[index];
+    }
+
+    template <typename T>
+    void NumericArray<T>::fill(T value)
+    {
+        std::fill(data.begin(), data.end(), value);
+    }
+
+    template <typename T>
+    void NumericArray<T>::copyFrom(const NumericArray *other)
+    {
+        if (checkArgument(other) && other != this && checkResize(other->data.size()))
+            data.assign(other->data.begin(), other->data.end());
+    }
+
+    template <typename T>
+    void NumericArray<T>::add(const NumericArray *other)
+    {
+        if (checkArgument(other) && checkLength(data.size(), other->data.size()) && !data.empty())
+            addKernel<T>(&data[0], &other->data[0], data.size());
+    }
+
+    template <typename T>
+    void NumericArray<T>::addScalar(T value)
+    {
+        if (!data.empty())
+            addScalarKernel<T>(&data[0], value, data.size());
+    }
+
+    template <typename T>
+    void NumericArray<T>::mul(const NumericArray *other)
+    {
+        if (checkArgument(other) && checkLength(data.size(), other->data.size()) && !data.empty())
+            mulKernel<T>(&data[0], &other->data[0], data.size());
+    }
+
+    template <typename T>
+    void NumericArray<T>::scale(T value)
+    {
+        if (!data.empty())
+            scaleKernel<T>(&data[0], value, data.size());
+    }
+
+    template <typename T>
+    void NumericArray<T>::fma(const NumericArray *other, T value)
+    {
+        if (checkArgument(other) && checkLength(data.size(), other->data.size()) && !data.empty())
+            fmaKernel<T>(&data[0], &other->data[0], value, data.size());
+    }
+
+    template <typename T>
+    void NumericArray<T>::fmaArrays(const NumericArray *a, const NumericArray *b)
+    {
+        if (checkArgument(a) && checkArgument(b) && checkLength(data.size(), a->data.size()) &&
+            checkLength(data.size(), b->data.size()) && !data.empty())
+            fmaArraysKernel<T>(&data[0], &a->data[0], &b->data[0], data.size());
+    }
+
+    template <typename T>
+    void NumericArray<T>::clamp(T lo, T hi)
+    {
+        if (!data.empty())
+            clampKernel<T>(&data[0], lo, hi, data.size());
+    }
+
+    template <typename T>
+    void NumericArray<T>::min(const NumericArray *other)
+    {
+        if (checkArgument(other) && checkLength(data.size(), other->data.size()) && !data.empty())
+            minKernel<T>(&data[0], &other->data[0], data.size());
+    }
+
+    template <typename T>
+    void NumericArray<T>::max(const NumericArray *other)
+    {
+        if (checkArgument(other) && checkLength(data.size(), other->data.size()) && !data.empty())
+            maxKernel<T>(&data[0], &other->data[0], data.size());
+    }
+
+    template <typename T>
+    T NumericArray<T>::sum() const
+    {
+        return data.empty() ? 0 : sumKernel<T>(&data[0], data.size());
+    }
+
+    template <typename T>
+    T NumericArray<T>::dot(const NumericArray *other) const
+    {
+        if (!checkArgument(other) || !checkLength(data.size(), other->data.size()) || data.empty())
+            return 0;
+
+        return dotKernel<T>(&data[0], &other->data[0], data.size());
+    }
+
+    template <typename T>
+    T NumericArray<T>::minValue() const
+    {
+        return data.empty() ? 0 : *min_element(data.begin(), data.end());
+    }
+
+    template <typename T>
+    T NumericArray<T>::maxValue() const
+    {
+        return data.empty() ? 0 : *max_element(data.begin(), data.end());
+    }
+
+    template <typename T>
+    void NumericArray<T>::gather(const NumericArray *source, const Int32Array *indices)
+    {
+        if (!checkArgument(source) || !checkArgument(indices) || !checkResize(indices->data.size()))
+            return;
+
+        size_t n = indices->data.size();
+        size_t limit = source->data.size();
+        vector<T> result(n);
+
+        for (size_t i = 0; i < n; i++)
+        {
+            size_t index = (size_t)(uint32_t)indices->data[i];
+
+            if (index >= limit)
+            {
+                setException("Index out of bounds");
+                return;
+            }
+
+            result[i] = source->data[index];
+        }
+
+        data.swap(result);
+    }
+
+    template <typename T>
+    void NumericArray<T>::scatter(NumericArray *destination, const Int32Array *indices) const
+    {
+        if (!checkArgument(destination) || !checkArgument(indices) || !checkLength(data.size(), indices->data.size()))
+            return;
+
+        size_t limit = destination->data.size();
+
+        for (size_t i = 0; i < data.size(); i++)
+        {
+            size_t index = (size_t)(uint32_t)indices->data[i];
+
+            if (index >= limit)
+            {
+                setException("Index out of bounds");
+                return;
+            }
+
+            destination->data[index] = data[i];
+        }
+    }
+
+    template <typename T>
+    bool NumericArray<T>::checkResize(size_t length) const
+    {
+        if (fixedLength && length != data.size())
+        {
+            setException("The array has a fixed length");
+            return false;
+        }
+
+        return true;
+    }
+
+    template class NumericArray<float>;
+    template class NumericArray<int32_t>;
+
+    Vec2Array::Vec2Array() : refCount(1)
+    {
+    }
+
+    Vec2Array *Vec2Array::create()
+    {
+        return new Vec2Array();
+    }
+
+    Vec2Array *Vec2Array::create(asUINT length)
+    {
+        Vec2Array *array = new Vec2Array();
+        array->data.resize(length * 2, 0.0f);
+
+        return array;
+    }
+
+    void Vec2Array::addRef()
+    {
+        asAtomicInc(refCount);
+    }
+
+    void Vec2Array::release()
+    {
+        if (asAtomicDec(refCount) == 0)
+            delete this;
+    }
+
+    asUINT Vec2Array::length() const
+    {
+        return (asUINT)(data.size() / 2);
+    }
+
+    void Vec2Array::resize(asUINT length)
+    {
+        data.resize(length * 2, 0.0f);
+    }
+
+    void Vec2Array::reserve(asUINT length)
+    {
+        data.reserve(length * 2);
+    }
+
+    void Vec2Array::insertLast(const Vector2 &value)
+    {
+        data.push_back(value.x);
+        data.push_back(value.y);
+    }
+
+    void Vec2Array::clear()
+    {
+        data.clear();
+    }
+
+    Vector2 &Vec2Array::at(asUINT index)
+    {
+        static Vector2 dummy;
+
+        if (index >= length())
+        {
+            setException("Index out of bounds");
+            return dummy;
+        }
+
+        return *(Vector2 *)&data[index * 2];
+    }
+
+    void Vec2Array::fill(const Vector2 &value)
+    {
+        for (size_t i = 0; i < data.size(); i += 2)
+        {
+            data[i] = value.x;
+            data[i + 1] = value.y;
+        }
+    }
+
+    void Vec2Array::copyFrom(const Vec2Array *other)
+    {
+        if (checkArgument(other) && other != this)
+            data.assign(other->data.begin(), other->data.end());
+    }
+
+    void Vec2Array::add(const Vec2Array *other)
+    {
+        if (checkArgument(other) && checkLength(data.size(), other->data.size()) && !data.empty())
+            addKernel<float>(&data[0], &other->data[0], data.size());
+    }
+
+    void Vec2Array::addScalar(const Vector2 &value)
+    {
+        if (!data.empty())
+            addPairsKernel(&data[0], value.x, value.y, data.size());
+    }
+
+    void Vec2Array::mul(const Vec2Array *other)
+    {
+        if (checkArgument(other) && checkLength(data.size(), other->data.size()) && !data.empty())
+            mulKernel<float>(&data[0], &other->data[0], data.size());
+    }
+
+    void Vec2Array::scale(float value)
+    {
+        if (!data.empty())
+            scaleKernel<float>(&data[0], value, data.size());
+    }
+
+    void Vec2Array::fma(const Vec2Array *other, float value)
+    {
+        if (checkArgument(other) && checkLength(data.size(), other->data.size()) && !data.empty())
+            fmaKernel<float>(&data[0], &other->data[0], value, data.size());
+    }
+
+    void Vec2Array::clamp(const Vector2 &lo, const Vector2 &hi)
+    {
+        if (!data.empty())
+            clampPairsKernel(&data[0], lo.x, lo.y, hi.x, hi.y, data.size());
+    }
+
+    Vector2 Vec2Array::sum() const
+    {
+        Vector2 total = { 0.0f, 0.0f };
+
+        for (size_t i = 0; i < data.size(); i += 2)
+        {
+            total.x += data[i];
+            total.y += data[i + 1];
+        }
+
+        return total;
+    }
+
+    void Vec2Array::dot(const Vec2Array *other, Float32Array *out) const
+    {
+        if (!checkArgument(other) || !checkArgument(out) || !checkLength(data.size(), other->data.size()) || !out->checkResize(length()))
+            return;
+
+        size_t n = length();
+        out->data.resize(n);
+
+        for (size_t i = 0; i < n; i++)
+            out->data[i] = data[i * 2] * other->data[i * 2] + data[i * 2 + 1] * other->data[i * 2 + 1];
+    }
+
+    void Vec2Array::lengths(Float32Array *out) const
+    {
+        if (!checkArgument(out) || !out->checkResize(length()))
+            return;
+
+        size_t n = length();
+        out->data.resize(n);
+
+        for (size_t i = 0; i < n; i++)
+            out->data[i] = sqrtf(data[i * 2] * data[i * 2] + data[i * 2 + 1] * data[i * 2 + 1]);
+    }
+
+    void Vec2Array::gather(const Vec2Array *source, const Int32Array *indices)
+    {
+        if (!checkArgument(source) || !checkArgument(indices))
+            return;
+
+        size_t n = indices->data.size();
+        size_t limit = source->length();
+        vector<float> result(n * 2);
+
+        for (size_t i = 0; i < n; i++)
+        {
+            size_t index = (size_t)(uint32_t)indices->data[i];
+
+            if (index >= limit)
+            {
+                setException("Index out of bounds");
+                return;
+            }
+
+            result[i * 2] = source->data[index * 2];
+            result[i * 2 + 1] = source->data[index * 2 + 1];
+        }
+
+        data.swap(result);
+    }
+
+    void Vec2Array::scatter(Vec2Array *destination, const Int32Array *indices) const
+    {
+        if (!checkArgument(destination) || !checkArgument(indices) || !checkLength(length(), indices->data.size()))
+            return;
+
+        size_t limit = destination->length();
+
+        for (size_t i = 0; i < indices->data.size(); i++)
+        {
+            size_t index = (size_t)(uint32_t)indices->data[i];
+
+            if (index >= limit)
+            {
+                setException("Index out of bounds");
+                return;
+            }
+
+            destination->data[index * 2] = data[i * 2];
+            destination->data[index * 2 + 1] = data[i * 2 + 1];
+        }
+    }
+
+    void Vec2Array::getX(Float32Array *out) const
+    {
+        if (!checkArgument(out) || !out->checkResize(length()))
+            return;
+
+        size_t n = length();
+        out->data.resize(n);
+
+        for (size_t i = 0; i < n; i++)
+            out->data[i] = data[i * 2];
+    }
+
+    void Vec2Array::getY(Float32Array *out) const
+    {
+        if (!checkArgument(out) || !out->checkResize(length()))
+            return;
+
+        size_t n = length();
+        out->data.resize(n);
+
+        for (size_t i = 0; i < n; i++)
+            out->data[i] = data[i * 2 + 1];
+    }
+
+    void Vec2Array::setXY(const Float32Array *x, const Float32Array *y)
+    {
+        if (!checkArgument(x) || !checkArgument(y) || !checkLength(x->data.size(), y->data.size()))
+            return;
+
+        size_t n = x->data.size();
+        data.resize(n * 2);
+
+        for (size_t i = 0; i < n; i++)
+        {
+            data[i * 2] = x->data[i];
+            data[i * 2 + 1] = y->data[i];
+        }
+    }
+
+    template <typename T>
+    static void registerNumericArray(asIScriptEngine *engine, const string &name, const string &element)
+    {
+        typedef NumericArray<T> A;
+
+        int r;
+        const char *type = name.c_str();
+        const string &n = name;
+        const string &e = element;
+
+        r = engine->RegisterObjectBehaviour(type, asBEHAVE_FACTORY, (n + "@ f()").c_str(), asFUNCTIONPR(A::create, (), A *), asCALL_CDECL); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour(type, asBEHAVE_FACTORY, (n + "@ f(uint)").c_str(), asFUNCTIONPR(A::create, (asUINT), A *), asCALL_CDECL); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour(type, asBEHAVE_FACTORY, (n + "@ f(uint, " + e + ")").c_str(), asFUNCTIONPR(A::create, (asUINT, T), A *), asCALL_CDECL); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour(type, asBEHAVE_LIST_FACTORY, (n + "@ f(int&in) {repeat " + e + "}").c_str(), asFUNCTION(A::createFromList), asCALL_CDECL); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour(type, asBEHAVE_ADDREF, "void f()", asMETHOD(A, addRef), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour(type, asBEHAVE_RELEASE, "void f()", asMETHOD(A, release), asCALL_THISCALL); assert(r >= 0);
+
+        r = engine->RegisterObjectMethod(type, (e + " &opIndex(uint)").c_str(), asMETHOD(A, at), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod(type, ("const " + e + " &opIndex(uint) const").c_str(), asMETHOD(A, at), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod(type, "uint length() const", asMETHOD(A, length), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod(type, "void resize(uint)", asMETHOD(A, resize), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod(type, "void reserve(uint)", asMETHOD(A, reserve), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod(type, ("void insertLast(" + e + ")").c_str(), asMETHOD(A, insertLast), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod(type, "void clear()", asMETHOD(A, clear), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod(type, ("void fill(" + e + ")").c_str(), asMETHOD(A, fill), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod(type, ("void copyFrom(const " + n + "@)").c_str(), asMETHOD(A, copyFrom), asCALL_THISCALL); assert(r >= 0);
+
+        r = engine->RegisterObjectMethod(type, ("void add(const " + n + "@)").c_str(), asMETHOD(A, add), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod(type, ("void add(" + e + ")").c_str(), asMETHOD(A, addScalar), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod(type, ("void mul(const " + n + "@)").c_str(), asMETHOD(A, mul), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod(type, ("void mul(" + e + ")").c_str(), asMETHOD(A, scale), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod(type, ("void scale(" + e + ")").c_str(), asMETHOD(A, scale), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod(type, ("void fma(const " + n + "@, " + e + ")").c_str(), asMETHOD(A, fma), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod(type, ("void fma(const " + n + "@, const " + n + "@)").c_str(), asMETHOD(A, fmaArrays), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod(type, ("void clamp(" + e + ", " + e + ")").c_str(), asMETHOD(A, clamp), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod(type, ("void min(const " + n + "@)").c_str(), asMETHOD(A, min), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod(type, ("void max(const " + n + "@)").c_str(), asMETHOD(A, max), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod(type, (e + " sum() const").c_str(), asMETHOD(A, sum), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod(type, (e + " dot(const " + n + "@) const").c_str(), asMETHOD(A, dot), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod(type, (e + " minValue() const").c_str(), asMETHOD(A, minValue), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod(type, (e + " maxValue() const").c_str(), asMETHOD(A, maxValue), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod(type, ("void gather(const " + n + "@, const int32array@)").c_str(), asMETHOD(A, gather), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod(type, ("void scatter(" + n + "@, const int32array@) const").c_str(), asMETHOD(A, scatter), asCALL_THISCALL); assert(r >= 0);
+    }
+
+    void registerTypedArrays(asIScriptEngine *engine)
+    {
+        int r;
+
+        r = engine->SetDefaultNamespace("vd"); assert(r >= 0);
+
+        r = engine->RegisterObjectType("float32array", 0, asOBJ_REF); assert(r >= 0);
+        r = engine->RegisterObjectType("int32array", 0, asOBJ_REF); assert(r >= 0);
+        r = engine->RegisterObjectType("vec2array", 0, asOBJ_REF); assert(r >= 0);
+
+        registerNumericArray<float>(engine, "float32array", "float");
+        registerNumericArray<int32_t>(engine, "int32array", "int");
+
+        r = engine->RegisterObjectBehaviour("vec2array", asBEHAVE_FACTORY, "vec2array@ f()", asFUNCTIONPR(Vec2Array::create, (), Vec2Array *), asCALL_CDECL); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("vec2array", asBEHAVE_FACTORY, "vec2array@ f(uint)", asFUNCTIONPR(Vec2Array::create, (asUINT), Vec2Array *), asCALL_CDECL); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("vec2array", asBEHAVE_ADDREF, "void f()", asMETHOD(Vec2Array, addRef), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectBehaviour("vec2array", asBEHAVE_RELEASE, "void f()", asMETHOD(Vec2Array, release), asCALL_THISCALL); assert(r >= 0);
+
+        r = engine->RegisterObjectMethod("vec2array", "Vector2 &opIndex(uint)", asMETHOD(Vec2Array, at), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("vec2array", "const Vector2 &opIndex(uint) const", asMETHOD(Vec2Array, at), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("vec2array", "uint length() const", asMETHOD(Vec2Array, length), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("vec2array", "void resize(uint)", asMETHOD(Vec2Array, resize), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("vec2array", "void reserve(uint)", asMETHOD(Vec2Array, reserve), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("vec2array", "void insertLast(const Vector2 &in)", asMETHOD(Vec2Array, insertLast), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("vec2array", "void clear()", asMETHOD(Vec2Array, clear), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("vec2array", "void fill(const Vector2 &in)", asMETHOD(Vec2Array, fill), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("vec2array", "void copyFrom(const vec2array@)", asMETHOD(Vec2Array, copyFrom), asCALL_THISCALL); assert(r >= 0);
+
+        r = engine->RegisterObjectMethod("vec2array", "void add(const vec2array@)", asMETHOD(Vec2Array, add), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("vec2array", "void add(const Vector2 &in)", asMETHOD(Vec2Array, addScalar), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("vec2array", "void mul(const vec2array@)", asMETHOD(Vec2Array, mul), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("vec2array", "void scale(float)", asMETHOD(Vec2Array, scale), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("vec2array", "void fma(const vec2array@, float)", asMETHOD(Vec2Array, fma), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("vec2array", "void clamp(const Vector2 &in, const Vector2 &in)", asMETHOD(Vec2Array, clamp), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("vec2array", "Vector2 sum() const", asMETHOD(Vec2Array, sum), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("vec2array", "void dot(const vec2array@, float32array@) const", asMETHOD(Vec2Array, dot), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("vec2array", "void lengths(float32array@) const", asMETHOD(Vec2Array, lengths), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("vec2array", "void gather(const vec2array@, const int32array@)", asMETHOD(Vec2Array, gather), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("vec2array", "void scatter(vec2array@, const int32array@) const", asMETHOD(Vec2Array, scatter), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("vec2array", "void getX(float32array@) const", asMETHOD(Vec2Array, getX), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("vec2array", "void getY(float32array@) const", asMETHOD(Vec2Array, getY), asCALL_THISCALL); assert(r >= 0);
+        r = engine->RegisterObjectMethod("vec2array", "void setXY(const float32array@, const float32array@)", asMETHOD(Vec2Array, setXY), asCALL_THISCALL); assert(r >= 0);
+    }
+}
@@ -0,0 +1,124 @@
+#ifndef TYPEDARRAY_H
+#define TYPEDARRAY_H
+
+#include <vector>
+#include <cstdint>
+
+#include "angelscript.h"
+#include "api.h"
+
+using namespace std;
+
+namespace Api
+{
+    // Contiguous arrays of plain numbers whose bulk operations run natively
+    // instead of element by element in the VM.
+    template <typename T>
+    class NumericArray
+    {
+    public:
+        NumericArray();
+        NumericArray(asUINT length, T value);
+
+        static NumericArray *create();
+        static NumericArray *create(asUINT length);
+        static NumericArray *create(asUINT length, T value);
+        static NumericArray *createFromList(void *list);
+
+        void addRef();
+        void release();
+
+        asUINT length() const;
+        void resize(asUINT length);
+        void reserve(asUINT length);
+        void insertLast(T value);
+        void clear();
+        T &at(asUINT index);
+
+        void fill(T value);
+        void copyFrom(const NumericArray *other);
+
+        void add(const NumericArray *other);
+        void addScalar(T value);
+        void mul(const NumericArray *other);
+        void scale(T value);
+        void fma(const NumericArray *other, T value);
+        void fmaArrays(const NumericArray *a, const NumericArray *b);
+        void clamp(T lo, T hi);
+        void min(const NumericArray *other);
+        void max(const NumericArray *other);
+        T sum() const;
+        T dot(const NumericArray *other) const;
+        T minValue() const;
+        T maxValue() const;
+
+        void gather(const NumericArray *source, const NumericArray<int32_t> *indices);
+        void scatter(NumericArray *destination, const NumericArray<int32_t> *indices) const;
+
+        // Sets a script exception and returns false if the array is fixed
+        // length and length differs from its current one
+        bool checkResize(size_t length) const;
+
+        vector<T> data;
+
+        // Arrays that are views of storage owned elsewhere, like ECS columns,
+        // keep their length, the elements can still be written
+        bool fixedLength;
+
+    private:
+        int refCount;
+    };
+
+    typedef NumericArray<float> Float32Array;
+    typedef NumericArray<int32_t> Int32Array;
+
+    // Interleaved x/y pairs, so every element has the same layout as vd::Vector2.
+    class Vec2Array
+    {
+    public:
+        Vec2Array();
+
+        static Vec2Array *create();
+        static Vec2Array *create(asUINT length);
+
+        void addRef();
+        void release();
+
+        asUINT length() const;
+        void resize(asUINT length);
+        void reserve(asUINT length);
+        void insertLast(const Vector2 &value);
+        void clear();
+        Vector2 &at(asUINT index);
+
+        void fill(const Vector2 &value);
+        void copyFrom(const Vec2Array *other);
+
+        void add(const Vec2Array *other);
+        void addScalar(const Vector2 &value);
+        void mul(const Vec2Array *other);
+        void scale(float value);
+        void fma(const Vec2Array *other, float value);
+        void clamp(const Vector2 &lo, const Vector2 &hi);
+        Vector2 sum() const;
+        void dot(const Vec2Array *other, Float32Array *out) const;
+        void lengths(Float32Array *out) const;
+
+        void gather(const Vec2Array *source, const Int32Array *indices);
+        void scatter(Vec2Array *destination, const Int32Array *indices) const;
+
+        void getX(Float32Array *out) const;
+        void getY(Float32Array *out) const;
+        void setXY(const Float32Array *x, const Float32Array *y);
+
+        // x0, y0, x1, y1, ...
+        vector<float> data;
+
+    private:
+        int refCount;
+    };
+
+    void registerTypedArrays(asIScriptEngine *engine);
+}
+
+#endif